@@ -0,0 +1,73 @@
+// Resources shared by the GPU culling passes, layouts mirror the structs in src/gpuculler.hpp
+
+struct InstanceData
+{
+	mat4 transform;
+	vec4 color;
+};
+
+// Instances of a single model, visible instances are compacted to [firstInstance,firstInstance + visibleInstances)
+struct CullingGroup
+{
+	vec4 boundsMin;			// object space bounds of the model
+	vec4 boundsMax;
+	uint count;
+	uint firstIndex;
+	int  baseVertex;
+	uint firstInstance;
+	uint visibleInstances;	// incremented by the culling pass, reset by the compaction pass
+	uint padding0;
+	uint padding1;
+	uint padding2;
+};
+
+// GL_DRAW_INDIRECT_BUFFER entry
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int  baseVertex;
+	uint baseInstance;
+};
+
+layout (std140, binding = 1) uniform CullingParameters
+{
+	mat4 viewProjection;
+	mat4 previousViewProjection;	// view-projection the depth pyramid was rendered with
+	vec4 frustumPlanes[6];
+	vec2 hizSize;
+	uint numberOfInstances;
+	uint numberOfGroups;
+	uint hizLevels;					// 0 while there is no pyramid of a previous frame
+};
+
+layout (std430, binding = 0) readonly buffer Instances
+{
+	InstanceData instances[];
+};
+
+layout (std430, binding = 1) readonly buffer InstanceGroups
+{
+	uint instanceGroups[];
+};
+
+layout (std430, binding = 2) buffer Groups
+{
+	CullingGroup groups[];
+};
+
+layout (std430, binding = 3) writeonly buffer VisibleInstances
+{
+	InstanceData visibleInstances[];
+};
+
+layout (std430, binding = 4) writeonly buffer DrawCommands
+{
+	DrawCommand commands[];
+};
+
+layout (std430, binding = 5) buffer DrawCount
+{
+	uint drawCount;
+};
@@ -0,0 +1,20 @@
+layout (std140, binding = 0) uniform Transforms
+{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+};
+
+#ifdef INSTANCED
+layout (location = 3) in mat4 inInstanceTransform; // occupies locations 3-6, replaces the model matrix
+
+vec4 TransformPosition(vec3 position)
+{
+	return projection * view * inInstanceTransform * vec4(position,1.0);
+}
+#else
+vec4 TransformPosition(vec3 position)
+{
+	return projection * view * model * vec4(position,1.0);
+}
+#endif
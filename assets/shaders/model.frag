@@ -0,0 +1,26 @@
+#version 430 core
+
+#ifdef TEXTURED
+layout (location = 0) in vec2 outTextureCoordinate;
+
+layout (binding = 0) uniform sampler2D textureSampler;
+#else
+layout (location = 0) in vec3 outColorNormal;
+#endif
+#ifdef INSTANCED
+layout (location = 1) in vec4 outInstanceColor;
+#endif
+
+layout (location = 0) out vec4 fragmentColor;
+
+void main()
+{
+#ifdef TEXTURED
+	fragmentColor = texture(textureSampler,outTextureCoordinate);
+#else
+	fragmentColor = vec4(abs(outColorNormal),0.0);
+#endif
+#ifdef INSTANCED
+	fragmentColor *= outInstanceColor;
+#endif
+}
@@ -0,0 +1,33 @@
+#version 430 core
+#extension GL_GOOGLE_include_directive : require
+
+layout (location = 0) in vec3 inPosition;
+#ifdef TEXTURED
+layout (location = 1) in vec2 inTextureCoordinate;
+
+layout (location = 0) out vec2 outTextureCoordinate;
+#else
+layout (location = 1) in vec3 inColorNormal; // use vertex normals as colors 
+
+layout (location = 0) out vec3 outColorNormal;
+#endif
+#ifdef INSTANCED
+layout (location = 7) in vec4 inInstanceColor;
+
+layout (location = 1) out vec4 outInstanceColor;
+#endif
+
+#include "include/transform.glsl"
+
+void main()
+{
+	gl_Position = TransformPosition(inPosition);
+#ifdef TEXTURED
+	outTextureCoordinate = inTextureCoordinate;
+#else
+	outColorNormal = inColorNormal;
+#endif
+#ifdef INSTANCED
+	outInstanceColor = inInstanceColor;
+#endif
+}
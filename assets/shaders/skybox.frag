@@ -1,10 +1,10 @@
 #version 430 core
 
-in vec3 outTextureCoordinate;
+layout (location = 0) in vec3 outTextureCoordinate;
 
-out vec4 fragmentColor;
+layout (location = 0) out vec4 fragmentColor;
 
-uniform samplerCube cubemapSampler;
+layout (binding = 0) uniform samplerCube cubemapSampler;
 
 void main()
 {
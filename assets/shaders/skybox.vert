@@ -2,10 +2,13 @@
 
 layout (location = 0) in vec3 inPosition;
 
-out vec3 outTextureCoordinate;
+layout (location = 0) out vec3 outTextureCoordinate;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140, binding = 0) uniform SkyboxTransforms
+{
+	mat4 view;
+	mat4 projection;
+};
 
 void main()
 {
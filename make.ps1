@@ -5,7 +5,67 @@ $LIBINC = "-LGLFW/lib","-LGLEW/lib";
 $LIB = "-lglew32","-lglfw3dll","-lopengl32";
 $STD = "-std=c++20";
 $OPT = "-O3"; #"-O0"
-$REQ = @($STD) + @($WRN) + @($OPT) + @($INC);
+$SMD = "-mavx";
+$PRF = "-DPROFILER_ENABLED"; # @() compiles the profiling zones out
+$REQ = @($STD) + @($WRN) + @($OPT) + @($SMD) + @($PRF) + @($INC);
+
+$CMD = "-o","obj/Headless.o","-c","src/headless.cpp";
+& $CPL $CMD $REQ;
+$CMD = "-o","obj/GPUProfiler.o","-c","src/gpuprofiler.cpp";
+& $CPL $CMD $REQ;
+$CMD = "-o","obj/Profiler.o","-c","src/profiler.cpp";
+& $CPL $CMD $REQ;
+$CMD = "-o","obj/Archive.o","-c","src/archive.cpp";
+& $CPL $CMD $REQ;
+$CMD = "-o","obj/FileReader.o","-c","src/filereader.cpp";
+& $CPL $CMD $REQ;
+$CMD = "-o","obj/JobSystem.o","-c","src/jobsystem.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/FrameArena.o","-c","src/framearena.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/AssetRegistry.o","-c","src/assetregistry.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/Handle.o","-c","src/handle.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/LOD.o","-c","src/lod.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/Framebuffer.o","-c","src/framebuffer.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/GPUCuller.o","-c","src/gpuculler.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/Occlusion.o","-c","src/occlusion.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/BVH.o","-c","src/bvh.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/Culling.o","-c","src/culling.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/Scene.o","-c","src/scene.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/CommandBuffer.o","-c","src/commandbuffer.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/RenderQueue.o","-c","src/renderqueue.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/DrawBatch.o","-c","src/drawbatch.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/MaterialManager.o","-c","src/materialmanager.cpp";
+& $CPL $CMD $REQ;
+
+$CMD = "-o","obj/GLState.o","-c","src/glstate.cpp";
+& $CPL $CMD $REQ;
 
 $CMD = "-o","obj/Mouse.o","-c","src/mouse.cpp";
 & $CPL $CMD $REQ;
@@ -28,6 +88,22 @@ $CMD = "-o","obj/OpenGl.o", "-c","src/opengl.cpp";
 
 $CMD = "-o","OpenGL.exe","obj/OpenGl.o","obj/ShaderManager.o",
 "obj/ModelManager.o","obj/TextureManager.o","obj/Camera.o",
-"obj/Mouse.o";
+"obj/Mouse.o","obj/GLState.o","obj/MaterialManager.o","obj/DrawBatch.o","obj/RenderQueue.o","obj/CommandBuffer.o","obj/Scene.o","obj/Culling.o","obj/BVH.o","obj/Occlusion.o","obj/GPUCuller.o","obj/Framebuffer.o","obj/LOD.o","obj/Handle.o","obj/AssetRegistry.o","obj/FrameArena.o","obj/JobSystem.o","obj/FileReader.o","obj/Archive.o","obj/Profiler.o","obj/GPUProfiler.o","obj/Headless.o";
 & $CPL $CMD $LIBINC $LIB;
 
+
+# Offline compilation of shaders to SPIR-V, skipped if glslangValidator isn't available
+if(Get-Command "glslangValidator" -ErrorAction SilentlyContinue)
+{
+	$SPVC = "-G","--quiet";
+	$SPV  = "assets/shaders/spirv";
+
+	& glslangValidator $SPVC "-DTEXTURED" "-o" "$SPV/texturedmodel.vert.spv" "assets/shaders/model.vert";
+	& glslangValidator $SPVC "-DTEXTURED" "-o" "$SPV/texturedmodel.frag.spv" "assets/shaders/model.frag";
+	& glslangValidator $SPVC "-DINSTANCED" "-o" "$SPV/instancedmodel.vert.spv" "assets/shaders/model.vert";
+	& glslangValidator $SPVC "-DINSTANCED" "-o" "$SPV/instancedmodel.frag.spv" "assets/shaders/model.frag";
+	& glslangValidator $SPVC "-DTEXTURED" "-DINSTANCED" "-o" "$SPV/texturedinstancedmodel.vert.spv" "assets/shaders/model.vert";
+	& glslangValidator $SPVC "-DTEXTURED" "-DINSTANCED" "-o" "$SPV/texturedinstancedmodel.frag.spv" "assets/shaders/model.frag";
+	& glslangValidator $SPVC "-o" "$SPV/skybox.vert.spv" "assets/shaders/skybox.vert";
+	& glslangValidator $SPVC "-o" "$SPV/skybox.frag.spv" "assets/shaders/skybox.frag";
+}
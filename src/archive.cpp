@@ -0,0 +1,444 @@
+#include "archive.hpp"
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+#endif
+
+Archive::~Archive()
+{
+	Close();
+}
+
+// The whole archive is mapped read-only, the table of contents is validated once, so lookups and reads
+// don't need any checks
+bool Archive::Open(const std::string &archivePath)
+{
+	Close();
+
+#if defined(_WIN32)
+	this->fileHandle = CreateFileA(archivePath.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+	LARGE_INTEGER fileSize;
+	if(this->fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(this->fileHandle,&fileSize) || fileSize.QuadPart == 0)
+	{
+		if(this->fileHandle != INVALID_HANDLE_VALUE)
+			CloseHandle(this->fileHandle);
+		this->fileHandle = nullptr;
+		std::cout << "Archive at location: \"" << archivePath << "\" could not be opened!" << std::endl;
+		return false;
+	}
+
+	this->mappingHandle = CreateFileMappingA(this->fileHandle,nullptr,PAGE_READONLY,0,0,nullptr);
+	this->mapping 		= this->mappingHandle ? static_cast<const u8*>(MapViewOfFile(this->mappingHandle,FILE_MAP_READ,0,0,0)) : nullptr;
+	this->mappingSize 	= fileSize.QuadPart;
+#else
+	const i32 file = open(archivePath.c_str(),O_RDONLY | O_CLOEXEC);
+	struct stat status;
+	if(file < 0 || fstat(file,&status) != 0 || status.st_size == 0)
+	{
+		if(file >= 0)
+			close(file);
+		std::cout << "Archive at location: \"" << archivePath << "\" could not be opened!" << std::endl;
+		return false;
+	}
+
+	void *mapping = mmap(nullptr,status.st_size,PROT_READ,MAP_SHARED,file,0);
+	close(file); // the mapping keeps the file open
+	this->mapping 	  = mapping != MAP_FAILED ? static_cast<const u8*>(mapping) : nullptr;
+	this->mappingSize = status.st_size;
+#endif
+
+	if(!this->mapping)
+	{
+		std::cout << "Archive at location: \"" << archivePath << "\" could not be mapped!" << std::endl;
+		Close();
+		return false;
+	}
+
+	this->path 	  = archivePath;
+	this->header  = reinterpret_cast<const ArchiveHeader*>(this->mapping);
+	this->entries = reinterpret_cast<const ArchiveEntry*>(this->mapping + sizeof(ArchiveHeader));
+
+	bool valid = this->mappingSize >= sizeof(ArchiveHeader) && this->header->identifier == ArchiveHeader::magic &&
+				 this->header->version == ArchiveHeader::currentVersion;
+	const u64 entriesEnd = valid ? sizeof(ArchiveHeader) + static_cast<u64>(this->header->numberOfEntries)*sizeof(ArchiveEntry) : 0;
+	valid = valid && entriesEnd + this->header->pathsSize <= this->mappingSize;
+	for(u32 i = 0;valid && i < this->header->numberOfEntries;i++)
+	{
+		const ArchiveEntry &entry = this->entries[i];
+		valid = entry.offset <= this->mappingSize && entry.storedSize <= this->mappingSize - entry.offset &&
+				static_cast<u64>(entry.pathOffset) + entry.pathLength <= this->header->pathsSize &&
+				(entry.compression == COMPRESSION_LZ4 || (entry.compression == COMPRESSION_NONE && entry.storedSize == entry.size)) &&
+				(i == 0 || this->entries[i - 1].pathHash <= entry.pathHash);
+	}
+	if(!valid)
+	{
+		std::cout << "File \"" << archivePath << "\" isn't a valid archive!" << std::endl;
+		Close();
+		return false;
+	}
+
+	this->paths = reinterpret_cast<const char*>(this->mapping + entriesEnd);
+	return true;
+}
+
+void Archive::Close()
+{
+#if defined(_WIN32)
+	if(this->mapping)
+		UnmapViewOfFile(this->mapping);
+	if(this->mappingHandle)
+		CloseHandle(this->mappingHandle);
+	if(this->fileHandle)
+		CloseHandle(this->fileHandle);
+	this->fileHandle 	= nullptr;
+	this->mappingHandle = nullptr;
+#else
+	if(this->mapping)
+		munmap(const_cast<u8*>(this->mapping),this->mappingSize);
+#endif
+
+	this->mapping 	  = nullptr;
+	this->mappingSize = 0;
+	this->header 	  = nullptr;
+	this->entries 	  = nullptr;
+	this->paths 	  = nullptr;
+}
+
+// Binary search on the path hash, the path itself decides between entries with the same hash
+const ArchiveEntry *Archive::Find(std::string_view virtualPath) const
+{
+	if(!IsOpen())
+		return nullptr;
+
+	const std::string normalizedPath = NormalizePath(virtualPath);
+	const u64 		  pathHash 		 = Hash(reinterpret_cast<const u8*>(normalizedPath.data()),normalizedPath.size());
+
+	const ArchiveEntry *end   = this->entries + this->header->numberOfEntries;
+	const ArchiveEntry *entry = std::lower_bound(this->entries,end,pathHash,[](const ArchiveEntry &entry,u64 hash){
+		return entry.pathHash < hash;
+	});
+	for(;entry != end && entry->pathHash == pathHash;entry++)
+		if(EntryPath(*entry) == normalizedPath)
+			return entry;
+
+	return nullptr;
+}
+
+std::string_view Archive::EntryPath(const ArchiveEntry &entry) const
+{
+	return std::string_view(this->paths + entry.pathOffset,entry.pathLength);
+}
+
+// Uncompressed entries are returned as views of the mapping, compressed ones are decompressed into a new buffer
+FileData Archive::Read(const ArchiveEntry &entry) const
+{
+	const u8 *payload = this->mapping + entry.offset;
+	if(entry.compression == COMPRESSION_NONE)
+		return FileData::View(payload,entry.size);
+
+	FileData data = FileData::Allocate(entry.size);
+	if(!DecompressLZ4(payload,entry.storedSize,data.bytes.get(),entry.size))
+	{
+		std::cout << "Entry \"" << EntryPath(entry) << "\" of archive \"" << this->path << "\" is corrupted!" << std::endl;
+		return FileData{};
+	}
+
+	data.loaded = true;
+	return data;
+}
+
+// Asks the kernel to start reading the payload's pages, so the first touch doesn't stall on a page fault
+void Archive::Prefetch([[maybe_unused]] const ArchiveEntry &entry) const
+{
+#if !defined(_WIN32)
+	const u64 begin = entry.offset/pageSize*pageSize;
+	posix_madvise(const_cast<u8*>(this->mapping + begin),entry.offset + entry.storedSize - begin,POSIX_MADV_WILLNEED);
+#endif
+}
+
+// Checks the contents of every entry against its hash
+bool Archive::Verify() const
+{
+	bool valid = IsOpen();
+	for(u32 i = 0;valid && i < this->header->numberOfEntries;i++)
+	{
+		const ArchiveEntry &entry = this->entries[i];
+		const FileData 		data  = Read(entry);
+		if(!data.loaded || Hash(data.bytes.get(),data.size) != entry.contentHash)
+		{
+			std::cout << "Entry \"" << EntryPath(entry) << "\" of archive \"" << this->path << "\" doesn't match its hash!" << std::endl;
+			valid = false;
+		}
+	}
+
+	return valid;
+}
+
+// Packs every file under the directory, virtual paths are the files' paths with the directory included.
+// Entries are compressed only if that saves at least an eighth of their size, already compressed formats
+// (e.g. jpg) stay uncompressed and are read without a copy
+bool Archive::Pack(const std::string &directory,const std::string &archivePath)
+{
+	struct PackedFile
+	{
+		std::string 	 path;
+		ArchiveEntry 	 entry;
+		std::vector<u8>  payload;
+	};
+
+	std::vector<PackedFile> files;
+	std::error_code error;
+	for(const auto &file : std::filesystem::recursive_directory_iterator(directory,error))
+	{
+		std::error_code notEquivalent; // the archive may not exist yet
+		if(!file.is_regular_file() || std::filesystem::equivalent(file.path(),archivePath,notEquivalent))
+			continue;
+
+		PackedFile &packedFile = files.emplace_back();
+		packedFile.path = NormalizePath(file.path().generic_string());
+
+		const FileData data = FileReader::ReadFile(file.path().string());
+		if(!data.loaded)
+			return false;
+
+		ArchiveEntry &entry = packedFile.entry;
+		entry = ArchiveEntry{
+			.pathHash 	 = Hash(reinterpret_cast<const u8*>(packedFile.path.data()),packedFile.path.size()),
+			.contentHash = Hash(data.bytes.get(),data.size),
+			.offset 	 = 0,
+			.storedSize  = data.size,
+			.size 		 = data.size,
+			.pathOffset  = 0,
+			.pathLength  = static_cast<u32>(packedFile.path.size()),
+			.compression = COMPRESSION_NONE,
+			.padding 	 = 0
+		};
+
+		CompressLZ4(data.bytes.get(),data.size,packedFile.payload);
+		if(packedFile.payload.size() <= data.size - data.size/8 && data.size != 0)
+		{
+			entry.compression = COMPRESSION_LZ4;
+			entry.storedSize  = packedFile.payload.size();
+		}
+		else
+			packedFile.payload.assign(data.bytes.get(),data.bytes.get() + data.size);
+	}
+	if(error)
+	{
+		std::cout << "Directory \"" << directory << "\" could not be read: " << error.message() << std::endl;
+		return false;
+	}
+
+	std::sort(files.begin(),files.end(),[](const PackedFile &a,const PackedFile &b){
+		return a.entry.pathHash != b.entry.pathHash ? a.entry.pathHash < b.entry.pathHash : a.path < b.path;
+	});
+
+	ArchiveHeader header = {
+		.identifier 	 = ArchiveHeader::magic,
+		.version 		 = ArchiveHeader::currentVersion,
+		.numberOfEntries = static_cast<u32>(files.size()),
+		.pathsSize 		 = 0
+	};
+	for(PackedFile &file : files)
+	{
+		file.entry.pathOffset = header.pathsSize;
+		header.pathsSize 	 += file.entry.pathLength;
+	}
+
+	// payloads follow the table of contents on page boundaries, identical files are stored once
+	auto alignToPage = [](u64 offset){ return (offset + pageSize - 1)/pageSize*pageSize; };
+	u64 payloadEnd = alignToPage(sizeof(ArchiveHeader) + files.size()*sizeof(ArchiveEntry) + header.pathsSize);
+	std::vector<const PackedFile*> storedPayloads;
+	for(PackedFile &file : files)
+	{
+		const auto stored = std::find_if(storedPayloads.begin(),storedPayloads.end(),[&file](const PackedFile *other){
+			return other->entry.contentHash == file.entry.contentHash && other->entry.size == file.entry.size &&
+				   other->payload == file.payload;
+		});
+		if(stored != storedPayloads.end())
+		{
+			file.entry.offset = (*stored)->entry.offset;
+			continue;
+		}
+
+		file.entry.offset = payloadEnd;
+		payloadEnd = alignToPage(payloadEnd + file.payload.size());
+		storedPayloads.push_back(&file);
+	}
+
+	std::ofstream archive(archivePath,std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!archive.is_open())
+	{
+		std::cout << "Archive at location: \"" << archivePath << "\" could not be created!" << std::endl;
+		return false;
+	}
+
+	archive.write(reinterpret_cast<const char*>(&header),sizeof(header));
+	for(const PackedFile &file : files)
+		archive.write(reinterpret_cast<const char*>(&file.entry),sizeof(ArchiveEntry));
+	for(const PackedFile &file : files)
+		archive.write(file.path.data(),file.path.size());
+
+	const std::vector<char> padding(pageSize,0);
+	for(const PackedFile *file : storedPayloads)
+	{
+		archive.write(padding.data(),file->entry.offset - static_cast<u64>(archive.tellp()));
+		archive.write(reinterpret_cast<const char*>(file->payload.data()),file->payload.size());
+	}
+	archive.write(padding.data(),payloadEnd - static_cast<u64>(archive.tellp()));
+	archive.close();
+
+	if(!archive)
+	{
+		std::cout << "Archive at location: \"" << archivePath << "\" could not be written!" << std::endl;
+		return false;
+	}
+
+	std::cout << "Packed " << files.size() << " files from \"" << directory << "\" into \"" << archivePath
+			  << "\" (" << payloadEnd << " bytes)" << std::endl;
+	return true;
+}
+
+// 64-bit FNV-1a
+u64 Archive::Hash(const u8 *bytes,u64 size)
+{
+	u64 hash = 0xcbf29ce484222325;
+	for(u64 i = 0;i < size;i++)
+		hash = (hash ^ bytes[i])*0x100000001b3;
+
+	return hash;
+}
+
+// Forward slashes, no "." or ".." components, so loose file paths and archive paths compare equal
+std::string Archive::NormalizePath(std::string_view path)
+{
+	return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+// Greedy LZ4 block compressor with a single hash table of the last position of every 4 byte sequence.
+// Follows the end of block rules: the last match starts at least 12 bytes before the end, the last
+// 5 bytes are always literals
+void Archive::CompressLZ4(const u8 *source,u64 size,std::vector<u8> &output)
+{
+	constexpr u32 minimumMatch  = 4;
+	constexpr u32 lastLiterals  = 5;
+	constexpr u32 matchLimit 	= 12;
+	constexpr u32 maximumOffset = 65535;
+	constexpr u32 hashBits 		= 16;
+
+	auto read32 = [source](u64 position){
+		u32 value;
+		std::memcpy(&value,source + position,sizeof(value));
+		return value;
+	};
+	auto writeLength = [&output](u64 length){ // continuation of a length which didn't fit into the token
+		for(;length >= 255;length -= 255)
+			output.push_back(255);
+		output.push_back(length);
+	};
+	auto writeLiterals = [&](u64 begin,u64 end,u8 matchToken){
+		const u64 length = end - begin;
+		output.push_back((std::min<u64>(length,15) << 4) | matchToken);
+		if(length >= 15)
+			writeLength(length - 15);
+		output.insert(output.end(),source + begin,source + end);
+	};
+
+	output.clear();
+	output.reserve(size + size/255 + 16);
+
+	std::vector<u64> lastPositions(1 << hashBits,~0ull);
+	u64 anchor = 0; // first byte not covered by a sequence yet
+	for(u64 position = 0;size >= matchLimit && position <= size - matchLimit;)
+	{
+		const u32 sequence  = read32(position);
+		const u32 hash 		= (sequence*2654435761u) >> (32 - hashBits);
+		const u64 candidate = lastPositions[hash];
+		lastPositions[hash] = position;
+
+		if(candidate == ~0ull || position - candidate > maximumOffset || read32(candidate) != sequence)
+		{
+			position++;
+			continue;
+		}
+
+		u64 length = minimumMatch;
+		while(position + length < size - lastLiterals && source[candidate + length] == source[position + length])
+			length++;
+
+		const u64 offset = position - candidate;
+		writeLiterals(anchor,position,std::min<u64>(length - minimumMatch,15));
+		output.push_back(offset & 0xff);
+		output.push_back(offset >> 8);
+		if(length - minimumMatch >= 15)
+			writeLength(length - minimumMatch - 15);
+
+		position += length;
+		anchor 	  = position;
+	}
+
+	writeLiterals(anchor,size,0);
+}
+
+// Every length and offset is checked, so corrupted data fails instead of writing out of bounds
+bool Archive::DecompressLZ4(const u8 *source,u64 sourceSize,u8 *destination,u64 size)
+{
+	u64 in  = 0;
+	u64 out = 0;
+	auto readLength = [&](u64 &length){
+		for(u8 byte = 255;byte == 255;length += byte)
+		{
+			if(in == sourceSize)
+				return false;
+			byte = source[in++];
+		}
+		return true;
+	};
+
+	while(in < sourceSize)
+	{
+		const u8 token = source[in++];
+
+		u64 literals = token >> 4;
+		if(literals == 15 && !readLength(literals))
+			return false;
+		if(literals > sourceSize - in || literals > size - out)
+			return false;
+		std::memcpy(destination + out,source + in,literals);
+		in  += literals;
+		out += literals;
+
+		if(in == sourceSize) // the last sequence has no match
+			break;
+
+		if(sourceSize - in < 2)
+			return false;
+		const u64 offset = source[in] | (source[in + 1] << 8);
+		in += 2;
+
+		u64 length = token & 15;
+		if(length == 15 && !readLength(length))
+			return false;
+		length += 4;
+		if(offset == 0 || offset > out || length > size - out)
+			return false;
+
+		// the match may overlap the bytes it produces, e.g. a run of a single byte has offset 1
+		const u8 *match = destination + out - offset;
+		if(offset >= length)
+			std::memcpy(destination + out,match,length);
+		else
+			for(u64 i = 0;i < length;i++)
+				destination[out + i] = match[i];
+		out += length;
+	}
+
+	return out == size;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
+#include "types.hpp"
+#include "filereader.hpp"
+
+// Layout of an archive: header, table of contents (entries sorted by path hash), path strings and the
+// payloads, each starting on a page boundary. The table of contents is used straight from the mapping
+struct ArchiveHeader
+{
+	static constexpr u32 magic 			= 0x4b41504f; // "OPAK"
+	static constexpr u32 currentVersion = 1;
+
+	u32 identifier;			// magic
+	u32 version;
+	u32 numberOfEntries;
+	u32 pathsSize;			// bytes of path strings, they follow the entries
+};
+
+enum ArchiveCompression : u32
+{
+	COMPRESSION_NONE,	// payload is the file itself, read without a copy
+	COMPRESSION_LZ4		// payload is a single LZ4 block
+};
+
+struct ArchiveEntry
+{
+	u64 pathHash;		// Archive::Hash of the normalized virtual path
+	u64 contentHash;	// Archive::Hash of the uncompressed contents, identical files share a payload
+	u64 offset;			// of the payload from the start of the archive, page aligned
+	u64 storedSize;		// size of the payload
+	u64 size;			// size of the file
+	u32 pathOffset;		// into the path strings
+	u32 pathLength;
+	u32 compression;	// ArchiveCompression
+	u32 padding;
+};
+
+// Read-only asset archive mapped into memory. Files are looked up by virtual path, the path they'd have
+// as loose files relative to the working directory (e.g. "assets/models/cubeV.obj"). Views of uncompressed
+// entries point into the mapping, so the archive has to outlive the data read from it
+struct Archive
+{
+	static constexpr u64 pageSize = 4096;
+
+	std::string 		 path;
+	const u8 			*mapping 	 = nullptr;
+	u64 				 mappingSize = 0;
+	const ArchiveHeader *header 	 = nullptr;
+	const ArchiveEntry  *entries 	 = nullptr;
+	const char 			*paths 		 = nullptr;
+#if defined(_WIN32)
+	void 				*fileHandle 	= nullptr;
+	void 				*mappingHandle = nullptr;
+#endif
+
+	~Archive();
+
+	bool Open(const std::string &archivePath);
+	void Close();
+	bool IsOpen() const { return this->mapping != nullptr; }
+
+	const ArchiveEntry *Find(std::string_view virtualPath) const;
+	std::string_view 	EntryPath(const ArchiveEntry &entry) const;
+	FileData 			Read(const ArchiveEntry &entry) const;
+	void 				Prefetch(const ArchiveEntry &entry) const;
+	bool 				Verify() const;
+
+	static bool 		Pack(const std::string &directory,const std::string &archivePath);
+	static u64 			Hash(const u8 *bytes,u64 size);
+	static std::string  NormalizePath(std::string_view path);
+	static void 		CompressLZ4(const u8 *source,u64 size,std::vector<u8> &output);
+	static bool 		DecompressLZ4(const u8 *source,u64 sourceSize,u8 *destination,u64 size);
+};
@@ -0,0 +1,314 @@
+#include "assetregistry.hpp"
+
+AssetRegistry::~AssetRegistry()
+{
+	bool warned = false;
+	for(const auto &[key,record] : this->assets)
+		if(record.references != 0)
+		{
+			if(!warned)
+				std::cout << "Not all assets have been released, still referenced:" << std::endl;
+			std::cout << '\t' << key << " (" << record.references << " references)" << std::endl;
+			warned = true;
+		}
+
+	for(const ReleaseBatch &batch : this->pendingBatches)
+		glDeleteSync(batch.fence);
+}
+
+std::string AssetRegistry::CanonicalPath(const std::string &path)
+{
+	return std::filesystem::weakly_canonical(path).string();
+}
+
+// Adds a reference to an already loaded (or not yet destroyed) asset, nullptr if the asset isn't loaded
+AssetRecord *AssetRegistry::Reference(const std::string &key)
+{
+	const auto found = this->assets.find(key);
+	if(found == this->assets.end())
+		return nullptr;
+
+	found->second.references++;
+	found->second.releaseSerial = 0;
+	return &found->second;
+}
+
+void AssetRegistry::Release(const std::string &key)
+{
+	AssetRecord &record = this->assets.at(key);
+	if(record.references == 0)
+	{
+		std::cout << "Asset \"" << key << "\" has been released more times than it was acquired!" << std::endl;
+		exit(-1);
+	}
+
+	if(--record.references == 0)
+		this->released.push_back(key);
+}
+
+// Names under which the asset is acquired again become aliases of the loaded asset
+template<typename T>
+static void AddAlias(ResourceNames<T> &names,AssetRecord &record,const std::string &name,Handle<T> handle)
+{
+	const Handle<T> named = names.Find(name);
+	if(named == handle)
+		return;
+	if(!named.IsNull())
+	{
+		std::cout << "Name \"" << name << "\" is already used by another asset!" << std::endl;
+		exit(-1);
+	}
+
+	record.names.push_back(names.Assign(name,handle));
+}
+
+// Import settings are part of the key, the same file loaded with other settings is a separate asset
+std::string AssetRegistry::ModelKey(const ModelInfo &modelInfo)
+{
+	return "model|" + CanonicalPath(modelInfo.pathToModel) + "|bvh=" + std::to_string(modelInfo.buildBVH) +
+		   "|lods=" + std::to_string(modelInfo.numberOfLODs);
+}
+
+std::string AssetRegistry::TextureKey(const TextureInfo &textureInfo)
+{
+	return "texture|" + CanonicalPath(textureInfo.pathToImage);
+}
+
+// Face order is part of the key, the same images in another order make a different cubemap
+std::string AssetRegistry::CubemapKey(const CubemapTextureInfo &cubemapInfo)
+{
+	std::string key = "cubemap";
+	for(const std::string &path : cubemapInfo.pathsToImages)
+		key += '|' + CanonicalPath(path);
+
+	return key;
+}
+
+ModelHandle AssetRegistry::AddModel(const std::string &key,ModelManager &modelManager,ModelHandle model)
+{
+	this->assets.insert(std::make_pair(key,AssetRecord{
+		.type 		= ASSET_MODEL,
+		.handle 	= model.value,
+		.references = 1,
+		.names 		= {modelManager.models[model].name}
+	}));
+	this->modelKeys.insert(std::make_pair(model.value,key));
+
+	return model;
+}
+
+TextureHandle AssetRegistry::AddTexture(const std::string &key,TextureManager &textureManager,TextureHandle texture)
+{
+	this->assets.insert(std::make_pair(key,AssetRecord{
+		.type 		= ASSET_TEXTURE,
+		.handle 	= texture.value,
+		.references = 1,
+		.names 		= {textureManager.textures[texture].name}
+	}));
+	this->textureKeys.insert(std::make_pair(texture.value,key));
+
+	return texture;
+}
+
+ModelHandle AssetRegistry::AcquireModel(ModelManager &modelManager,const ModelInfo &modelInfo)
+{
+	const std::string key = ModelKey(modelInfo);
+	if(AssetRecord *record = Reference(key))
+	{
+		const ModelHandle model{.value = record->handle};
+		AddAlias(modelManager.modelNames,*record,modelInfo.modelName,model);
+		return model;
+	}
+
+	const ModelHandle model = modelManager.LoadModel(modelInfo);
+	return model.IsNull() ? model : AddModel(key,modelManager,model);
+}
+
+TextureHandle AssetRegistry::AcquireTexture(TextureManager &textureManager,const TextureInfo &textureInfo)
+{
+	const std::string key = TextureKey(textureInfo);
+	if(AssetRecord *record = Reference(key))
+	{
+		const TextureHandle texture{.value = record->handle};
+		AddAlias(textureManager.textureNames,*record,textureInfo.name,texture);
+		return texture;
+	}
+
+	return AddTexture(key,textureManager,textureManager.CreateTextureFromImage(textureInfo));
+}
+
+TextureHandle AssetRegistry::AcquireCubemap(TextureManager &textureManager,const CubemapTextureInfo &cubemapInfo)
+{
+	const std::string key = CubemapKey(cubemapInfo);
+	if(AssetRecord *record = Reference(key))
+	{
+		const TextureHandle texture{.value = record->handle};
+		AddAlias(textureManager.textureNames,*record,cubemapInfo.name,texture);
+		return texture;
+	}
+
+	return AddTexture(key,textureManager,textureManager.CreateCubemapFromImages(cubemapInfo));
+}
+
+// Async acquires run on the main thread except for the load itself. An asset which is already being loaded
+// by another acquire isn't loaded twice, the acquire waits for that load and then references its result
+Task<ModelHandle> AssetRegistry::AcquireModelAsync(JobSystem &jobSystem,ModelManager &modelManager,ModelInfo modelInfo)
+{
+	const std::string key = ModelKey(modelInfo);
+	while(this->loading.contains(key))
+		co_await YieldToMainThread{jobSystem};
+
+	if(AssetRecord *record = Reference(key))
+	{
+		const ModelHandle model{.value = record->handle};
+		AddAlias(modelManager.modelNames,*record,modelInfo.modelName,model);
+		co_return model;
+	}
+
+	this->loading.insert(key);
+	const ModelHandle model = co_await modelManager.LoadModelAsync(modelInfo);
+	this->loading.erase(key);
+
+	co_return model.IsNull() ? model : AddModel(key,modelManager,model);
+}
+
+Task<TextureHandle> AssetRegistry::AcquireTextureAsync(JobSystem &jobSystem,TextureManager &textureManager,TextureInfo textureInfo)
+{
+	const std::string key = TextureKey(textureInfo);
+	while(this->loading.contains(key))
+		co_await YieldToMainThread{jobSystem};
+
+	if(AssetRecord *record = Reference(key))
+	{
+		const TextureHandle texture{.value = record->handle};
+		AddAlias(textureManager.textureNames,*record,textureInfo.name,texture);
+		co_return texture;
+	}
+
+	this->loading.insert(key);
+	const TextureHandle texture = co_await textureManager.LoadTextureAsync(textureInfo);
+	this->loading.erase(key);
+
+	co_return texture.IsNull() ? texture : AddTexture(key,textureManager,texture);
+}
+
+Task<TextureHandle> AssetRegistry::AcquireCubemapAsync(JobSystem &jobSystem,TextureManager &textureManager,CubemapTextureInfo cubemapInfo)
+{
+	const std::string key = CubemapKey(cubemapInfo);
+	while(this->loading.contains(key))
+		co_await YieldToMainThread{jobSystem};
+
+	if(AssetRecord *record = Reference(key))
+	{
+		const TextureHandle texture{.value = record->handle};
+		AddAlias(textureManager.textureNames,*record,cubemapInfo.name,texture);
+		co_return texture;
+	}
+
+	this->loading.insert(key);
+	const TextureHandle texture = co_await textureManager.LoadCubemapAsync(cubemapInfo);
+	this->loading.erase(key);
+
+	co_return texture.IsNull() ? texture : AddTexture(key,textureManager,texture);
+}
+
+void AssetRegistry::ReleaseModel(ModelHandle model)
+{
+	const auto key = this->modelKeys.find(model.value);
+	if(key == this->modelKeys.end())
+	{
+		std::cout << "Model (handle " << model.value << ") wasn't acquired through the asset registry!" << std::endl;
+		exit(-1);
+	}
+
+	Release(key->second);
+}
+
+void AssetRegistry::ReleaseTexture(TextureHandle texture)
+{
+	const auto key = this->textureKeys.find(texture.value);
+	if(key == this->textureKeys.end())
+	{
+		std::cout << "Texture (handle " << texture.value << ") wasn't acquired through the asset registry!" << std::endl;
+		exit(-1);
+	}
+
+	Release(key->second);
+}
+
+// Called once the frame's commands have been submitted. The assets released during the frame get a fence
+// behind those commands, batches whose fences have already been passed by the GPU are destroyed
+void AssetRegistry::EndFrame(ModelManager &modelManager,TextureManager &textureManager)
+{
+	PROFILE_SCOPE("AssetRegistry::EndFrame");
+	if(!this->released.empty())
+	{
+		ReleaseBatch batch = {
+			.fence  = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0),
+			.serial = this->nextSerial++,
+			.keys 	= std::move(this->released)
+		};
+		this->released = {};
+
+		for(const std::string &key : batch.keys)
+			if(AssetRecord &record = this->assets.at(key);record.references == 0)
+				record.releaseSerial = batch.serial;
+
+		this->pendingBatches.push_back(std::move(batch));
+	}
+
+	// fences are signaled in submission order, so the first unsignaled one ends the search
+	while(!this->pendingBatches.empty() && glClientWaitSync(this->pendingBatches.front().fence,0,0) != GL_TIMEOUT_EXPIRED)
+	{
+		DestroyBatch(this->pendingBatches.front(),modelManager,textureManager);
+		this->pendingBatches.pop_front();
+	}
+}
+
+// Waits for the GPU and destroys every released asset, used before the managers are torn down
+void AssetRegistry::Flush(ModelManager &modelManager,TextureManager &textureManager)
+{
+	EndFrame(modelManager,textureManager);
+
+	while(!this->pendingBatches.empty())
+	{
+		ReleaseBatch &batch = this->pendingBatches.front();
+		while(glClientWaitSync(batch.fence,GL_SYNC_FLUSH_COMMANDS_BIT,1'000'000'000) == GL_TIMEOUT_EXPIRED)
+			;
+
+		DestroyBatch(batch,modelManager,textureManager);
+		this->pendingBatches.pop_front();
+	}
+}
+
+// Assets which were acquired again, or released again into a later batch, are skipped
+void AssetRegistry::DestroyBatch(ReleaseBatch &batch,ModelManager &modelManager,TextureManager &textureManager)
+{
+	glDeleteSync(batch.fence);
+
+	for(const std::string &key : batch.keys)
+	{
+		const auto found = this->assets.find(key);
+		if(found == this->assets.end() || found->second.references != 0 || found->second.releaseSerial != batch.serial)
+			continue;
+
+		const AssetRecord &record = found->second;
+		switch(record.type)
+		{
+			case ASSET_MODEL:
+				for(const u32 name : record.names)
+					modelManager.modelNames.Remove(name);
+				modelManager.DeleteModel(ModelHandle{.value = record.handle});
+				this->modelKeys.erase(record.handle);
+				break;
+
+			case ASSET_TEXTURE:
+				for(const u32 name : record.names)
+					textureManager.textureNames.Remove(name);
+				textureManager.DeleteTexture(TextureHandle{.value = record.handle});
+				this->textureKeys.erase(record.handle);
+		}
+
+		this->assets.erase(found);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+
+#include <GLEW/glew.h>
+
+#include "types.hpp"
+#include "handle.hpp"
+#include "modelmanager.hpp"
+#include "texturemanager.hpp"
+#include "jobsystem.hpp"
+#include "task.hpp"
+#include "profiler.hpp"
+
+enum AssetType : u32
+{
+	ASSET_MODEL,
+	ASSET_TEXTURE	// 2D textures and cubemaps
+};
+
+// Loaded file shared by every user that acquired it
+struct AssetRecord
+{
+	AssetType 		 type;
+	u32 			 handle;			 // value of the ModelHandle/TextureHandle in the owning manager
+	u32 			 references = 0;
+	u64 			 releaseSerial = 0;  // batch the asset was last queued for destruction in, 0 while it's referenced
+	std::vector<u32> names;				 // name ids of every name the asset was acquired under
+};
+
+// Assets released during one frame, destroyed once the GPU has passed the fence inserted after the frame
+struct ReleaseBatch
+{
+	GLsync 					 fence;
+	u64 					 serial;
+	std::vector<std::string> keys;
+};
+
+// Deduplicates loads of the same file with the same import settings. Every Acquire of an already loaded
+// asset returns the same handle and adds a reference (and the new name as an alias), the asset is destroyed
+// only after the last reference has been released and the GPU has finished every command submitted until
+// then, so the geometry/texture can't be freed (or its arena range reused) while a draw still reads it.
+// Assets acquired again before their destruction are revived without reloading
+struct AssetRegistry
+{
+	std::unordered_map<std::string,AssetRecord> assets;		// keyed by type, canonical path and import settings
+	std::unordered_map<u32,std::string> 		modelKeys;	// key of every model handle value
+	std::unordered_map<u32,std::string> 		textureKeys;
+	std::vector<std::string> 					released;	// keys released since the last EndFrame
+	std::unordered_set<std::string> 			loading;	// keys of the assets async acquires are loading
+	std::deque<ReleaseBatch> 					pendingBatches;
+	u64 										nextSerial = 1;
+
+	~AssetRegistry();
+
+	ModelHandle   AcquireModel(ModelManager &modelManager,const ModelInfo &modelInfo);
+	TextureHandle AcquireTexture(TextureManager &textureManager,const TextureInfo &textureInfo);
+	TextureHandle AcquireCubemap(TextureManager &textureManager,const CubemapTextureInfo &cubemapInfo);
+
+	Task<ModelHandle> 	AcquireModelAsync(JobSystem &jobSystem,ModelManager &modelManager,ModelInfo modelInfo);
+	Task<TextureHandle> AcquireTextureAsync(JobSystem &jobSystem,TextureManager &textureManager,TextureInfo textureInfo);
+	Task<TextureHandle> AcquireCubemapAsync(JobSystem &jobSystem,TextureManager &textureManager,CubemapTextureInfo cubemapInfo);
+
+	void ReleaseModel(ModelHandle model);
+	void ReleaseTexture(TextureHandle texture);
+
+	void EndFrame(ModelManager &modelManager,TextureManager &textureManager);
+	void Flush(ModelManager &modelManager,TextureManager &textureManager);
+
+	AssetRecord *Reference(const std::string &key);
+	void 		 Release(const std::string &key);
+	void 		 DestroyBatch(ReleaseBatch &batch,ModelManager &modelManager,TextureManager &textureManager);
+
+	ModelHandle   AddModel(const std::string &key,ModelManager &modelManager,ModelHandle model);
+	TextureHandle AddTexture(const std::string &key,TextureManager &textureManager,TextureHandle texture);
+
+	static std::string CanonicalPath(const std::string &path);
+	static std::string ModelKey(const ModelInfo &modelInfo);
+	static std::string TextureKey(const TextureInfo &textureInfo);
+	static std::string CubemapKey(const CubemapTextureInfo &cubemapInfo);
+};
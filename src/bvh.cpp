@@ -0,0 +1,367 @@
+#include "bvh.hpp"
+#include "culling.hpp"
+#include "jobsystem.hpp"
+
+#include <atomic>
+#include <cmath>
+
+void BoundingBox::Grow(const glm::vec3 &point)
+{
+	this->min = glm::min(this->min,point);
+	this->max = glm::max(this->max,point);
+}
+
+void BoundingBox::Grow(const BoundingBox &box)
+{
+	this->min = glm::min(this->min,box.min);
+	this->max = glm::max(this->max,box.max);
+}
+
+glm::vec3 BoundingBox::Center() const
+{
+	return .5f*(this->min + this->max);
+}
+
+// Empty boxes have zero area
+f32 BoundingBox::SurfaceArea() const
+{
+	const glm::vec3 size = glm::max(this->max - this->min,glm::vec3(0.f));
+	return 2.f*(size.x*size.y + size.y*size.z + size.z*size.x);
+}
+
+// Box enclosing the transformed box, its extent is the sum of the absolute values of the transformed axes
+BoundingBox BoundingBox::Transformed(const glm::mat4 &transform) const
+{
+	const glm::vec3 center = Center();
+	const glm::vec3 extent = .5f*(this->max - this->min);
+
+	const glm::mat3 axes(transform);
+	const glm::vec3 worldCenter = glm::vec3(transform*glm::vec4(center,1.f));
+	const glm::vec3 worldExtent = glm::abs(axes[0])*extent.x + glm::abs(axes[1])*extent.y + glm::abs(axes[2])*extent.z;
+
+	return BoundingBox{
+		.min = worldCenter - worldExtent,
+		.max = worldCenter + worldExtent
+	};
+}
+
+// Primitive record used during the build, records are partitioned in place, so the binning passes
+// read memory sequentially instead of gathering boxes through the index array
+struct BVHPrimitive
+{
+	BoundingBox box;
+	glm::vec3 	centroid;
+	u32 		index;
+};
+
+// State shared by the jobs building a BVH
+struct BVHBuildContext
+{
+	BVH 					  &bvh;
+	std::vector<BVHPrimitive>  primitives;
+	std::atomic<u32> 		   nodesUsed;
+	JobSystem 				  *jobSystem; // nullptr builds on the calling thread
+};
+
+static void SetNodeBounds(BVHNode &node,const BoundingBox &box)
+{
+	node.boundsMin = box.min;
+	node.boundsMax = box.max;
+}
+
+// Splits the node's primitive range at the cheapest bin border (surface area heuristic), children
+// are built recursively. Ranges of the children don't overlap, so subtrees can be built concurrently
+static void Subdivide(BVHBuildContext &context,u32 nodeIndex,u32 begin,u32 end,u32 depth)
+{
+	BVH &bvh = context.bvh;
+	BVHPrimitive *primitives = context.primitives.data();
+
+	BoundingBox nodeBox,centroidBox;
+	for(u32 i = begin;i < end;i++)
+	{
+		nodeBox.Grow(primitives[i].box);
+		centroidBox.Grow(primitives[i].centroid);
+	}
+	SetNodeBounds(bvh.nodes[nodeIndex],nodeBox);
+
+	const u32 count = end - begin;
+	auto makeLeaf = [&](){
+		bvh.nodes[nodeIndex].first 				= begin;
+		bvh.nodes[nodeIndex].numberOfPrimitives = count;
+	};
+	if(count <= BVH::maxLeafPrimitives || depth + 2 >= BVH::maxDepth)
+		return makeLeaf();
+
+	struct Bin
+	{
+		BoundingBox box;
+		u32 		count = 0;
+	};
+
+	// cost of a split is relative to the cost of intersecting one primitive, traversing a node costs about the same
+	f32 bestCost  = static_cast<f32>(count);
+	u32 bestAxis  = 0;
+	u32 bestSplit = 0; // primitives in bins below bestSplit go to the left child
+	const glm::vec3 centroidExtent = centroidBox.max - centroidBox.min;
+
+	for(u32 axis = 0;axis < 3;axis++)
+	{
+		if(centroidExtent[axis] <= 0.f)
+			continue;
+
+		std::array<Bin,BVH::numberOfBins> bins;
+		const f32 scale = BVH::numberOfBins/centroidExtent[axis];
+		for(u32 i = begin;i < end;i++)
+		{
+			const u32 bin = std::min(BVH::numberOfBins - 1,static_cast<u32>((primitives[i].centroid[axis] - centroidBox.min[axis])*scale));
+			bins[bin].box.Grow(primitives[i].box);
+			bins[bin].count++;
+		}
+
+		// areas of the left sides are accumulated from the left, right sides from the right
+		std::array<f32,BVH::numberOfBins> leftCosts;
+		BoundingBox leftBox;
+		u32 leftCount = 0;
+		for(u32 bin = 0;bin < BVH::numberOfBins - 1;bin++)
+		{
+			leftBox.Grow(bins[bin].box);
+			leftCount += bins[bin].count;
+			leftCosts[bin + 1] = leftBox.SurfaceArea()*leftCount;
+		}
+
+		BoundingBox rightBox;
+		u32 rightCount = 0;
+		for(u32 bin = BVH::numberOfBins - 1;bin > 0;bin--)
+		{
+			rightBox.Grow(bins[bin].box);
+			rightCount += bins[bin].count;
+
+			const f32 cost = 1.f + (leftCosts[bin] + rightBox.SurfaceArea()*rightCount)/nodeBox.SurfaceArea();
+			if(cost < bestCost && rightCount != 0 && rightCount != count)
+			{
+				bestCost  = cost;
+				bestAxis  = axis;
+				bestSplit = bin;
+			}
+		}
+	}
+
+	u32 middle;
+	if(bestSplit != 0)
+	{
+		const f32 scale = BVH::numberOfBins/centroidExtent[bestAxis];
+		middle = std::partition(primitives + begin,primitives + end,[&](const BVHPrimitive &primitive){
+			const u32 bin = std::min(BVH::numberOfBins - 1,static_cast<u32>((primitive.centroid[bestAxis] - centroidBox.min[bestAxis])*scale));
+			return bin < bestSplit;
+		}) - primitives;
+	}
+	else if(count <= 4*BVH::maxLeafPrimitives) // no split is cheaper than intersecting all the primitives
+		return makeLeaf();
+	else // all centroids are in a single bin, the range is split in half along the widest axis
+	{
+		const u32 axis = centroidExtent.x > centroidExtent.y ? (centroidExtent.x > centroidExtent.z ? 0 : 2) : (centroidExtent.y > centroidExtent.z ? 1 : 2);
+		middle = begin + count/2;
+		std::nth_element(primitives + begin,primitives + middle,primitives + end,[axis](const BVHPrimitive &a,const BVHPrimitive &b){
+			return a.centroid[axis] < b.centroid[axis];
+		});
+	}
+
+	const u32 firstChild = context.nodesUsed.fetch_add(2);
+	bvh.nodes[nodeIndex].first 				= firstChild;
+	bvh.nodes[nodeIndex].numberOfPrimitives = 0;
+
+	if(count >= BVH::parallelBuildThreshold && context.jobSystem)
+	{
+		JobCounter left;
+		context.jobSystem->Schedule([&context,firstChild,begin,middle,depth](){
+			Subdivide(context,firstChild,begin,middle,depth + 1);
+		},&left);
+		Subdivide(context,firstChild + 1,middle,end,depth + 1);
+		context.jobSystem->Wait(left);
+	}
+	else
+	{
+		Subdivide(context,firstChild,begin,middle,depth + 1);
+		Subdivide(context,firstChild + 1,middle,end,depth + 1);
+	}
+}
+
+void BVH::Build(const std::vector<BoundingBox> &bounds,JobSystem *jobSystem)
+{
+	PROFILE_SCOPE("BVH::Build");
+	const u32 numberOfPrimitives = bounds.size();
+
+	this->nodes.clear();
+	this->primitiveIndices.resize(numberOfPrimitives);
+	this->primitiveBounds.resize(numberOfPrimitives);
+	if(numberOfPrimitives == 0)
+		return;
+
+	// every split produces 2 non-empty children, so there are at most 2n - 1 nodes
+	this->nodes.resize(2*numberOfPrimitives - 1);
+
+	BVHBuildContext context{
+		.bvh 			  = *this,
+		.primitives 	  = std::vector<BVHPrimitive>(numberOfPrimitives),
+		.nodesUsed 		  = 1,
+		.jobSystem 		  = jobSystem
+	};
+	for(u32 i = 0;i < numberOfPrimitives;i++)
+		context.primitives[i] = BVHPrimitive{
+			.box 	  = bounds[i],
+			.centroid = bounds[i].Center(),
+			.index 	  = i
+		};
+
+	Subdivide(context,0,0,numberOfPrimitives,0);
+
+	this->nodes.resize(context.nodesUsed);
+	for(u32 i = 0;i < numberOfPrimitives;i++)
+	{
+		this->primitiveIndices[i] = context.primitives[i].index;
+		this->primitiveBounds[i]  = context.primitives[i].box;
+	}
+}
+
+// Children are always stored after their parent, so visiting the nodes in reverse updates children first
+void BVH::Refit(const std::vector<BoundingBox> &bounds)
+{
+	PROFILE_SCOPE("BVH::Refit");
+	for(u32 i = this->nodes.size();i-- > 0;)
+	{
+		BVHNode &node = this->nodes[i];
+
+		BoundingBox box;
+		if(node.numberOfPrimitives != 0)
+			for(u32 primitive = node.first;primitive < node.first + node.numberOfPrimitives;primitive++)
+			{
+				this->primitiveBounds[primitive] = bounds[this->primitiveIndices[primitive]];
+				box.Grow(this->primitiveBounds[primitive]);
+			}
+		else
+			for(const BVHNode &child : {this->nodes[node.first],this->nodes[node.first + 1]})
+				box.Grow(BoundingBox{.min = child.boundsMin,.max = child.boundsMax});
+
+		SetNodeBounds(node,box);
+	}
+}
+
+// Primitives of nodes completely inside the frustum are added without testing their descendants
+void BVH::QueryFrustum(const Frustum &frustum,std::vector<u32> &primitives) const
+{
+	if(this->nodes.empty())
+		return;
+
+	// 0 if the box is outside, 1 if it intersects the frustum, 2 if it's completely inside
+	auto classify = [&frustum](const glm::vec3 &boundsMin,const glm::vec3 &boundsMax){
+		const glm::vec3 center = .5f*(boundsMin + boundsMax);
+		const glm::vec3 extent = .5f*(boundsMax - boundsMin);
+
+		u32 result = 2;
+		for(const glm::vec4 &plane : frustum.planes)
+		{
+			const f32 distance = glm::dot(glm::vec3(plane),center) + plane.w;
+			const f32 radius   = glm::dot(glm::abs(glm::vec3(plane)),extent);
+			if(distance + radius < 0.f)
+				return 0u;
+			if(distance - radius < 0.f)
+				result = 1;
+		}
+		return result;
+	};
+
+	std::array<std::pair<u32,bool>,maxDepth> stack; // node, whether it's already known to be inside
+	u32 stackSize = 0;
+	stack[stackSize++] = {0,false};
+
+	while(stackSize > 0)
+	{
+		auto [nodeIndex,inside] = stack[--stackSize];
+		const BVHNode &node = this->nodes[nodeIndex];
+
+		if(!inside)
+		{
+			const u32 classification = classify(node.boundsMin,node.boundsMax);
+			if(classification == 0)
+				continue;
+			inside = classification == 2;
+		}
+
+		if(node.numberOfPrimitives != 0)
+		{
+			for(u32 i = node.first;i < node.first + node.numberOfPrimitives;i++)
+				if(inside || classify(this->primitiveBounds[i].min,this->primitiveBounds[i].max) != 0)
+					primitives.push_back(this->primitiveIndices[i]);
+		}
+		else
+		{
+			stack[stackSize++] = {node.first,inside};
+			stack[stackSize++] = {node.first + 1,inside};
+		}
+	}
+}
+
+// Slab test, returns the distance at which the ray enters the node (0 if it starts inside), or tMax if it misses
+f32 BVH::IntersectNode(const BVHNode &node,const glm::vec3 &origin,const glm::vec3 &inverseDirection,f32 tMax)
+{
+	const glm::vec3 t0 = (node.boundsMin - origin)*inverseDirection;
+	const glm::vec3 t1 = (node.boundsMax - origin)*inverseDirection;
+
+	const glm::vec3 tNear = glm::min(t0,t1);
+	const glm::vec3 tFar  = glm::max(t0,t1);
+
+	const f32 enter = std::max(std::max(tNear.x,tNear.y),std::max(tNear.z,0.f));
+	const f32 exit  = std::min(std::min(tFar.x,tFar.y),std::min(tFar.z,tMax));
+
+	return enter <= exit ? enter : tMax;
+}
+
+void MeshBVH::Build(const std::vector<glm::vec3> &positions,const std::vector<u32> &indices,JobSystem *jobSystem)
+{
+	PROFILE_SCOPE("MeshBVH::Build");
+	const u32 numberOfTriangles = indices.size()/3;
+
+	this->triangles.resize(3*numberOfTriangles);
+	std::vector<BoundingBox> bounds(numberOfTriangles);
+	for(u32 triangle = 0;triangle < numberOfTriangles;triangle++)
+		for(u32 vertex = 0;vertex < 3;vertex++)
+		{
+			this->triangles[3*triangle + vertex] = positions[indices[3*triangle + vertex]];
+			bounds[triangle].Grow(this->triangles[3*triangle + vertex]);
+		}
+
+	this->bvh.Build(bounds,jobSystem);
+}
+
+RayHit MeshBVH::CastRay(const Ray &ray) const
+{
+	return this->bvh.CastRay(ray,[this](u32 triangle,const Ray &ray,f32 tMax){
+		return IntersectTriangle(ray,this->triangles[3*triangle],this->triangles[3*triangle + 1],this->triangles[3*triangle + 2],tMax);
+	});
+}
+
+// Moller-Trumbore, both sides of the triangle are hit
+f32 MeshBVH::IntersectTriangle(const Ray &ray,const glm::vec3 &vertex0,const glm::vec3 &vertex1,const glm::vec3 &vertex2,f32 tMax)
+{
+	const glm::vec3 edge1 = vertex1 - vertex0;
+	const glm::vec3 edge2 = vertex2 - vertex0;
+
+	const glm::vec3 p 		  = glm::cross(ray.direction,edge2);
+	const f32 		determinant = glm::dot(edge1,p);
+	if(std::abs(determinant) < 1e-8f) // ray is parallel to the triangle
+		return tMax;
+
+	const f32 		inverseDeterminant = 1.f/determinant;
+	const glm::vec3 s = ray.origin - vertex0;
+	const f32 		u = glm::dot(s,p)*inverseDeterminant;
+	if(u < 0.f || u > 1.f)
+		return tMax;
+
+	const glm::vec3 q = glm::cross(s,edge1);
+	const f32 		v = glm::dot(ray.direction,q)*inverseDeterminant;
+	if(v < 0.f || u + v > 1.f)
+		return tMax;
+
+	const f32 t = glm::dot(edge2,q)*inverseDeterminant;
+	return t >= 0.f && t < tMax ? t : tMax;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <limits>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "types.hpp"
+#include "profiler.hpp"
+
+struct Frustum;
+struct JobSystem;
+
+struct BoundingBox
+{
+	glm::vec3 min = glm::vec3(std::numeric_limits<f32>::max());	// empty box, any point grows it
+	glm::vec3 max = glm::vec3(std::numeric_limits<f32>::lowest());
+
+	void Grow(const glm::vec3 &point);
+	void Grow(const BoundingBox &box);
+
+	glm::vec3 	Center() const;
+	f32 		SurfaceArea() const;
+	BoundingBox Transformed(const glm::mat4 &transform) const;
+};
+
+// Interior nodes store the index of the first of their two (adjacent) children, leaves store a range of primitiveIndices
+struct BVHNode
+{
+	glm::vec3 boundsMin;
+	u32 	  first; 				// first child if numberOfPrimitives is 0, otherwise first primitive
+	glm::vec3 boundsMax;
+	u32 	  numberOfPrimitives; 	// 0 for interior nodes
+};
+
+struct Ray
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	f32 	  tMax = std::numeric_limits<f32>::max(); // hits further than tMax*direction are ignored
+};
+
+struct RayHit
+{
+	f32 t 		  = std::numeric_limits<f32>::max();
+	u32 primitive = ~0u; // ~0u if nothing was hit
+};
+
+// Bounding volume hierarchy over arbitrary primitives given by their bounding boxes. Built with binned SAH,
+// nodes are stored in a single array (root at index 0, children after their parent), so the tree can be
+// refitted in one reverse pass when the primitives move without changing the topology.
+// Large subtrees are built by separate jobs when a job system is given
+struct BVH
+{
+	static constexpr u32 maxLeafPrimitives 		= 4;
+	static constexpr u32 numberOfBins 			= 16;		// candidate split planes per axis are the bin borders
+	static constexpr u32 parallelBuildThreshold = 1 << 14; 	// subtrees with fewer primitives are built by the current job
+	static constexpr u32 maxDepth 				= 64;		// size of the traversal stacks
+
+	std::vector<BVHNode> 	 nodes;
+	std::vector<u32> 	 	 primitiveIndices; // primitives referenced by the leaves, grouped by leaf
+	std::vector<BoundingBox> primitiveBounds;  // bounds of the primitives, in the order of primitiveIndices
+
+	void Build(const std::vector<BoundingBox> &bounds,JobSystem *jobSystem = nullptr);
+	void Refit(const std::vector<BoundingBox> &bounds);
+
+	void QueryFrustum(const Frustum &frustum,std::vector<u32> &primitives) const;
+
+	// intersect(primitive,ray,tMax) returns the distance to the primitive, or a value >= tMax if it isn't hit.
+	// Returns the closest hit, nearer children are visited first so most far subtrees are skipped
+	template<typename IntersectFunction>
+	RayHit CastRay(const Ray &ray,IntersectFunction &&intersect) const
+	{
+		RayHit hit;
+		hit.t = ray.tMax;
+		if(this->nodes.empty())
+			return hit;
+
+		const glm::vec3 inverseDirection = 1.f/ray.direction;
+
+		std::array<u32,maxDepth> stack;
+		u32 stackSize = 0;
+		if(IntersectNode(this->nodes[0],ray.origin,inverseDirection,hit.t) < hit.t)
+			stack[stackSize++] = 0;
+
+		while(stackSize > 0)
+		{
+			const BVHNode &node = this->nodes[stack[--stackSize]];
+			if(IntersectNode(node,ray.origin,inverseDirection,hit.t) >= hit.t) // a closer hit was found since the node was pushed
+				continue;
+
+			if(node.numberOfPrimitives != 0)
+			{
+				for(u32 i = node.first;i < node.first + node.numberOfPrimitives;i++)
+				{
+					const f32 t = intersect(this->primitiveIndices[i],ray,hit.t);
+					if(t < hit.t)
+					{
+						hit.t 		  = t;
+						hit.primitive = this->primitiveIndices[i];
+					}
+				}
+				continue;
+			}
+
+			u32 near = node.first,far = node.first + 1;
+			f32 nearT = IntersectNode(this->nodes[near],ray.origin,inverseDirection,hit.t);
+			f32 farT  = IntersectNode(this->nodes[far],ray.origin,inverseDirection,hit.t);
+			if(farT < nearT)
+			{
+				std::swap(near,far);
+				std::swap(nearT,farT);
+			}
+
+			// near child is pushed last, so it's popped first
+			if(farT < hit.t)
+				stack[stackSize++] = far;
+			if(nearT < hit.t)
+				stack[stackSize++] = near;
+		}
+
+		return hit;
+	}
+
+	static f32 IntersectNode(const BVHNode &node,const glm::vec3 &origin,const glm::vec3 &inverseDirection,f32 tMax);
+};
+
+// BVH over the triangles of a mesh, used for picking and line of sight queries
+struct MeshBVH
+{
+	BVH 				   bvh;
+	std::vector<glm::vec3> triangles; // 3 vertices per triangle, in the order of the index buffer
+
+	void   Build(const std::vector<glm::vec3> &positions,const std::vector<u32> &indices,JobSystem *jobSystem = nullptr);
+	RayHit CastRay(const Ray &ray) const;
+
+	static f32 IntersectTriangle(const Ray &ray,const glm::vec3 &vertex0,const glm::vec3 &vertex1,const glm::vec3 &vertex2,f32 tMax);
+};
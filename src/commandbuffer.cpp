@@ -0,0 +1,179 @@
+#include "commandbuffer.hpp"
+
+void CommandBuffer::UseProgram(u32 programID)
+{
+	*Push<UseProgramCommand>(COMMAND_USE_PROGRAM) = {programID};
+}
+
+void CommandBuffer::BindTexture(u32 unit,u32 target,u32 textureID)
+{
+	*Push<BindTextureCommand>(COMMAND_BIND_TEXTURE) = {unit,target,textureID};
+}
+
+void CommandBuffer::BindVertexArray(u32 vertexArrayID)
+{
+	*Push<BindVertexArrayCommand>(COMMAND_BIND_VERTEX_ARRAY) = {vertexArrayID};
+}
+
+void CommandBuffer::BindBufferBase(u32 target,u32 index,u32 bufferID)
+{
+	*Push<BindBufferBaseCommand>(COMMAND_BIND_BUFFER_BASE) = {target,index,bufferID};
+}
+
+// Binds per-instance data to binding 1 of the vertex array bound at replay time
+void CommandBuffer::BindInstanceBuffer(u32 bufferID,u32 stride)
+{
+	*Push<BindInstanceBufferCommand>(COMMAND_BIND_INSTANCE_BUFFER) = {bufferID,stride};
+}
+
+void CommandBuffer::SetDepthFunction(u32 function)
+{
+	*Push<SetDepthFunctionCommand>(COMMAND_SET_DEPTH_FUNCTION) = {function};
+}
+
+void CommandBuffer::SetDepthMask(bool enabled)
+{
+	*Push<SetFlagCommand>(COMMAND_SET_DEPTH_MASK) = {enabled};
+}
+
+void CommandBuffer::SetBlend(bool enabled)
+{
+	*Push<SetFlagCommand>(COMMAND_SET_BLEND) = {enabled};
+}
+
+void CommandBuffer::SetBlendFunction(u32 source,u32 destination)
+{
+	*Push<SetBlendFunctionCommand>(COMMAND_SET_BLEND_FUNCTION) = {source,destination};
+}
+
+// Data is copied into the command buffer, so the source can change right after recording
+void CommandBuffer::UpdateBuffer(u32 target,u32 bufferID,u32 offset,u32 size,const void *data)
+{
+	UpdateBufferCommand *command = Push<UpdateBufferCommand>(COMMAND_UPDATE_BUFFER,size);
+	*command = {target,bufferID,offset,size};
+	std::memcpy(command + 1,data,size);
+}
+
+// Indexed draw from the bound vertex array, instanceCount of 0 issues a non-instanced draw
+void CommandBuffer::DrawElements(u32 count,u32 firstIndex,i32 baseVertex,u32 instanceCount)
+{
+	*Push<DrawElementsCommand>(COMMAND_DRAW_ELEMENTS) = {count,firstIndex,baseVertex,instanceCount};
+}
+
+// Batch is filled while recording and uploaded when the command is replayed, so it has to outlive the replay
+void CommandBuffer::SubmitBatch(DrawBatch *batch)
+{
+	*Push<SubmitBatchCommand>(COMMAND_SUBMIT_BATCH) = {batch};
+}
+
+// GPU zones are only timed if a profiler is passed to Execute, the name has to outlive the replay
+void CommandBuffer::BeginGPUZone(const char *name)
+{
+	*Push<GPUZoneCommand>(COMMAND_BEGIN_GPU_ZONE) = {name};
+}
+
+void CommandBuffer::EndGPUZone()
+{
+	*Push<GPUZoneCommand>(COMMAND_END_GPU_ZONE) = {nullptr};
+}
+
+void CommandBuffer::Clear()
+{
+	this->storage.clear();
+	this->numberOfCommands = 0;
+}
+
+// Replays the commands through the state cache, which drops state already set by a previous buffer
+void CommandBuffer::Execute(GLState &glState,GPUProfiler *gpuProfiler) const
+{
+	const u8 *position = this->storage.data();
+	const u8 *end 	   = position + this->storage.size();
+
+	while(position < end)
+	{
+		const CommandHeader *header = reinterpret_cast<const CommandHeader*>(position);
+		const void *payload = header + 1;
+
+		switch(header->type)
+		{
+			case COMMAND_USE_PROGRAM:
+				glState.UseProgram(static_cast<const UseProgramCommand*>(payload)->programID);
+				break;
+
+			case COMMAND_BIND_TEXTURE:
+			{
+				const BindTextureCommand *command = static_cast<const BindTextureCommand*>(payload);
+				glState.BindTexture(command->unit,command->target,command->textureID);
+				break;
+			}
+			case COMMAND_BIND_VERTEX_ARRAY:
+				glState.BindVertexArray(static_cast<const BindVertexArrayCommand*>(payload)->vertexArrayID);
+				break;
+
+			case COMMAND_BIND_BUFFER_BASE:
+			{
+				const BindBufferBaseCommand *command = static_cast<const BindBufferBaseCommand*>(payload);
+				glState.BindBufferBase(command->target,command->index,command->bufferID);
+				break;
+			}
+			case COMMAND_BIND_INSTANCE_BUFFER:
+			{
+				const BindInstanceBufferCommand *command = static_cast<const BindInstanceBufferCommand*>(payload);
+				glBindVertexBuffer(1,command->bufferID,0,command->stride);
+				break;
+			}
+			case COMMAND_SET_DEPTH_FUNCTION:
+				glState.SetDepthFunction(static_cast<const SetDepthFunctionCommand*>(payload)->function);
+				break;
+
+			case COMMAND_SET_DEPTH_MASK:
+				glState.SetDepthMask(static_cast<const SetFlagCommand*>(payload)->enabled);
+				break;
+
+			case COMMAND_SET_BLEND:
+				glState.SetBlend(static_cast<const SetFlagCommand*>(payload)->enabled);
+				break;
+
+			case COMMAND_SET_BLEND_FUNCTION:
+			{
+				const SetBlendFunctionCommand *command = static_cast<const SetBlendFunctionCommand*>(payload);
+				glState.SetBlendFunction(command->source,command->destination);
+				break;
+			}
+			case COMMAND_UPDATE_BUFFER:
+			{
+				const UpdateBufferCommand *command = static_cast<const UpdateBufferCommand*>(payload);
+				glBindBuffer(command->target,command->bufferID);
+				glBufferSubData(command->target,command->offset,command->size,command + 1);
+				break;
+			}
+			case COMMAND_DRAW_ELEMENTS:
+			{
+				const DrawElementsCommand *command = static_cast<const DrawElementsCommand*>(payload);
+				void *firstIndex = reinterpret_cast<void*>(static_cast<u64>(command->firstIndex)*sizeof(u32));
+
+				if(command->instanceCount == 0)
+					glDrawElementsBaseVertex(GL_TRIANGLES,command->count,GL_UNSIGNED_INT,firstIndex,command->baseVertex);
+				else
+					glDrawElementsInstancedBaseVertex(GL_TRIANGLES,command->count,GL_UNSIGNED_INT,firstIndex,
+													  command->instanceCount,command->baseVertex);
+				break;
+			}
+			case COMMAND_SUBMIT_BATCH:
+				static_cast<const SubmitBatchCommand*>(payload)->batch->Submit(glState);
+				break;
+
+			case COMMAND_BEGIN_GPU_ZONE:
+				if(gpuProfiler)
+					gpuProfiler->BeginZone(static_cast<const GPUZoneCommand*>(payload)->name);
+				break;
+
+			case COMMAND_END_GPU_ZONE:
+				if(gpuProfiler)
+					gpuProfiler->EndZone();
+				break;
+		}
+
+		position += sizeof(CommandHeader) + header->size;
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+#include <GLEW/glew.h>
+
+#include "types.hpp"
+#include "glstate.hpp"
+#include "drawbatch.hpp"
+#include "gpuprofiler.hpp"
+
+enum CommandType : u32
+{
+	COMMAND_USE_PROGRAM,
+	COMMAND_BIND_TEXTURE,
+	COMMAND_BIND_VERTEX_ARRAY,
+	COMMAND_BIND_BUFFER_BASE,
+	COMMAND_BIND_INSTANCE_BUFFER,
+	COMMAND_SET_DEPTH_FUNCTION,
+	COMMAND_SET_DEPTH_MASK,
+	COMMAND_SET_BLEND,
+	COMMAND_SET_BLEND_FUNCTION,
+	COMMAND_UPDATE_BUFFER,
+	COMMAND_DRAW_ELEMENTS,
+	COMMAND_SUBMIT_BATCH,
+	COMMAND_BEGIN_GPU_ZONE,
+	COMMAND_END_GPU_ZONE
+};
+
+// Precedes the payload of every recorded command
+struct CommandHeader
+{
+	CommandType type;
+	u32 		size; // size of the payload (including inline data), rounded up to 8 bytes
+};
+
+struct UseProgramCommand 	 	{ u32 programID; };
+struct BindTextureCommand 	 	{ u32 unit; u32 target; u32 textureID; };
+struct BindVertexArrayCommand 	{ u32 vertexArrayID; };
+struct BindBufferBaseCommand 	{ u32 target; u32 index; u32 bufferID; };
+struct BindInstanceBufferCommand{ u32 bufferID; u32 stride; };
+struct SetDepthFunctionCommand 	{ u32 function; };
+struct SetFlagCommand 		 	{ u32 enabled; };
+struct SetBlendFunctionCommand 	{ u32 source; u32 destination; };
+struct UpdateBufferCommand 	 	{ u32 target; u32 bufferID; u32 offset; u32 size; }; // followed by size bytes of data
+struct DrawElementsCommand 	 	{ u32 count; u32 firstIndex; i32 baseVertex; u32 instanceCount; };
+struct SubmitBatchCommand 	 	{ DrawBatch *batch; };
+struct GPUZoneCommand 		 	{ const char *name; };
+
+// Linear buffer of recorded GL work. Recording only writes into memory, so it can run on any thread,
+// the commands are then replayed on the thread owning the GL context. Storage is kept between frames,
+// so recording into a cleared buffer doesn't allocate once the buffer has reached its working size
+struct CommandBuffer
+{
+	std::vector<u8> storage;
+	u32 			numberOfCommands = 0;
+
+	void UseProgram(u32 programID);
+	void BindTexture(u32 unit,u32 target,u32 textureID);
+	void BindVertexArray(u32 vertexArrayID);
+	void BindBufferBase(u32 target,u32 index,u32 bufferID);
+	void BindInstanceBuffer(u32 bufferID,u32 stride);
+	void SetDepthFunction(u32 function);
+	void SetDepthMask(bool enabled);
+	void SetBlend(bool enabled);
+	void SetBlendFunction(u32 source,u32 destination);
+	void UpdateBuffer(u32 target,u32 bufferID,u32 offset,u32 size,const void *data);
+	void DrawElements(u32 count,u32 firstIndex,i32 baseVertex,u32 instanceCount);
+	void SubmitBatch(DrawBatch *batch);
+	void BeginGPUZone(const char *name);
+	void EndGPUZone();
+
+	void Clear();
+	void Execute(GLState &glState,GPUProfiler *gpuProfiler = nullptr) const;
+
+	// Reserves space for the header and payload, extra bytes of inline data can follow the payload
+	template<typename T>
+	T *Push(CommandType type,u32 extraBytes = 0)
+	{
+		const u32 payloadSize = (sizeof(T) + extraBytes + 7) & ~7u;
+		const u64 offset 	  = this->storage.size();
+		this->storage.resize(offset + sizeof(CommandHeader) + payloadSize);
+
+		CommandHeader *header = reinterpret_cast<CommandHeader*>(this->storage.data() + offset);
+		header->type = type;
+		header->size = payloadSize;
+		this->numberOfCommands++;
+
+		return reinterpret_cast<T*>(header + 1);
+	}
+};
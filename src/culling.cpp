@@ -0,0 +1,201 @@
+#include "culling.hpp"
+
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+	#include <immintrin.h>
+#endif
+
+// Gribb-Hartmann extraction, the planes are combinations of the rows of the view-projection matrix
+Frustum Frustum::FromViewProjection(const glm::mat4 &viewProjection)
+{
+	const glm::mat4 rows = glm::transpose(viewProjection);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+
+	for(glm::vec4 &plane : frustum.planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	return frustum;
+}
+
+// Bounds are the model's object space box transformed by the item's transform
+void FrustumCuller::Submit(const RenderItem &item)
+{
+	const BoundingBox modelBox{
+		.min = item.model->boundsMin,
+		.max = item.model->boundsMax
+	};
+	const BoundingBox worldBox = modelBox.Transformed(item.transform);
+
+	Submit(item,worldBox.min,worldBox.max);
+}
+
+// Bounds are given in world space, the overload above derives them from the model's bounds and transform
+void FrustumCuller::Submit(const RenderItem &item,const glm::vec3 &boundsMin,const glm::vec3 &boundsMax)
+{
+	const glm::vec3 center = .5f*(boundsMin + boundsMax);
+	const glm::vec3 extent = .5f*(boundsMax - boundsMin);
+
+	this->items.push_back(item);
+	this->centersX.push_back(center.x);
+	this->centersY.push_back(center.y);
+	this->centersZ.push_back(center.z);
+	this->extentsX.push_back(extent.x);
+	this->extentsY.push_back(extent.y);
+	this->extentsZ.push_back(extent.z);
+}
+
+void FrustumCuller::Cull(const Frustum &frustum,RenderQueue &renderQueue,const OcclusionCuller *occlusionCuller,const BVH *hierarchy)
+{
+	PROFILE_SCOPE("FrustumCuller::Cull");
+	const u32 numberOfItems = this->items.size();
+	if(hierarchy && hierarchy->primitiveIndices.size() != numberOfItems)
+	{
+		std::cout << "Culling hierarchy has " << hierarchy->primitiveIndices.size() << " primitives for " 
+				  << numberOfItems << " items!" << std::endl;
+		exit(-1);
+	}
+
+	// arrays are padded to whole batches, the padding results are ignored
+	const u32 paddedSize = (numberOfItems + batchSize - 1)/batchSize*batchSize;
+	for(std::pmr::vector<f32> *array : {&this->centersX,&this->centersY,&this->centersZ,&this->extentsX,&this->extentsY,&this->extentsZ})
+		array->resize(paddedSize,0.f);
+
+	this->visibleItems.clear();
+	if(hierarchy)
+	{
+		this->queriedItems.clear();
+		hierarchy->QueryFrustum(frustum,this->queriedItems);
+		std::sort(this->queriedItems.begin(),this->queriedItems.end()); // same order as the batched test
+		this->visibleItems.assign(this->queriedItems.begin(),this->queriedItems.end());
+	}
+	else
+		for(u32 batch = 0;batch < paddedSize;batch += batchSize)
+		{
+			u32 mask = TestBatch(frustum,&this->centersX[batch],&this->centersY[batch],&this->centersZ[batch],
+								 &this->extentsX[batch],&this->extentsY[batch],&this->extentsZ[batch]);
+
+			for(;mask != 0;mask &= mask - 1)
+			{
+				const u32 item = batch + std::countr_zero(mask);
+				if(item < numberOfItems)
+					this->visibleItems.push_back(item);
+			}
+		}
+
+	// only the items which survived the frustum test are projected
+	const u32 insideFrustum = this->visibleItems.size();
+	if(occlusionCuller)
+		std::erase_if(this->visibleItems,[this,occlusionCuller](u32 item){
+			const glm::vec3 center(this->centersX[item],this->centersY[item],this->centersZ[item]);
+			const glm::vec3 extent(this->extentsX[item],this->extentsY[item],this->extentsZ[item]);
+			return !occlusionCuller->IsVisible(BoundingBox{.min = center - extent,.max = center + extent});
+		});
+
+	for(u32 item : this->visibleItems)
+		renderQueue.Submit(this->items[item]);
+
+	this->statistics.visibleItems  = this->visibleItems.size();
+	this->statistics.culledItems   = numberOfItems - this->visibleItems.size();
+	this->statistics.occludedItems = insideFrustum - this->visibleItems.size();
+	this->statistics.totalVisible  += this->statistics.visibleItems;
+	this->statistics.totalCulled   += this->statistics.culledItems;
+	this->statistics.totalOccluded += this->statistics.occludedItems;
+	this->statistics.frames++;
+}
+
+void FrustumCuller::Clear(std::pmr::memory_resource *frameResource)
+{
+	RebindToFrame(this->items,frameResource);
+	for(std::pmr::vector<f32> *array : {&this->centersX,&this->centersY,&this->centersZ,&this->extentsX,&this->extentsY,&this->extentsZ})
+		RebindToFrame(*array,frameResource);
+	RebindToFrame(this->visibleItems,frameResource);
+}
+
+void FrustumCuller::PrintStatistics() const
+{
+	const u64 frames = std::max<u64>(this->statistics.frames,1);
+
+	std::cout << "Frustum culling, visible items per frame: " << static_cast<f64>(this->statistics.totalVisible)/frames
+			  << ", culled: " << static_cast<f64>(this->statistics.totalCulled)/frames
+			  << " (occluded: " << static_cast<f64>(this->statistics.totalOccluded)/frames << ')'
+			  << " (last frame " << this->statistics.visibleItems << '/' << this->statistics.culledItems << ')' << std::endl;
+}
+
+// Returns a mask with bit i set if box i intersects the frustum. A box is outside when it lies entirely
+// behind any plane, i.e. dot(normal,center) + distance < -dot(abs(normal),extent)
+u32 FrustumCuller::TestBatch(const Frustum &frustum,const f32 *centersX,const f32 *centersY,const f32 *centersZ,
+							 const f32 *extentsX,const f32 *extentsY,const f32 *extentsZ)
+{
+#if defined(__AVX__)
+	const __m256 centerX = _mm256_loadu_ps(centersX);
+	const __m256 centerY = _mm256_loadu_ps(centersY);
+	const __m256 centerZ = _mm256_loadu_ps(centersZ);
+	const __m256 extentX = _mm256_loadu_ps(extentsX);
+	const __m256 extentY = _mm256_loadu_ps(extentsY);
+	const __m256 extentZ = _mm256_loadu_ps(extentsZ);
+
+	__m256 outside = _mm256_setzero_ps();
+	for(const glm::vec4 &plane : frustum.planes)
+	{
+		const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(centerX,_mm256_set1_ps(plane.x)),
+															_mm256_mul_ps(centerY,_mm256_set1_ps(plane.y))),
+											  _mm256_add_ps(_mm256_mul_ps(centerZ,_mm256_set1_ps(plane.z)),
+											  				_mm256_set1_ps(plane.w)));
+		const __m256 radius   = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(extentX,_mm256_set1_ps(std::abs(plane.x))),
+															_mm256_mul_ps(extentY,_mm256_set1_ps(std::abs(plane.y)))),
+															_mm256_mul_ps(extentZ,_mm256_set1_ps(std::abs(plane.z))));
+		outside = _mm256_or_ps(outside,_mm256_cmp_ps(_mm256_add_ps(distance,radius),_mm256_setzero_ps(),_CMP_LT_OQ));
+	}
+
+	return ~_mm256_movemask_ps(outside) & 0xFF;
+#elif defined(__SSE__) || defined(_M_X64)
+	// two halves of the batch
+	u32 mask = 0;
+	for(u32 half = 0;half < 2;half++)
+	{
+		const __m128 centerX = _mm_loadu_ps(centersX + 4*half);
+		const __m128 centerY = _mm_loadu_ps(centersY + 4*half);
+		const __m128 centerZ = _mm_loadu_ps(centersZ + 4*half);
+		const __m128 extentX = _mm_loadu_ps(extentsX + 4*half);
+		const __m128 extentY = _mm_loadu_ps(extentsY + 4*half);
+		const __m128 extentZ = _mm_loadu_ps(extentsZ + 4*half);
+
+		__m128 outside = _mm_setzero_ps();
+		for(const glm::vec4 &plane : frustum.planes)
+		{
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX,_mm_set1_ps(plane.x)),
+														  _mm_mul_ps(centerY,_mm_set1_ps(plane.y))),
+											   _mm_add_ps(_mm_mul_ps(centerZ,_mm_set1_ps(plane.z)),
+											   			  _mm_set1_ps(plane.w)));
+			const __m128 radius   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX,_mm_set1_ps(std::abs(plane.x))),
+														  _mm_mul_ps(extentY,_mm_set1_ps(std::abs(plane.y)))),
+														  _mm_mul_ps(extentZ,_mm_set1_ps(std::abs(plane.z))));
+			outside = _mm_or_ps(outside,_mm_cmplt_ps(_mm_add_ps(distance,radius),_mm_setzero_ps()));
+		}
+		mask |= (~_mm_movemask_ps(outside) & 0xF) << 4*half;
+	}
+
+	return mask;
+#else
+	u32 mask = 0;
+	for(u32 i = 0;i < batchSize;i++)
+	{
+		bool inside = true;
+		for(const glm::vec4 &plane : frustum.planes)
+		{
+			const f32 distance = plane.x*centersX[i] + plane.y*centersY[i] + plane.z*centersZ[i] + plane.w;
+			const f32 radius   = std::abs(plane.x)*extentsX[i] + std::abs(plane.y)*extentsY[i] + std::abs(plane.z)*extentsZ[i];
+			inside &= distance + radius >= 0.f;
+		}
+		mask |= inside << i;
+	}
+
+	return mask;
+#endif
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <memory_resource>
+#include <array>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "types.hpp"
+#include "renderqueue.hpp"
+#include "bvh.hpp"
+#include "occlusion.hpp"
+#include "framearena.hpp"
+#include "profiler.hpp"
+
+// Planes are stored as (normal, distance), a point p is inside when dot(normal,p) + distance >= 0 for all planes
+struct Frustum
+{
+	std::array<glm::vec4,6> planes; // left, right, bottom, top, near, far
+
+	static Frustum FromViewProjection(const glm::mat4 &viewProjection);
+};
+
+struct CullingStatistics
+{
+	u32 visibleItems = 0; // items emitted by the last Cull
+	u32 culledItems  = 0; // items rejected by the last Cull
+	u32 occludedItems = 0; // items inside the frustum rejected by the occlusion test, included in culledItems
+	u64 totalVisible = 0;
+	u64 totalCulled  = 0;
+	u64 totalOccluded = 0;
+	u64 frames 		 = 0;
+};
+
+// Collects render items with their world space bounding boxes, tests the boxes against the view frustum
+// and submits only the visible items to the render queue. Boxes are stored as centers and half extents
+// in structure of arrays, so a batch of 8 boxes is tested against a plane with a few AVX instructions.
+// Boxes inside the frustum can additionally be tested against the depth pyramid of an occlusion culler.
+// If a BVH over the items' boxes (in submission order) is given, the items inside the frustum are found by
+// traversing it instead, which skips whole groups of items outside the frustum.
+// All arrays are rebuilt every frame from the frame resource passed to Clear
+struct FrustumCuller
+{
+	static constexpr u32 batchSize = 8;
+
+	std::pmr::vector<RenderItem> items;
+	std::pmr::vector<f32> 		 centersX;
+	std::pmr::vector<f32> 		 centersY;
+	std::pmr::vector<f32> 		 centersZ;
+	std::pmr::vector<f32> 		 extentsX;
+	std::pmr::vector<f32> 		 extentsY;
+	std::pmr::vector<f32> 		 extentsZ;
+	std::pmr::vector<u32> 		 visibleItems; // indices of the items which passed the last test
+	std::vector<u32> 			 queriedItems; // items found by the last BVH query, reused between frames
+	CullingStatistics 			 statistics;
+
+	void Submit(const RenderItem &item);
+	void Submit(const RenderItem &item,const glm::vec3 &boundsMin,const glm::vec3 &boundsMax);
+	void Cull(const Frustum &frustum,RenderQueue &renderQueue,const OcclusionCuller *occlusionCuller = nullptr,const BVH *hierarchy = nullptr);
+	void Clear(std::pmr::memory_resource *frameResource = std::pmr::get_default_resource());
+
+	void PrintStatistics() const;
+
+	static u32 TestBatch(const Frustum &frustum,const f32 *centersX,const f32 *centersY,const f32 *centersZ,
+						 const f32 *extentsX,const f32 *extentsY,const f32 *extentsZ);
+};
@@ -0,0 +1,82 @@
+#include "drawbatch.hpp"
+
+// Draws the index range of the model's LOD, consecutive draws of the same range are merged into a single
+// command with more instances
+void DrawBatch::Add(const Model &model,u32 lod,const InstanceData &instance)
+{
+	const ModelLOD &range = model.lods[lod];
+
+	if(this->commands.empty())
+		this->vertexArrayID = model.vertexArrayID;
+	else if(this->vertexArrayID != model.vertexArrayID)
+	{
+		std::cout << "Models with different vertex structures can't be drawn in the same batch!" << std::endl;
+		exit(-1);
+	}
+
+	this->instances.push_back(instance);
+
+	if(!this->commands.empty())
+	{
+		DrawElementsIndirectCommand &last = this->commands.back();
+		if(last.firstIndex == range.firstIndex && last.baseVertex == static_cast<i32>(model.baseVertex))
+		{
+			last.instanceCount++;
+			return;
+		}
+	}
+
+	this->commands.push_back(DrawElementsIndirectCommand{
+		.count 		   = range.numberOfIndices,
+		.instanceCount = 1,
+		.firstIndex    = range.firstIndex,
+		.baseVertex    = static_cast<i32>(model.baseVertex),
+		.baseInstance  = static_cast<u32>(this->instances.size() - 1)
+	});
+}
+
+void DrawBatch::Clear()
+{
+	this->commands.clear();
+	this->instances.clear();
+}
+
+// Uploads the commands and instances (orphaning the previous contents) and draws the whole batch
+void DrawBatch::Submit(GLState &glState)
+{
+	if(this->commands.empty())
+		return;
+
+	if(this->commandBufferID == 0)
+	{
+		glGenBuffers(1,&this->commandBufferID);
+		glGenBuffers(1,&this->instanceBufferID);
+	}
+
+	this->commandCapacity  = std::max(this->commandCapacity,static_cast<u32>(this->commands.capacity()));
+	this->instanceCapacity = std::max(this->instanceCapacity,static_cast<u32>(this->instances.capacity()));
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER,this->commandBufferID);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER,this->commandCapacity*sizeof(DrawElementsIndirectCommand),nullptr,GL_STREAM_DRAW);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER,0,this->commands.size()*sizeof(DrawElementsIndirectCommand),this->commands.data());
+
+	glBindBuffer(GL_ARRAY_BUFFER,this->instanceBufferID);
+	glBufferData(GL_ARRAY_BUFFER,this->instanceCapacity*sizeof(InstanceData),nullptr,GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER,0,this->instances.size()*sizeof(InstanceData),this->instances.data());
+
+	glState.BindVertexArray(this->vertexArrayID);
+	glBindVertexBuffer(1,this->instanceBufferID,0,sizeof(InstanceData));
+
+	glMultiDrawElementsIndirect(GL_TRIANGLES,GL_UNSIGNED_INT,nullptr,this->commands.size(),0);
+}
+
+void DrawBatch::Delete()
+{
+	const std::array<u32,2> buffers = {this->commandBufferID,this->instanceBufferID};
+	glDeleteBuffers(buffers.size(),buffers.data());
+
+	this->commandBufferID  = 0;
+	this->instanceBufferID = 0;
+	this->commandCapacity  = 0;
+	this->instanceCapacity = 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include <GLEW/glew.h>
+
+#include "types.hpp"
+#include "modelmanager.hpp"
+#include "glstate.hpp"
+
+// Layout of a GL_DRAW_INDIRECT_BUFFER entry, as consumed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	u32 count;			// number of indices
+	u32 instanceCount;
+	u32 firstIndex;
+	i32 baseVertex;
+	u32 baseInstance;	// first element of the instance buffer used by the command
+};
+
+// Collects draws of models stored in the same geometry arena and submits them all with a single
+// glMultiDrawElementsIndirect. Per-draw transforms and colors are passed as instance attributes,
+// so the models have to be drawn with the INSTANCED shader permutation. The render queue fills
+// batches while recording and submits them when the command buffers are replayed
+struct DrawBatch
+{
+	u32 									 vertexArrayID 	  = 0; // arena vertex array shared by all models in the batch
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<InstanceData> 				 instances;
+	u32 									 commandBufferID  = 0;
+	u32 									 instanceBufferID = 0;
+	u32 									 commandCapacity  = 0; // size of the command buffer in commands
+	u32 									 instanceCapacity = 0; // size of the instance buffer in instances
+
+	void Add(const Model &model,u32 lod,const InstanceData &instance);
+	void Clear();
+	void Submit(GLState &glState);
+	void Delete();
+};
@@ -0,0 +1,433 @@
+#include "filereader.hpp"
+#include "archive.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <new>
+
+#if defined(__linux__)
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <linux/io_uring.h>
+#endif
+
+void AlignedDelete::operator()(u8 *bytes) const
+{
+	if(this->owned)
+		::operator delete[](bytes,std::align_val_t(FileReader::alignment));
+}
+
+// Padded to whole aligned blocks, the last O_DIRECT read may write a whole block past the end of the file
+FileData FileData::Allocate(u64 size)
+{
+	const u64 paddedSize = std::max<u64>((size + FileReader::alignment - 1)/FileReader::alignment*FileReader::alignment,FileReader::alignment);
+
+	FileData data;
+	data.bytes.reset(new(std::align_val_t(FileReader::alignment)) u8[paddedSize]);
+	data.size = size;
+	return data;
+}
+
+FileData FileData::View(const u8 *bytes,u64 size)
+{
+	FileData data;
+	data.bytes 	= std::unique_ptr<u8[],AlignedDelete>(const_cast<u8*>(bytes),AlignedDelete{.owned = false});
+	data.size 	= size;
+	data.loaded = true;
+	return data;
+}
+
+// Reads the whole file on the calling thread, used by the blocking loaders and where io_uring isn't available
+FileData FileReader::ReadFile(const std::string &path)
+{
+#if defined(__linux__)
+	const i32 file = open(path.c_str(),O_RDONLY | O_CLOEXEC);
+	struct stat status;
+	if(file < 0 || fstat(file,&status) != 0)
+	{
+		if(file >= 0)
+			close(file);
+		std::cout << "File at location: \"" << path << "\" could not be opened!" << std::endl;
+		return FileData{};
+	}
+
+	FileData data = FileData::Allocate(status.st_size);
+	for(u64 offset = 0;offset < data.size;)
+	{
+		const i64 bytesRead = pread(file,data.bytes.get() + offset,data.size - offset,offset);
+		if(bytesRead <= 0)
+		{
+			close(file);
+			std::cout << "File at location: \"" << path << "\" could not be read!" << std::endl;
+			return FileData{};
+		}
+		offset += bytesRead;
+	}
+	close(file);
+#else
+	std::ifstream file(path,std::ios::in | std::ios::binary | std::ios::ate);
+	if(!file.is_open())
+	{
+		std::cout << "File at location: \"" << path << "\" could not be opened!" << std::endl;
+		return FileData{};
+	}
+
+	FileData data = FileData::Allocate(file.tellg());
+	file.seekg(0,std::ios::beg);
+	file.read(reinterpret_cast<char*>(data.bytes.get()),data.size);
+#endif
+
+	data.loaded = true;
+	return data;
+}
+
+FileReader::~FileReader()
+{
+	Stop();
+}
+
+// Falls back to blocking reads in jobs if the ring can't be set up
+void FileReader::Start(JobSystem &jobSystem)
+{
+	this->jobSystem = &jobSystem;
+	this->useRing 	= SetupRing();
+	if(this->useRing)
+		this->completionThread = std::jthread(&FileReader::CompletionLoop,this);
+}
+
+// Reads which are still in flight are finished first
+void FileReader::Stop()
+{
+#if defined(__linux__)
+	if(!this->useRing)
+		return;
+
+	{
+		// a NOP without a chunk wakes the completion thread, which exits once nothing is in flight
+		std::lock_guard lock(this->submissionMutex);
+		this->stopping.store(true);
+		WriteSubmission(IORING_OP_NOP,nullptr);
+		this->unsubmittedEntries++;
+		SubmitPending();
+	}
+	this->completionThread = {}; // joins
+
+	munmap(this->submissionEntries,this->submissionEntryCount*sizeof(io_uring_sqe));
+	if(this->completionRing != this->submissionRing)
+		munmap(this->completionRing,this->completionRingSize);
+	munmap(this->submissionRing,this->submissionRingSize);
+	close(this->ringFileDescriptor);
+	this->useRing = false;
+#endif
+}
+
+bool FileReader::SetupRing()
+{
+#if defined(__linux__)
+	io_uring_params parameters = {};
+	this->ringFileDescriptor = syscall(__NR_io_uring_setup,queueDepth,&parameters);
+	if(this->ringFileDescriptor < 0)
+		return false;
+
+	// IORING_OP_READ is as old as IORING_FEAT_RW_CUR_POS (5.6)
+	if(!(parameters.features & IORING_FEAT_RW_CUR_POS))
+	{
+		close(this->ringFileDescriptor);
+		this->ringFileDescriptor = -1;
+		return false;
+	}
+
+	this->submissionEntryCount = parameters.sq_entries;
+	this->completionEntryCount = parameters.cq_entries;
+	this->submissionRingSize   = parameters.sq_off.array + parameters.sq_entries*sizeof(u32);
+	this->completionRingSize   = parameters.cq_off.cqes + parameters.cq_entries*sizeof(io_uring_cqe);
+
+	// both rings share a single mapping on kernels with IORING_FEAT_SINGLE_MMAP
+	const bool singleMapping = parameters.features & IORING_FEAT_SINGLE_MMAP;
+	if(singleMapping)
+		this->submissionRingSize = this->completionRingSize = std::max(this->submissionRingSize,this->completionRingSize);
+
+	// a failed mapping releases the ones made before it along with the ring
+	void *submissionRing = mmap(nullptr,this->submissionRingSize,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,
+								this->ringFileDescriptor,IORING_OFF_SQ_RING);
+	if(submissionRing == MAP_FAILED)
+	{
+		close(this->ringFileDescriptor);
+		this->ringFileDescriptor = -1;
+		return false;
+	}
+
+	void *completionRing = singleMapping ? submissionRing :
+						   mmap(nullptr,this->completionRingSize,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,
+						   		this->ringFileDescriptor,IORING_OFF_CQ_RING);
+	if(completionRing == MAP_FAILED)
+	{
+		munmap(submissionRing,this->submissionRingSize);
+		close(this->ringFileDescriptor);
+		this->ringFileDescriptor = -1;
+		return false;
+	}
+
+	void *submissionEntries = mmap(nullptr,this->submissionEntryCount*sizeof(io_uring_sqe),PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,
+								   this->ringFileDescriptor,IORING_OFF_SQES);
+	if(submissionEntries == MAP_FAILED)
+	{
+		if(!singleMapping)
+			munmap(completionRing,this->completionRingSize);
+		munmap(submissionRing,this->submissionRingSize);
+		close(this->ringFileDescriptor);
+		this->ringFileDescriptor = -1;
+		return false;
+	}
+
+	this->submissionRing 	= static_cast<u8*>(submissionRing);
+	this->completionRing 	= static_cast<u8*>(completionRing);
+	this->submissionEntries = submissionEntries;
+
+	// ring fields are at offsets given by the kernel
+	this->submissionHead  	= reinterpret_cast<u32*>(this->submissionRing + parameters.sq_off.head);
+	this->submissionTail  	= reinterpret_cast<u32*>(this->submissionRing + parameters.sq_off.tail);
+	this->submissionMask  	= reinterpret_cast<u32*>(this->submissionRing + parameters.sq_off.ring_mask);
+	this->submissionArray 	= reinterpret_cast<u32*>(this->submissionRing + parameters.sq_off.array);
+	this->completionHead  	= reinterpret_cast<u32*>(this->completionRing + parameters.cq_off.head);
+	this->completionTail  	= reinterpret_cast<u32*>(this->completionRing + parameters.cq_off.tail);
+	this->completionMask  	= reinterpret_cast<u32*>(this->completionRing + parameters.cq_off.ring_mask);
+	this->completionEntries = this->completionRing + parameters.cq_off.cqes;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void FileReader::Mount(const Archive &archive)
+{
+	this->archives.push_back(&archive);
+}
+
+const ArchiveEntry *FileReader::FindInArchives(const std::string &path,const Archive *&archive) const
+{
+	for(const Archive *mounted : this->archives)
+		if(const ArchiveEntry *entry = mounted->Find(path))
+		{
+			archive = mounted;
+			return entry;
+		}
+
+	return nullptr;
+}
+
+bool FileReader::Exists(const std::string &path) const
+{
+	const Archive *archive;
+	return FindInArchives(path,archive) || std::filesystem::is_regular_file(path);
+}
+
+FileData FileReader::Read(const std::string &path) const
+{
+	const Archive *archive;
+	if(const ArchiveEntry *entry = FindInArchives(path,archive))
+		return archive->Read(*entry);
+
+	return ReadFile(path);
+}
+
+// Archive entries are read (or decompressed) in a job after their pages have been prefetched, so the
+// caller always continues in a job, just as with loose files
+Task<FileData> FileReader::ReadAsync(std::string path)
+{
+	const Archive *archive;
+	if(const ArchiveEntry *entry = FindInArchives(path,archive))
+	{
+		archive->Prefetch(*entry);
+		co_await ResumeOnWorker{*this->jobSystem};
+		co_return archive->Read(*entry);
+	}
+
+	// a named operation, it has to stay at the same address in the frame while the read is in flight
+	FileReadOperation operation{.reader = *this,.path = std::move(path)};
+	co_return co_await operation;
+}
+
+void FileReadOperation::await_suspend(std::coroutine_handle<> coroutine)
+{
+	this->coroutine = coroutine;
+	this->reader.Submit(*this);
+}
+
+// Opens the file and queues all of its chunks at once, so they're submitted together
+void FileReader::Submit(FileReadOperation &operation)
+{
+	if(!this->useRing)
+	{
+		this->jobSystem->Schedule([&operation](){
+			operation.data = ReadFile(operation.path);
+			operation.coroutine.resume();
+		});
+		return;
+	}
+
+#if defined(__linux__)
+	struct stat status;
+	if(stat(operation.path.c_str(),&status) == 0)
+	{
+		if(static_cast<u64>(status.st_size) >= directThreshold)
+			operation.fileDescriptor = open(operation.path.c_str(),O_RDONLY | O_CLOEXEC | O_DIRECT);
+		if(operation.fileDescriptor < 0) // small file or the file system doesn't support O_DIRECT
+			operation.fileDescriptor = open(operation.path.c_str(),O_RDONLY | O_CLOEXEC);
+	}
+
+	if(operation.fileDescriptor < 0 || status.st_size == 0)
+	{
+		operation.failed.store(operation.fileDescriptor < 0);
+		return Complete(operation);
+	}
+
+	operation.data = FileData::Allocate(status.st_size);
+	const u64 size = operation.data.size;
+	operation.remainingChunks.store((size + chunkSize - 1)/chunkSize);
+
+	std::lock_guard lock(this->submissionMutex);
+	for(u64 offset = 0;offset < size;offset += chunkSize)
+		this->pendingChunks.push_back(FileChunk{
+			.operation = &operation,
+			.offset    = offset,
+			.size 	   = static_cast<u32>(std::min<u64>(chunkSize,(size - offset + alignment - 1)/alignment*alignment))
+		});
+	SubmitPending();
+#endif
+}
+
+// Moves as many pending chunks into the submission ring as the rings have room for and submits them
+// with a single system call. Called with the submission mutex held
+u32 FileReader::SubmitPending()
+{
+#if defined(__linux__)
+	u32 written = 0;
+	while(!this->pendingChunks.empty() && this->chunksInFlight < this->completionEntryCount &&
+		  *this->submissionTail - std::atomic_ref(*this->submissionHead).load(std::memory_order_acquire) < this->submissionEntryCount)
+	{
+		WriteSubmission(IORING_OP_READ,new FileChunk(this->pendingChunks.front()));
+		this->pendingChunks.pop_front();
+		this->chunksInFlight++;
+		written++;
+	}
+
+	this->unsubmittedEntries += written;
+	if(this->unsubmittedEntries != 0)
+	{
+		const i32 submitted = syscall(__NR_io_uring_enter,this->ringFileDescriptor,this->unsubmittedEntries,0,0,nullptr,0);
+		if(submitted > 0) // entries the kernel didn't take (e.g. while it's out of memory) are submitted with the next call
+			this->unsubmittedEntries -= submitted;
+	}
+
+	return written;
+#else
+	return 0;
+#endif
+}
+
+void FileReader::WriteSubmission(u8 opcode,const FileChunk *chunk)
+{
+#if defined(__linux__)
+	const u32 tail  = *this->submissionTail;
+	const u32 index = tail & *this->submissionMask;
+
+	io_uring_sqe &entry = static_cast<io_uring_sqe*>(this->submissionEntries)[index];
+	entry = {};
+	entry.opcode 	= opcode;
+	entry.user_data = reinterpret_cast<u64>(chunk);
+	if(chunk)
+	{
+		entry.fd   = chunk->operation->fileDescriptor;
+		entry.addr = reinterpret_cast<u64>(chunk->operation->data.bytes.get() + chunk->offset);
+		entry.len  = chunk->size;
+		entry.off  = chunk->offset;
+	}
+
+	this->submissionArray[index] = index;
+	std::atomic_ref(*this->submissionTail).store(tail + 1,std::memory_order_release);
+#endif
+}
+
+// Short reads before the end of the file are continued with another chunk, reads ending past the end
+// of the file (aligned O_DIRECT reads of the last block) are complete
+void FileReader::CompletionLoop()
+{
+#if defined(__linux__)
+	PROFILE_THREAD("File reader");
+	std::vector<FileReadOperation*> finished;
+	while(true)
+	{
+		syscall(__NR_io_uring_enter,this->ringFileDescriptor,0,1,IORING_ENTER_GETEVENTS,nullptr,0);
+
+		{
+			std::lock_guard lock(this->submissionMutex);
+
+			u32 head = *this->completionHead;
+			const u32 tail = std::atomic_ref(*this->completionTail).load(std::memory_order_acquire);
+			for(;head != tail;head++)
+			{
+				const io_uring_cqe &entry = static_cast<const io_uring_cqe*>(this->completionEntries)[head & *this->completionMask];
+				FileChunk *chunk = reinterpret_cast<FileChunk*>(entry.user_data);
+				if(!chunk)
+					continue;
+
+				this->chunksInFlight--;
+				FileReadOperation &operation = *chunk->operation;
+				const i64 bytesRead = entry.res;
+				if(bytesRead > 0 && bytesRead < chunk->size && chunk->offset + bytesRead < operation.data.size)
+				{
+					this->pendingChunks.push_front(FileChunk{
+						.operation = &operation,
+						.offset    = chunk->offset + bytesRead,
+						.size 	   = static_cast<u32>(chunk->size - bytesRead)
+					});
+					delete chunk;
+					continue;
+				}
+
+				if(bytesRead <= 0)
+					operation.failed.store(true);
+				delete chunk;
+
+				if(operation.remainingChunks.fetch_sub(1) == 1)
+					finished.push_back(&operation);
+			}
+			std::atomic_ref(*this->completionHead).store(head,std::memory_order_release);
+
+			SubmitPending();
+		}
+
+		for(FileReadOperation *operation : finished)
+			Complete(*operation);
+		finished.clear();
+
+		std::lock_guard lock(this->submissionMutex);
+		if(this->stopping.load() && this->chunksInFlight == 0 && this->pendingChunks.empty())
+			return;
+	}
+#endif
+}
+
+// The coroutine waiting for the read is resumed in a job, never on the completion thread
+void FileReader::Complete(FileReadOperation &operation)
+{
+#if defined(__linux__)
+	if(operation.fileDescriptor >= 0)
+		close(operation.fileDescriptor);
+#endif
+
+	if(operation.failed.load())
+	{
+		std::cout << "File at location: \"" << operation.path << "\" could not be read!" << std::endl;
+		operation.data = FileData{};
+	}
+	else
+		operation.data.loaded = true;
+
+	this->jobSystem->Schedule([coroutine = operation.coroutine](){ coroutine.resume(); });
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <coroutine>
+
+#include "types.hpp"
+#include "jobsystem.hpp"
+#include "task.hpp"
+
+// Frees the buffers of FileData, views of memory owned by something else (e.g. a mapped archive) aren't freed
+struct AlignedDelete
+{
+	bool owned = true; // false for views
+
+	void operator()(u8 *bytes) const;
+};
+
+// Contents of a whole file. The buffer is aligned (and padded) to FileReader::alignment, so O_DIRECT
+// reads can write into it directly. Views must not be written to
+struct FileData
+{
+	std::unique_ptr<u8[],AlignedDelete> bytes;
+	u64 								size   = 0;
+	bool 								loaded = false; // false if the file couldn't be opened or read
+
+	std::string_view Text() const { return std::string_view(reinterpret_cast<const char*>(this->bytes.get()),this->size); }
+
+	static FileData Allocate(u64 size);
+	static FileData View(const u8 *bytes,u64 size);
+};
+
+struct FileReader;
+struct Archive;
+struct ArchiveEntry;
+
+// co_await of a single read, the coroutine is resumed in a job once the whole file has been read
+struct FileReadOperation
+{
+	FileReader 			   &reader;
+	std::string 			path;
+	FileData 				data 			= {};
+	i32 					fileDescriptor  = -1;
+	std::atomic<u32> 		remainingChunks = 0;
+	std::atomic<bool> 		failed 			= false;
+	std::coroutine_handle<> coroutine 		= nullptr;
+
+	bool 	 await_ready() const { return false; }
+	void 	 await_suspend(std::coroutine_handle<> coroutine);
+	FileData await_resume() { return std::move(this->data); }
+};
+
+// Part of a file read by a single io_uring request
+struct FileChunk
+{
+	FileReadOperation *operation;
+	u64 			   offset;
+	u32 			   size;
+};
+
+// Reads whole files asynchronously. On Linux requests go through io_uring: files are split into chunks which are
+// submitted together, many files can be in flight at once and a completion thread finishes them. Files of at
+// least directThreshold bytes are opened with O_DIRECT, so large assets bypass the page cache. Where io_uring
+// isn't available (other systems, old kernels, restricted sandboxes) every file is read with pread in a job.
+// Mounted archives are searched before the loose files, so the same paths work with and without packed assets.
+// Reads are started with ReadAsync and finished in jobs, so the job system has to outlive the reader
+struct FileReader
+{
+	static constexpr u64 alignment 		 = 4096;	// O_DIRECT offset/size/address alignment
+	static constexpr u32 chunkSize 		 = 1 << 20;
+	static constexpr u64 directThreshold = 4 << 20;
+	static constexpr u32 queueDepth 	 = 64;		// submission queue entries
+
+	JobSystem 			 *jobSystem 		 = nullptr;
+	bool 				  useRing 			 = false;
+	i32 				  ringFileDescriptor = -1;
+	u8 					 *submissionRing 	 = nullptr; // mappings shared with the kernel
+	u8 					 *completionRing 	 = nullptr;
+	void 				 *submissionEntries  = nullptr; // io_uring_sqe array
+	u64 				  submissionRingSize = 0;
+	u64 				  completionRingSize = 0;
+	u32 				  submissionEntryCount = 0;
+	u32 				  completionEntryCount = 0;
+	u32 				 *submissionHead 	 = nullptr; // fields of the rings, inside the mappings
+	u32 				 *submissionTail 	 = nullptr;
+	u32 				 *submissionMask 	 = nullptr;
+	u32 				 *submissionArray 	 = nullptr;
+	u32 				 *completionHead 	 = nullptr;
+	u32 				 *completionTail 	 = nullptr;
+	u32 				 *completionMask 	 = nullptr;
+	void 				 *completionEntries  = nullptr; // io_uring_cqe array
+	std::mutex 			  submissionMutex;
+	std::deque<FileChunk> pendingChunks; 			// chunks waiting for room in the rings
+	u32 				  chunksInFlight 	 = 0; 	// guarded by submissionMutex, at most completionEntryCount
+	u32 				  unsubmittedEntries = 0; 	// written to the submission ring, but not taken by the kernel yet
+	std::atomic<bool> 	  stopping 			 = false;
+	std::jthread 		  completionThread;
+	std::vector<const Archive*> archives; 		// searched in mount order, they have to outlive the reader
+
+	~FileReader();
+
+	void Start(JobSystem &jobSystem);
+	void Stop();
+
+	void 				Mount(const Archive &archive);
+	const ArchiveEntry *FindInArchives(const std::string &path,const Archive *&archive) const;
+	bool 				Exists(const std::string &path) const;
+
+	Task<FileData> 	ReadAsync(std::string path);
+	FileData 		Read(const std::string &path) const; // blocking, mounted archives first
+	static FileData ReadFile(const std::string &path); 	 // blocking, loose files only
+
+	void Submit(FileReadOperation &operation);
+	u32  SubmitPending();
+	void WriteSubmission(u8 opcode,const FileChunk *chunk);
+	void Complete(FileReadOperation &operation);
+	void CompletionLoop();
+	bool SetupRing();
+};
@@ -0,0 +1,83 @@
+#include "framearena.hpp"
+
+#include <algorithm>
+
+void FrameArena::AddChunk(u64 minimumSize)
+{
+	const u64 size = std::max({minimumSize,initialChunkSize,this->totalSize});
+
+	this->chunks.push_back(std::make_unique<u8[]>(size));
+	this->chunkSizes.push_back(size);
+	this->offset 	 = 0;
+	this->totalSize += size;
+	this->statistics.upstreamAllocations++;
+}
+
+void *FrameArena::do_allocate(size_t bytes,size_t alignment)
+{
+	if(!this->chunks.empty())
+	{
+		const u64 address = reinterpret_cast<u64>(this->chunks.back().get()) + this->offset;
+		const u64 padding = (alignment - address % alignment) % alignment;
+		if(this->offset + padding + bytes <= this->chunkSizes.back())
+		{
+			this->offset += padding + bytes;
+			this->statistics.allocations++;
+			this->statistics.allocatedBytes += padding + bytes;
+			return reinterpret_cast<void*>(address + padding);
+		}
+	}
+
+	AddChunk(bytes + alignment);
+	return do_allocate(bytes,alignment);
+}
+
+// Several chunks are replaced by a single one large enough for all of them, so the next frame of the same size fits
+void FrameArena::Reset()
+{
+	if(this->chunks.size() > 1)
+	{
+		const u64 size = this->totalSize;
+		this->chunks.clear();
+		this->chunkSizes.clear();
+		this->totalSize = 0;
+		AddChunk(size);
+	}
+
+	this->offset 	 = 0;
+	this->statistics = {};
+}
+
+// Resets the oldest arena, whatever was allocated from it framesInFlight frames ago mustn't be used anymore
+void FrameAllocator::BeginFrame()
+{
+	const FrameArenaStatistics &finished = this->arenas[this->currentArena].statistics;
+	if(this->frames != 0)
+	{
+		this->lastFrame 		 = finished;
+		this->totalAllocations  += finished.allocations;
+		this->totalUpstream 	+= finished.upstreamAllocations;
+		this->peakAllocatedBytes = std::max(this->peakAllocatedBytes,finished.allocatedBytes);
+	}
+	this->frames++;
+
+	this->currentArena = (this->currentArena + 1)%framesInFlight;
+	this->arenas[this->currentArena].Reset();
+}
+
+std::pmr::memory_resource *FrameAllocator::Resource()
+{
+	return &this->arenas[this->currentArena];
+}
+
+void FrameAllocator::PrintStatistics() const
+{
+	if(this->frames <= 1)
+		return;
+
+	const u64 finishedFrames = this->frames - 1;
+	std::cout << "Frame allocator: " << this->totalAllocations/finishedFrames << " allocations per frame (last frame "
+			  << this->lastFrame.allocations << ", " << this->lastFrame.allocatedBytes << " bytes), peak "
+			  << this->peakAllocatedBytes << " bytes, " << this->totalUpstream << " heap allocations in "
+			  << finishedFrames << " frames" << std::endl;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <memory>
+#include <memory_resource>
+
+#include "types.hpp"
+
+// Allocation counts of a single frame
+struct FrameArenaStatistics
+{
+	u64 allocations 		= 0; // allocations served by the arena
+	u64 allocatedBytes 		= 0; // including alignment padding
+	u64 upstreamAllocations = 0; // chunks requested from the heap because the arena ran out of space
+};
+
+// Bump allocator for data which only lives until the arena is reset. Allocation moves a pointer, deallocation
+// does nothing and Reset rewinds the arena in O(1). When the current chunk runs out a new chunk is taken from
+// the heap, the chunks are merged into one at the next Reset, so after a few frames a frame's data fits
+// into a single chunk and no heap allocation happens anymore. Not thread safe
+struct FrameArena : std::pmr::memory_resource
+{
+	static constexpr u64 initialChunkSize = 1 << 20;
+
+	std::vector<std::unique_ptr<u8[]>> chunks;
+	std::vector<u64> 				   chunkSizes;
+	u64 							   offset 	   = 0; // into the last chunk
+	u64 							   totalSize   = 0; // of all chunks
+	FrameArenaStatistics 			   statistics;		// since the last Reset
+
+	void Reset();
+
+	void *do_allocate(size_t bytes,size_t alignment) override;
+	void  do_deallocate(void*,size_t,size_t) override {}
+	bool  do_is_equal(const std::pmr::memory_resource &resource) const noexcept override { return this == &resource; }
+
+	void AddChunk(u64 minimumSize);
+};
+
+// Frame arenas used in rotation, memory allocated during a frame stays valid while the next framesInFlight - 1
+// frames are built, so transient data can be read by work which finishes later (e.g. uploads of the previous frame).
+// Everything else that only lives for the frame should be allocated from Resource() instead of the heap
+struct FrameAllocator
+{
+	static constexpr u32 framesInFlight = 3;
+
+	std::array<FrameArena,framesInFlight> arenas;
+	u32 								  currentArena = 0;
+	u64 								  frames 			   = 0;
+	u64 								  totalAllocations 	   = 0;
+	u64 								  totalUpstream 	   = 0;
+	u64 								  peakAllocatedBytes   = 0;
+	FrameArenaStatistics 				  lastFrame;			// statistics of the last finished frame
+
+	void 						BeginFrame();
+	std::pmr::memory_resource  *Resource();
+	void 						PrintStatistics() const;
+};
+
+// Starts the frame's contents of a vector on the frame resource, with room for as many elements as it held in the
+// last frame. A pmr vector keeps its resource when it's assigned to, so it has to be constructed again.
+// The old storage isn't freed, it belongs to an arena which is reset later
+template<typename T>
+void RebindToFrame(std::pmr::vector<T> &vector,std::pmr::memory_resource *frameResource)
+{
+	const size_t lastFrameSize = vector.size();
+	std::destroy_at(&vector);
+	std::construct_at(&vector,frameResource);
+	vector.reserve(lastFrameSize);
+}
@@ -0,0 +1,102 @@
+#include "framebuffer.hpp"
+
+// Also used for resizing, the previous attachments are deleted
+void Framebuffer::Create(u32 width,u32 height)
+{
+	Delete();
+
+	this->width  = width;
+	this->height = height;
+
+	std::array<u32,2> textures;
+	glGenTextures(textures.size(),textures.data());
+	this->colorTextureID = textures[0];
+	this->depthTextureID = textures[1];
+
+	glBindTexture(GL_TEXTURE_2D,this->colorTextureID);
+	glTexStorage2D(GL_TEXTURE_2D,1,GL_RGBA8,width,height);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+
+	glBindTexture(GL_TEXTURE_2D,this->depthTextureID);
+	glTexStorage2D(GL_TEXTURE_2D,1,GL_DEPTH_COMPONENT32F,width,height);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+
+	glGenFramebuffers(1,&this->framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER,this->framebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,this->colorTextureID,0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,GL_TEXTURE_2D,this->depthTextureID,0);
+
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Framebuffer of size " << width << " x " << height << " is incomplete!" << std::endl;
+		exit(-1);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER,0);
+}
+
+void Framebuffer::Bind() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER,this->framebufferID);
+	glViewport(0,0,this->width,this->height);
+}
+
+// Copies the color attachment to the window, the default framebuffer is left bound
+void Framebuffer::BlitToDefault(u32 windowWidth,u32 windowHeight) const
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER,this->framebufferID);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER,0);
+	glBlitFramebuffer(0,0,this->width,this->height,0,0,windowWidth,windowHeight,GL_COLOR_BUFFER_BIT,GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER,0);
+}
+
+// Binary PPM (P6) of the color attachment. Reading back waits for the GPU, so it's meant for tests and captures
+bool Framebuffer::SaveColor(const std::string &path) const
+{
+	std::vector<u8> pixels(static_cast<u64>(this->width)*this->height*4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER,this->framebufferID);
+	glPixelStorei(GL_PACK_ALIGNMENT,1);
+	glReadPixels(0,0,this->width,this->height,GL_RGBA,GL_UNSIGNED_BYTE,pixels.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER,0);
+
+	std::ofstream image(path,std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!image.is_open())
+	{
+		std::cout << "Image file at location: \"" << path << "\" could not be created!" << std::endl;
+		return false;
+	}
+
+	// GL rows start at the bottom, PPM rows at the top
+	image << "P6\n" << this->width << ' ' << this->height << "\n255\n";
+	std::vector<u8> row(this->width*3);
+	for(u32 y = this->height;y-- > 0;)
+	{
+		const u8 *source = pixels.data() + static_cast<u64>(y)*this->width*4;
+		for(u32 x = 0;x < this->width;x++)
+			std::copy_n(source + x*4,3,row.data() + x*3);
+		image.write(reinterpret_cast<const char*>(row.data()),row.size());
+	}
+
+	if(!image)
+	{
+		std::cout << "Image file at location: \"" << path << "\" could not be written!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void Framebuffer::Delete()
+{
+	if(this->framebufferID == 0)
+		return;
+
+	const std::array<u32,2> textures = {this->colorTextureID,this->depthTextureID};
+	glDeleteTextures(textures.size(),textures.data());
+	glDeleteFramebuffers(1,&this->framebufferID);
+
+	this->framebufferID  = 0;
+	this->colorTextureID = 0;
+	this->depthTextureID = 0;
+}
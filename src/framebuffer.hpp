@@ -0,0 +1,30 @@
+#pragma once
+
+#include <iostream>
+#include <array>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include <GLEW/glew.h>
+
+#include "types.hpp"
+
+// Offscreen render target with color and depth textures, the depth can be sampled (e.g. to build a depth
+// pyramid) which isn't possible with the default framebuffer. Creating the attachments binds textures
+// directly, so the GLState cache has to be invalidated afterwards
+struct Framebuffer
+{
+	u32 framebufferID  = 0;
+	u32 colorTextureID = 0;	// GL_RGBA8
+	u32 depthTextureID = 0;	// GL_DEPTH_COMPONENT32F
+	u32 width 		   = 0;
+	u32 height 		   = 0;
+
+	void Create(u32 width,u32 height);
+	void Bind() const;
+	void BlitToDefault(u32 windowWidth,u32 windowHeight) const;
+	bool SaveColor(const std::string &path) const;
+	void Delete();
+};
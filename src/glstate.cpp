@@ -0,0 +1,235 @@
+#include "glstate.hpp"
+
+GLState::GLState()
+{
+	Invalidate();
+}
+
+// Forgets the tracked state, so the next call of every setter is forwarded to OpenGL
+void GLState::Invalidate()
+{
+	this->program 	  	   = unknown;
+	this->vertexArray 	   = unknown;
+	this->activeTextureUnit = unknown;
+	for(auto &unit : this->boundTextures)
+		unit.fill(unknown);
+	this->boundUniformBuffers.fill(unknown);
+	this->boundStorageBuffers.fill(unknown);
+
+	this->depthTest 	   = unknown;
+	this->depthFunction    = unknown;
+	this->depthMask 	   = unknown;
+	this->blend 		   = unknown;
+	this->blendSource 	   = unknown;
+	this->blendDestination = unknown;
+	this->cullFace 		   = unknown;
+	this->cullMode 		   = unknown;
+	this->polygonMode 	   = unknown;
+}
+
+// Forgets the bindings of a deleted object (GL_PROGRAM, GL_VERTEX_ARRAY, GL_TEXTURE or GL_BUFFER), so binding
+// a new object which got the same name isn't dropped as redundant
+void GLState::OnDelete(u32 objectType,u32 objectID)
+{
+	auto forget = [objectID](u32 &binding){
+		if(binding == objectID)
+			binding = unknown;
+	};
+
+	switch(objectType)
+	{
+		case GL_PROGRAM:
+			forget(this->program);
+			break;
+
+		case GL_VERTEX_ARRAY:
+			forget(this->vertexArray);
+			break;
+
+		case GL_TEXTURE:
+			for(auto &unit : this->boundTextures)
+				for(u32 &binding : unit)
+					forget(binding);
+			break;
+
+		case GL_BUFFER:
+			for(u32 &binding : this->boundUniformBuffers)
+				forget(binding);
+			for(u32 &binding : this->boundStorageBuffers)
+				forget(binding);
+			break;
+	}
+}
+
+// Updates the tracked value and returns true if the call has to be forwarded to OpenGL
+bool GLState::Changed(u32 &current,u32 requested)
+{
+	if(current == requested)
+	{
+		this->statistics.elidedCalls++;
+		return false;
+	}
+
+	current = requested;
+	this->statistics.issuedCalls++;
+	return true;
+}
+
+// Returns the index of the binding point tracked for the target or unknown if it isn't tracked
+u32 GLState::TargetIndex(u32 target)
+{
+	switch(target)
+	{
+		case GL_TEXTURE_2D: 	  return 0;
+		case GL_TEXTURE_CUBE_MAP: return 1;
+		case GL_TEXTURE_2D_ARRAY: return 2;
+		case GL_TEXTURE_3D: 	  return 3;
+		default: 				  return unknown;
+	}
+}
+
+void GLState::UseProgram(u32 programID)
+{
+	if(Changed(this->program,programID))
+		glUseProgram(programID);
+}
+
+void GLState::BindVertexArray(u32 vertexArrayID)
+{
+	if(Changed(this->vertexArray,vertexArrayID))
+		glBindVertexArray(vertexArrayID);
+}
+
+void GLState::BindTexture(u32 unit,u32 target,u32 textureID)
+{
+	const u32 targetIndex = TargetIndex(target);
+
+	if(unit >= textureUnits || targetIndex == unknown) // untracked binding point
+	{
+		this->activeTextureUnit = unit < textureUnits ? unit : unknown;
+		this->statistics.issuedCalls += 2;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target,textureID);
+		return;
+	}
+
+	if(this->boundTextures[unit][targetIndex] == textureID)
+	{
+		this->statistics.elidedCalls++;
+		return;
+	}
+
+	if(Changed(this->activeTextureUnit,unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+
+	Changed(this->boundTextures[unit][targetIndex],textureID);
+	glBindTexture(target,textureID);
+}
+
+// Only whole-buffer bindings of uniform and storage buffers are tracked
+void GLState::BindBufferBase(u32 target,u32 index,u32 bufferID)
+{
+	u32 *bound = nullptr;
+	if(index < bufferSlots && target == GL_UNIFORM_BUFFER)
+		bound = &this->boundUniformBuffers[index];
+	else if(index < bufferSlots && target == GL_SHADER_STORAGE_BUFFER)
+		bound = &this->boundStorageBuffers[index];
+
+	if(!bound)
+	{
+		this->statistics.issuedCalls++;
+		glBindBufferBase(target,index,bufferID);
+	}
+	else if(Changed(*bound,bufferID))
+		glBindBufferBase(target,index,bufferID);
+}
+
+// Ranges aren't tracked, the slot is forgotten so a following BindBufferBase is always issued
+void GLState::BindBufferRange(u32 target,u32 index,u32 bufferID,u64 offset,u64 size)
+{
+	if(index < bufferSlots && target == GL_UNIFORM_BUFFER)
+		this->boundUniformBuffers[index] = unknown;
+	else if(index < bufferSlots && target == GL_SHADER_STORAGE_BUFFER)
+		this->boundStorageBuffers[index] = unknown;
+
+	this->statistics.issuedCalls++;
+	glBindBufferRange(target,index,bufferID,offset,size);
+}
+
+// Binds a level of a non-layered texture as an image for load/store from shaders (e.g. compute output)
+void GLState::BindImageTexture(u32 unit,u32 textureID,u32 access,u32 format,i32 level)
+{
+	this->statistics.issuedCalls++;
+	glBindImageTexture(unit,textureID,level,false,0,access,format);
+}
+
+void GLState::SetDepthTest(bool enabled)
+{
+	if(Changed(this->depthTest,enabled))
+		enabled ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+}
+
+void GLState::SetDepthFunction(u32 function)
+{
+	if(Changed(this->depthFunction,function))
+		glDepthFunc(function);
+}
+
+void GLState::SetDepthMask(bool enabled)
+{
+	if(Changed(this->depthMask,enabled))
+		glDepthMask(enabled);
+}
+
+void GLState::SetBlend(bool enabled)
+{
+	if(Changed(this->blend,enabled))
+		enabled ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+}
+
+void GLState::SetBlendFunction(u32 source,u32 destination)
+{
+	if(this->blendSource == source && this->blendDestination == destination)
+	{
+		this->statistics.elidedCalls++;
+		return;
+	}
+
+	this->blendSource 	   = source;
+	this->blendDestination = destination;
+	this->statistics.issuedCalls++;
+	glBlendFunc(source,destination);
+}
+
+void GLState::SetCullFace(bool enabled)
+{
+	if(Changed(this->cullFace,enabled))
+		enabled ? glEnable(GL_CULL_FACE) : glDisable(GL_CULL_FACE);
+}
+
+void GLState::SetCullMode(u32 mode)
+{
+	if(Changed(this->cullMode,mode))
+		glCullFace(mode);
+}
+
+void GLState::SetPolygonMode(u32 mode)
+{
+	if(Changed(this->polygonMode,mode))
+		glPolygonMode(GL_FRONT_AND_BACK,mode);
+}
+
+void GLState::ResetStatistics()
+{
+	this->statistics = GLStateStatistics{};
+}
+
+void GLState::PrintStatistics() const
+{
+	const u64 totalCalls = this->statistics.issuedCalls + this->statistics.elidedCalls;
+	const f64 elidedPercentage = totalCalls ? 100.0*this->statistics.elidedCalls/totalCalls : 0.0;
+
+	std::cout << "GL state calls issued: " << this->statistics.issuedCalls 
+			  << ", elided: " << this->statistics.elidedCalls 
+			  << " (" << elidedPercentage << "% saved)" << std::endl;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <iostream>
+#include <array>
+
+#include <GLEW/glew.h>
+
+#include "types.hpp"
+
+// Statistics of calls that went through the state cache
+struct GLStateStatistics
+{
+	u64 issuedCalls = 0; // calls which changed the state and were forwarded to OpenGL
+	u64 elidedCalls = 0; // calls which would have set the already current state and were dropped
+};
+
+// Thin cache in front of OpenGL which drops calls that wouldn't change the current state.
+// Every state change must go through the cache, otherwise Invalidate() has to be called
+// before the cache is used again (e.g. after resources are created by the managers).
+// Objects deleted while the cache is in use have to be reported with OnDelete, since GL reuses the names
+struct GLState
+{
+	static constexpr u32 unknown 	  = ~0u; // value which never matches a real state, forces the next call through
+	static constexpr u32 textureUnits = 16;	 // number of texture units tracked, higher units bypass the cache
+	static constexpr u32 bufferSlots  = 16;	 // number of indexed uniform/storage buffer bindings tracked
+
+	u32 program;
+	u32 vertexArray;
+	u32 activeTextureUnit;
+	std::array<std::array<u32,4>,textureUnits> boundTextures; // [unit][target index], see TargetIndex 
+	std::array<u32,bufferSlots> 			   boundUniformBuffers;
+	std::array<u32,bufferSlots> 			   boundStorageBuffers;
+
+	u32 depthTest;
+	u32 depthFunction;
+	u32 depthMask;
+	u32 blend;
+	u32 blendSource;
+	u32 blendDestination;
+	u32 cullFace;
+	u32 cullMode;
+	u32 polygonMode;
+
+	GLStateStatistics statistics;
+
+	GLState();
+
+	void Invalidate();
+	void OnDelete(u32 objectType,u32 objectID);
+
+	void UseProgram(u32 programID);
+	void BindVertexArray(u32 vertexArrayID);
+	void BindTexture(u32 unit,u32 target,u32 textureID);
+	void BindBufferBase(u32 target,u32 index,u32 bufferID);
+	void BindBufferRange(u32 target,u32 index,u32 bufferID,u64 offset,u64 size);
+	void BindImageTexture(u32 unit,u32 textureID,u32 access,u32 format,i32 level = 0);
+
+	void SetDepthTest(bool enabled);
+	void SetDepthFunction(u32 function);
+	void SetDepthMask(bool enabled);
+	void SetBlend(bool enabled);
+	void SetBlendFunction(u32 source,u32 destination);
+	void SetCullFace(bool enabled);
+	void SetCullMode(u32 mode);
+	void SetPolygonMode(u32 mode);
+
+	void ResetStatistics();
+	void PrintStatistics() const;
+
+	static u32 TargetIndex(u32 target);
+	bool 	   Changed(u32 &current,u32 requested);
+};
@@ -0,0 +1,401 @@
+#include "gpuculler.hpp"
+#include "culling.hpp"
+
+// Instances of every group are stored consecutively, the compacted instances of a group use the same range
+void GPUCuller::AddGroup(const Model &model,const InstanceData *groupInstances,u32 numberOfGroupInstances)
+{
+	if(this->groups.empty())
+		this->vertexArrayID = model.vertexArrayID;
+	else if(this->vertexArrayID != model.vertexArrayID)
+	{
+		std::cout << "Models with different vertex structures can't be culled by the same GPU culler!" << std::endl;
+		exit(-1);
+	}
+
+	this->groups.push_back(GPUCullingGroup{
+		.boundsMin 		  = glm::vec4(model.boundsMin,0.f),
+		.boundsMax 		  = glm::vec4(model.boundsMax,0.f),
+		.count 	   		  = model.numberOfIndices,
+		.firstIndex 	  = model.firstIndex,
+		.baseVertex 	  = static_cast<i32>(model.baseVertex),
+		.firstInstance 	  = static_cast<u32>(this->instances.size()),
+		.visibleInstances = 0,
+		.padding 		  = {}
+	});
+	this->instances.insert(this->instances.end(),groupInstances,groupInstances + numberOfGroupInstances);
+	this->instanceGroups.insert(this->instanceGroups.end(),numberOfGroupInstances,this->groups.size() - 1);
+}
+
+// Creates the buffers from the staged groups, the staging copies are released
+void GPUCuller::Upload()
+{
+	Delete();
+
+	this->numberOfInstances  = this->instances.size();
+	this->numberOfGroups 	 = this->groups.size();
+	this->drawCountSupported = GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters;
+
+	std::array<u32,7> buffers;
+	glGenBuffers(buffers.size(),buffers.data());
+	this->instanceBufferID 		  = buffers[0];
+	this->instanceGroupBufferID   = buffers[1];
+	this->groupBufferID 		  = buffers[2];
+	this->visibleInstanceBufferID = buffers[3];
+	this->commandBufferID 		  = buffers[4];
+	this->drawCountBufferID 	  = buffers[5];
+	this->parametersBufferID 	  = buffers[6];
+
+	// copy write target is used, so none of the indexed bindings tracked by GLState change
+	auto createBuffer = [](u32 bufferID,u64 size,const void *data,u32 usage){
+		glBindBuffer(GL_COPY_WRITE_BUFFER,bufferID);
+		glBufferData(GL_COPY_WRITE_BUFFER,std::max<u64>(size,4),data,usage);
+	};
+	createBuffer(this->instanceBufferID,this->instances.size()*sizeof(InstanceData),this->instances.data(),GL_STATIC_DRAW);
+	createBuffer(this->instanceGroupBufferID,this->instanceGroups.size()*sizeof(u32),this->instanceGroups.data(),GL_STATIC_DRAW);
+	createBuffer(this->groupBufferID,this->groups.size()*sizeof(GPUCullingGroup),this->groups.data(),GL_DYNAMIC_COPY);
+	createBuffer(this->visibleInstanceBufferID,this->instances.size()*sizeof(InstanceData),nullptr,GL_DYNAMIC_COPY);
+	createBuffer(this->commandBufferID,this->groups.size()*sizeof(DrawElementsIndirectCommand),nullptr,GL_DYNAMIC_COPY);
+	createBuffer(this->drawCountBufferID,sizeof(u32),nullptr,GL_DYNAMIC_COPY);
+	createBuffer(this->parametersBufferID,sizeof(GPUCullingParameters),nullptr,GL_DYNAMIC_DRAW);
+
+	this->groups 		 = {};
+	this->instances 	 = {};
+	this->instanceGroups = {};
+}
+
+// Fills the indirect command buffer for the frame rendered with viewProjection, the occlusion test uses
+// the pyramid of the previous frame reprojected with its own view-projection
+void GPUCuller::Cull(ShaderManager &shaderManager,GLState &glState,const glm::mat4 &viewProjection)
+{
+	PROFILE_SCOPE("GPUCuller::Cull");
+	if(this->numberOfInstances == 0)
+		return;
+
+	this->viewProjection = viewProjection;
+
+	this->parameters = {
+		.viewProjection 		= viewProjection,
+		.previousViewProjection = this->previousViewProjection,
+		.frustumPlanes 			= Frustum::FromViewProjection(viewProjection).planes,
+		.hizSize 				= glm::vec2(this->hizSize),
+		.numberOfInstances 		= this->numberOfInstances,
+		.numberOfGroups 		= this->numberOfGroups,
+		.hizLevels 				= this->hizLevels,
+		.padding 				= {}
+	};
+	glBindBuffer(GL_COPY_WRITE_BUFFER,this->parametersBufferID);
+	glBufferSubData(GL_COPY_WRITE_BUFFER,0,sizeof(this->parameters),&this->parameters);
+
+	// commands which won't be written have to draw nothing when the count can't be read from the GPU
+	const u32 zero = 0;
+	glBindBuffer(GL_COPY_WRITE_BUFFER,this->drawCountBufferID);
+	glClearBufferData(GL_COPY_WRITE_BUFFER,GL_R32UI,GL_RED_INTEGER,GL_UNSIGNED_INT,&zero);
+	if(!this->drawCountSupported)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER,this->commandBufferID);
+		glClearBufferData(GL_COPY_WRITE_BUFFER,GL_R32UI,GL_RED_INTEGER,GL_UNSIGNED_INT,&zero);
+	}
+
+	glState.BindBufferBase(GL_UNIFORM_BUFFER,parametersBinding,this->parametersBufferID);
+	glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER,0,this->instanceBufferID);
+	glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER,1,this->instanceGroupBufferID);
+	glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER,2,this->groupBufferID);
+	glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER,3,this->visibleInstanceBufferID);
+	glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER,4,this->commandBufferID);
+	glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER,5,this->drawCountBufferID);
+	if(this->hizLevels != 0)
+		glState.BindTexture(hizTextureUnit,GL_TEXTURE_2D,this->hizTextureID);
+
+	// pyramid was written by image stores and is read through a sampler
+	shaderManager.RequireMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	glState.UseProgram(this->info.cullProgram.programID);
+	shaderManager.DispatchCompute(this->info.cullProgram,glm::uvec3(this->numberOfInstances,1,1),GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glState.UseProgram(this->info.compactProgram.programID);
+	// the group counters reset by the compaction are read by the culling pass of the next frame
+	shaderManager.DispatchCompute(this->info.compactProgram,glm::uvec3(this->numberOfGroups,1,1),
+								  GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Draws the visible instances with the currently used program, which has to read the instances from binding 1
+void GPUCuller::Draw(ShaderManager &shaderManager,GLState &glState)
+{
+	PROFILE_SCOPE("GPUCuller::Draw");
+	if(this->numberOfInstances == 0)
+		return;
+
+	shaderManager.RequireMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+	glState.BindVertexArray(this->vertexArrayID);
+	glBindVertexBuffer(1,this->visibleInstanceBufferID,0,sizeof(InstanceData));
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER,this->commandBufferID);
+
+	if(this->drawCountSupported)
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB,this->drawCountBufferID);
+		if(GLEW_VERSION_4_6)
+			glMultiDrawElementsIndirectCount(GL_TRIANGLES,GL_UNSIGNED_INT,nullptr,0,this->numberOfGroups,0);
+		else
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES,GL_UNSIGNED_INT,nullptr,0,this->numberOfGroups,0);
+	}
+	else
+		glMultiDrawElementsIndirect(GL_TRIANGLES,GL_UNSIGNED_INT,nullptr,this->numberOfGroups,0);
+}
+
+// Reduces the depth of the finished frame into the maximum depth pyramid used by the next Cull.
+// The pyramid is reallocated when the size of the depth texture changes
+void GPUCuller::BuildHiZ(ShaderManager &shaderManager,GLState &glState,u32 depthTextureID,u32 width,u32 height)
+{
+	PROFILE_SCOPE("GPUCuller::BuildHiZ");
+	if(this->hizSize != glm::uvec2(width,height))
+	{
+		// a recreated texture may get the same name
+		glDeleteTextures(1,&this->hizTextureID);
+		glState.OnDelete(GL_TEXTURE,this->hizTextureID);
+
+		this->hizSize 	= glm::uvec2(width,height);
+		this->hizLevels = 1;
+		while((std::max(width,height) >> this->hizLevels) != 0)
+			this->hizLevels++;
+
+		glGenTextures(1,&this->hizTextureID);
+		glState.BindTexture(hizTextureUnit,GL_TEXTURE_2D,this->hizTextureID);
+		glTexStorage2D(GL_TEXTURE_2D,this->hizLevels,GL_R32F,width,height);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+	}
+
+	const ComputeProgram &program = this->info.hizProgram;
+	glState.UseProgram(program.programID);
+
+	// level 0 is copied from the depth texture, every other level reads the level below
+	glState.BindTexture(hizTextureUnit,GL_TEXTURE_2D,depthTextureID);
+	glProgramUniform1i(program.programID,0,1);
+	glState.BindImageTexture(1,this->hizTextureID,GL_WRITE_ONLY,GL_R32F,0);
+	shaderManager.DispatchCompute(program,glm::uvec3(width,height,1),GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	glProgramUniform1i(program.programID,0,0);
+	for(u32 level = 1;level < this->hizLevels;level++)
+	{
+		glState.BindImageTexture(0,this->hizTextureID,GL_READ_ONLY,GL_R32F,level - 1);
+		glState.BindImageTexture(1,this->hizTextureID,GL_WRITE_ONLY,GL_R32F,level);
+		shaderManager.DispatchCompute(program,glm::uvec3(std::max(1u,width >> level),std::max(1u,height >> level),1),
+									  level + 1 < this->hizLevels ? GL_SHADER_IMAGE_ACCESS_BARRIER_BIT : GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	this->previousViewProjection = this->viewProjection;
+}
+
+void GPUCuller::Delete()
+{
+	const std::array<u32,7> buffers = {
+		this->instanceBufferID,this->instanceGroupBufferID,this->groupBufferID,this->visibleInstanceBufferID,
+		this->commandBufferID,this->drawCountBufferID,this->parametersBufferID
+	};
+	glDeleteBuffers(buffers.size(),buffers.data());
+	glDeleteTextures(1,&this->hizTextureID);
+
+	this->instanceBufferID 		  = 0;
+	this->instanceGroupBufferID   = 0;
+	this->groupBufferID 		  = 0;
+	this->visibleInstanceBufferID = 0;
+	this->commandBufferID 		  = 0;
+	this->drawCountBufferID 	  = 0;
+	this->parametersBufferID 	  = 0;
+	this->hizTextureID 			  = 0;
+	this->hizSize 				  = glm::uvec2(0);
+	this->hizLevels 			  = 0;
+}
+
+f32 HiZReadback::Fetch(const glm::ivec2 &texel,u32 level) const
+{
+	return this->levels[level][static_cast<u64>(texel.y)*this->sizes[level].x + texel.x];
+}
+
+// Mirrors InsideFrustum of gpucull.comp
+bool GPUCuller::ReferenceInsideFrustum(const GPUCullingParameters &parameters,const glm::vec3 &center,const glm::vec3 &extent)
+{
+	for(const glm::vec4 &plane : parameters.frustumPlanes)
+		if(glm::dot(glm::vec3(plane),center) + plane.w + glm::dot(glm::abs(glm::vec3(plane)),extent) < 0.f)
+			return false;
+
+	return true;
+}
+
+// Mirrors Occluded of gpucull.comp, depthBias is added to the farthest depth of the covered texels
+bool GPUCuller::ReferenceOccluded(const GPUCullingParameters &parameters,const HiZReadback &hiz,
+								  const glm::vec3 &boundsMin,const glm::vec3 &boundsMax,f32 depthBias)
+{
+	if(parameters.hizLevels == 0)
+		return false;
+
+	glm::vec2 screenMin(1.f);
+	glm::vec2 screenMax(0.f);
+	f32 	  nearestDepth = 1.f;
+	for(u32 corner = 0;corner < 8;corner++)
+	{
+		const glm::vec3 position = glm::mix(boundsMin,boundsMax,glm::vec3(corner & 1u,(corner >> 1) & 1u,(corner >> 2) & 1u));
+		const glm::vec4 clip 	 = parameters.previousViewProjection*glm::vec4(position,1.f);
+		if(clip.w <= 1e-4f)
+			return false;
+
+		const glm::vec3 window = .5f*glm::vec3(clip)/clip.w + .5f;
+		screenMin 	 = glm::min(screenMin,glm::vec2(window));
+		screenMax 	 = glm::max(screenMax,glm::vec2(window));
+		nearestDepth = std::min(nearestDepth,window.z);
+	}
+
+	if(glm::any(glm::lessThan(screenMin,glm::vec2(0.f))) || glm::any(glm::greaterThan(screenMax,glm::vec2(1.f))))
+		return false;
+
+	const glm::ivec2 minTexel = glm::min(glm::ivec2(glm::floor(screenMin*parameters.hizSize)),glm::ivec2(parameters.hizSize) - 1);
+	const glm::ivec2 maxTexel = glm::min(glm::ivec2(glm::floor(screenMax*parameters.hizSize)),glm::ivec2(parameters.hizSize) - 1);
+
+	u32 level = 0;
+	while(level + 1 < parameters.hizLevels && glm::any(glm::greaterThan((maxTexel >> glm::ivec2(level)) - (minTexel >> glm::ivec2(level)),glm::ivec2(1))))
+		level++;
+
+	const glm::ivec2 levelMax = glm::max(glm::ivec2(parameters.hizSize) >> glm::ivec2(level),glm::ivec2(1)) - 1;
+	const glm::ivec2 low 	  = glm::min(minTexel >> glm::ivec2(level),levelMax);
+	const glm::ivec2 high 	  = glm::min(maxTexel >> glm::ivec2(level),levelMax);
+	const f32 farthest = std::max(std::max(hiz.Fetch(low,level),hiz.Fetch(glm::ivec2(high.x,low.y),level)),
+								  std::max(hiz.Fetch(glm::ivec2(low.x,high.y),level),hiz.Fetch(high,level)));
+
+	return nearestDepth > farthest + depthBias;
+}
+
+// Compares the draw commands and compacted instances of the last Cull with the CPU reference, has to be called
+// before BuildHiZ replaces the pyramid the culling pass read. GPU and CPU arithmetic differ in the last bits, so
+// instances close to a test's boundary may go either way: every instance visible with its box shrunk by a small
+// margin has to be drawn, and every drawn instance has to be visible with its box grown by the margin
+bool GPUCuller::Verify(GLState &glState) const
+{
+	if(this->numberOfInstances == 0)
+		return true;
+
+	// results were written by shaders, reads through the API aren't ordered after them otherwise
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	auto readBuffer = [](u32 bufferID,auto &data,u64 count){
+		data.resize(count);
+		glBindBuffer(GL_COPY_READ_BUFFER,bufferID);
+		glGetBufferSubData(GL_COPY_READ_BUFFER,0,count*sizeof(data[0]),data.data());
+	};
+	std::vector<InstanceData> 				 instances;
+	std::vector<InstanceData> 				 visibleInstances;
+	std::vector<u32> 						 instanceGroups;
+	std::vector<GPUCullingGroup> 			 groups;
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<u32> 						 drawCount;
+	readBuffer(this->instanceBufferID,instances,this->numberOfInstances);
+	readBuffer(this->visibleInstanceBufferID,visibleInstances,this->numberOfInstances);
+	readBuffer(this->instanceGroupBufferID,instanceGroups,this->numberOfInstances);
+	readBuffer(this->groupBufferID,groups,this->numberOfGroups);
+	readBuffer(this->commandBufferID,commands,this->numberOfGroups);
+	readBuffer(this->drawCountBufferID,drawCount,1);
+
+	HiZReadback hiz;
+	if(this->parameters.hizLevels != 0)
+	{
+		// unit above the tracked ones, so the cache doesn't have to know about the binding
+		glState.BindTexture(GLState::textureUnits,GL_TEXTURE_2D,this->hizTextureID);
+		for(u32 level = 0;level < this->parameters.hizLevels;level++)
+		{
+			glm::ivec2 &size = hiz.sizes.emplace_back(0);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D,level,GL_TEXTURE_WIDTH,&size.x);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D,level,GL_TEXTURE_HEIGHT,&size.y);
+			hiz.levels.emplace_back(static_cast<u64>(size.x)*size.y);
+			glGetTexImage(GL_TEXTURE_2D,level,GL_RED,GL_FLOAT,hiz.levels.back().data());
+		}
+		glState.BindTexture(GLState::textureUnits,GL_TEXTURE_2D,0);
+	}
+
+	// margins scale with the coordinates, which the rounding errors of the transforms do as well
+	constexpr f32 extentTolerance = 1e-4f;
+	constexpr f32 depthTolerance  = 1e-7f;
+	std::vector<std::vector<InstanceData>> required(this->numberOfGroups);
+	std::vector<std::vector<InstanceData>> allowed(this->numberOfGroups);
+	for(u32 i = 0;i < this->numberOfInstances;i++)
+	{
+		const GPUCullingGroup &group = groups[instanceGroups[i]];
+		const glm::mat4 &transform 	 = instances[i].transform;
+
+		const glm::vec3 center 		= .5f*(glm::vec3(group.boundsMin) + glm::vec3(group.boundsMax));
+		const glm::vec3 extent 		= .5f*(glm::vec3(group.boundsMax) - glm::vec3(group.boundsMin));
+		const glm::vec3 worldCenter = glm::vec3(transform*glm::vec4(center,1.f));
+		const glm::mat3 axes 		= glm::mat3(transform);
+		const glm::vec3 worldExtent = glm::abs(axes[0])*extent.x + glm::abs(axes[1])*extent.y + glm::abs(axes[2])*extent.z;
+		const f32 		margin 		= extentTolerance*(1.f + glm::length(worldCenter) + glm::length(worldExtent));
+
+		auto visible = [&](f32 grow,f32 depthBias){
+			const glm::vec3 grownExtent = glm::max(worldExtent + grow,glm::vec3(0.f));
+			return ReferenceInsideFrustum(this->parameters,worldCenter,grownExtent) &&
+				   !ReferenceOccluded(this->parameters,hiz,worldCenter - grownExtent,worldCenter + grownExtent,depthBias);
+		};
+		if(visible(-margin,-depthTolerance))
+			required[instanceGroups[i]].push_back(instances[i]);
+		if(visible(margin,depthTolerance))
+			allowed[instanceGroups[i]].push_back(instances[i]);
+	}
+
+	// compacted instances are in the order of the atomic increments, so the ranges are compared as sorted multisets
+	auto less = [](const InstanceData &a,const InstanceData &b){
+		return std::memcmp(&a,&b,sizeof(InstanceData)) < 0;
+	};
+	for(u32 g = 0;g < this->numberOfGroups;g++)
+	{
+		std::sort(required[g].begin(),required[g].end(),less);
+		std::sort(allowed[g].begin(),allowed[g].end(),less);
+	}
+
+	bool valid = drawCount[0] <= this->numberOfGroups;
+	if(!valid)
+		std::cout << "GPU culling wrote " << drawCount[0] << " draw commands for " << this->numberOfGroups << " groups!" << std::endl;
+
+	std::vector<bool> drawn(this->numberOfGroups,false);
+	for(u32 c = 0;valid && c < drawCount[0];c++)
+	{
+		const DrawElementsIndirectCommand &command = commands[c];
+
+		// groups without instances share the first instance of the next group, which is the one drawn
+		const auto match = std::find_if(groups.rbegin(),groups.rend(),[&](const GPUCullingGroup &group){
+			return group.firstInstance == command.baseInstance;
+		});
+		const u32 g = match == groups.rend() ? ~0u : static_cast<u32>(groups.rend() - match - 1);
+		if(g == ~0u || drawn[g] || command.count != match->count || command.firstIndex != match->firstIndex || command.baseVertex != match->baseVertex)
+		{
+			std::cout << "GPU culling draw command " << c << " doesn't match a group or draws it twice!" << std::endl;
+			valid = false;
+			break;
+		}
+		drawn[g] = true;
+
+		std::vector<InstanceData> drawnInstances(visibleInstances.begin() + command.baseInstance,
+												 visibleInstances.begin() + std::min(command.baseInstance + command.instanceCount,this->numberOfInstances));
+		std::sort(drawnInstances.begin(),drawnInstances.end(),less);
+		if(!std::includes(drawnInstances.begin(),drawnInstances.end(),required[g].begin(),required[g].end(),less) ||
+		   !std::includes(allowed[g].begin(),allowed[g].end(),drawnInstances.begin(),drawnInstances.end(),less))
+		{
+			std::cout << "GPU culling drew " << command.instanceCount << " instances of group " << g << ", the reference draws "
+					  << required[g].size() << " to " << allowed[g].size() << " of them!" << std::endl;
+			valid = false;
+		}
+	}
+
+	for(u32 g = 0;valid && g < this->numberOfGroups;g++)
+	{
+		if(!drawn[g] && !required[g].empty())
+		{
+			std::cout << "GPU culling drew no instances of group " << g << ", the reference draws at least " << required[g].size() << '!' << std::endl;
+			valid = false;
+		}
+		if(groups[g].visibleInstances != 0)
+		{
+			std::cout << "GPU culling didn't reset the visible instance counter of group " << g << '!' << std::endl;
+			valid = false;
+		}
+	}
+
+	return valid;
+}
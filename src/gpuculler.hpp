@@ -0,0 +1,108 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstring>
+
+#include <GLEW/glew.h>
+#include <glm/glm.hpp>
+
+#include "types.hpp"
+#include "modelmanager.hpp"
+#include "shadermanager.hpp"
+#include "glstate.hpp"
+#include "drawbatch.hpp"
+#include "profiler.hpp"
+
+// Mirror of CullingGroup in assets/shaders/include/gpuculling.glsl (std430)
+struct GPUCullingGroup
+{
+	glm::vec4 		   boundsMin;
+	glm::vec4 		   boundsMax;
+	u32 	  		   count;
+	u32 	  		   firstIndex;
+	i32 	  		   baseVertex;
+	u32 	  		   firstInstance;
+	u32 	  		   visibleInstances;
+	std::array<u32,3>  padding;
+};
+
+// Mirror of the CullingParameters uniform block (std140)
+struct GPUCullingParameters
+{
+	glm::mat4 				viewProjection;
+	glm::mat4 				previousViewProjection;
+	std::array<glm::vec4,6> frustumPlanes;
+	glm::vec2 				hizSize;
+	u32 					numberOfInstances;
+	u32 					numberOfGroups;
+	u32 					hizLevels;
+	std::array<u32,3> 		padding;
+};
+
+struct GPUCullerInfo
+{
+	ComputeProgram cullProgram;		// assets/shaders/gpucull.comp
+	ComputeProgram compactProgram;	// assets/shaders/gpucompact.comp
+	ComputeProgram hizProgram;		// assets/shaders/hiz.comp
+};
+
+// CPU copy of the depth pyramid, read back for the reference test
+struct HiZReadback
+{
+	std::vector<glm::ivec2> 	  sizes;  // of every level
+	std::vector<std::vector<f32>> levels; // rows bottom to top, like texelFetch
+
+	f32 Fetch(const glm::ivec2 &texel,u32 level) const;
+};
+
+// GPU driven culling of instanced models stored in the same geometry arena. Instances and model bounds live
+// in storage buffers, a compute pass tests every instance against the frustum and the depth pyramid of the
+// previous frame and appends the visible ones to their model's range, a second pass turns non-empty ranges
+// into indirect draw commands counted by an atomic counter. The draw itself is a single
+// glMultiDrawElementsIndirectCount, so the CPU cost doesn't depend on the number of instances.
+// Without ARB_indirect_parameters all commands are drawn, the unused ones have no instances
+struct GPUCuller
+{
+	static constexpr u32 parametersBinding 	= 1; // uniform buffer binding, 0 is used by the materials
+	static constexpr u32 hizTextureUnit 	= 0;
+
+	GPUCullerInfo 				 info;				// compute programs of the passes
+	std::vector<GPUCullingGroup> groups 		= {};	// staged by AddGroup, uploaded by Upload
+	std::vector<InstanceData> 	 instances 		= {};
+	std::vector<u32> 			 instanceGroups = {};	// group of every instance
+	u32 						 vertexArrayID 	   = 0;
+	u32 						 numberOfInstances = 0;
+	u32 						 numberOfGroups    = 0;
+	bool 						 drawCountSupported = false;
+
+	u32 instanceBufferID 		= 0;
+	u32 instanceGroupBufferID 	= 0;
+	u32 groupBufferID 			= 0;
+	u32 visibleInstanceBufferID = 0;
+	u32 commandBufferID 		= 0;
+	u32 drawCountBufferID 		= 0;
+	u32 parametersBufferID 		= 0;
+
+	u32 	   hizTextureID = 0;
+	glm::uvec2 hizSize 		= glm::uvec2(0);
+	u32 	   hizLevels 	= 0; // 0 until the first pyramid is built
+	glm::mat4  viewProjection 	= glm::mat4(1.f); // of the frame being rendered, becomes previousViewProjection once its depth is in the pyramid
+	glm::mat4  previousViewProjection = glm::mat4(1.f);
+	GPUCullingParameters parameters = {}; // of the last Cull
+
+	void AddGroup(const Model &model,const InstanceData *groupInstances,u32 numberOfGroupInstances);
+	void Upload();
+	void Cull(ShaderManager &shaderManager,GLState &glState,const glm::mat4 &viewProjection);
+	void Draw(ShaderManager &shaderManager,GLState &glState);
+	void BuildHiZ(ShaderManager &shaderManager,GLState &glState,u32 depthTextureID,u32 width,u32 height);
+	void Delete();
+
+	// CPU reference of the culling passes, the results of the last Cull are read back and compared
+	bool Verify(GLState &glState) const;
+	static bool ReferenceInsideFrustum(const GPUCullingParameters &parameters,const glm::vec3 &center,const glm::vec3 &extent);
+	static bool ReferenceOccluded(const GPUCullingParameters &parameters,const HiZReadback &hiz,
+								  const glm::vec3 &boundsMin,const glm::vec3 &boundsMax,f32 depthBias);
+};
@@ -0,0 +1,184 @@
+#include "gpuprofiler.hpp"
+
+// Stays disabled when the profiler is compiled out or the implementation has no timestamp counter
+// (GL_QUERY_COUNTER_BITS of 0 is allowed by the specification)
+void GPUProfiler::Create()
+{
+	if(!profilerEnabled)
+		return;
+
+	i32 counterBits = 0;
+	glGetQueryiv(GL_TIMESTAMP,GL_QUERY_COUNTER_BITS,&counterBits);
+	if(counterBits == 0)
+	{
+		std::cout << "GPU timestamp queries aren't supported, GPU profiling is disabled." << std::endl;
+		return;
+	}
+
+	this->supported = true;
+	this->track 	= Profiler::Get().AddTrack("GPU");
+	Calibrate();
+}
+
+// Reads back the frame which last used the slot and starts the zone spanning the whole frame
+void GPUProfiler::BeginFrame()
+{
+	if(!this->supported)
+		return;
+
+	GPUFrame &frame = this->frames[this->frameIndex%framesInFlight];
+	if(!frame.zones.empty() && !ReadBack(frame))
+		this->droppedFrames++;
+	frame.usedQueries = 0;
+	frame.zones.clear();
+	frame.openZones.clear();
+
+	if(this->frameIndex%calibrationInterval == 0)
+		Calibrate();
+
+	this->inFrame = true;
+	BeginZone("GPU frame");
+}
+
+// Zones left open are closed here, so a frame's zones always have both timestamps
+void GPUProfiler::EndFrame()
+{
+	if(!this->inFrame)
+		return;
+
+	while(!this->frames[this->frameIndex%framesInFlight].openZones.empty())
+		EndZone();
+	this->inFrame = false;
+	this->frameIndex++;
+}
+
+void GPUProfiler::BeginZone(const char *name)
+{
+	if(!this->inFrame)
+		return;
+
+	GPUFrame &frame = this->frames[this->frameIndex%framesInFlight];
+	frame.openZones.push_back(frame.zones.size());
+	frame.zones.push_back(GPUZone{
+		.name 		= name,
+		.beginQuery = Timestamp(frame)
+	});
+}
+
+void GPUProfiler::EndZone()
+{
+	if(!this->inFrame)
+		return;
+
+	GPUFrame &frame = this->frames[this->frameIndex%framesInFlight];
+	if(frame.openZones.empty())
+		return;
+
+	frame.zones[frame.openZones.back()].endQuery = Timestamp(frame);
+	frame.openZones.pop_back();
+}
+
+// Records the GPU time at which all previous commands have finished, into the next free query of the frame
+u32 GPUProfiler::Timestamp(GPUFrame &frame)
+{
+	if(frame.usedQueries == frame.queries.size())
+	{
+		frame.queries.resize(frame.queries.size() + queryPoolGrowth);
+		glGenQueries(queryPoolGrowth,frame.queries.data() + frame.usedQueries);
+	}
+
+	glQueryCounter(frame.queries[frame.usedQueries],GL_TIMESTAMP);
+	return frame.usedQueries++;
+}
+
+// The GL_TIMESTAMP state is the GPU time once all previous commands have reached the GPU, without waiting for
+// them to execute, so pairing it with the CPU time now gives the offset between the two clocks
+void GPUProfiler::Calibrate()
+{
+	i64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP,&gpuTime);
+	const u64 cpuTime = Profiler::Get().NanosecondsSinceStart(std::chrono::steady_clock::now());
+	this->gpuToProfilerOffset = static_cast<i64>(cpuTime) - gpuTime;
+}
+
+// Doesn't wait for results, false if any query of the frame hasn't finished yet
+bool GPUProfiler::ReadBack(GPUFrame &frame)
+{
+	for(u32 i = 0;i < frame.usedQueries;i++)
+	{
+		i32 available = 0;
+		glGetQueryObjectiv(frame.queries[i],GL_QUERY_RESULT_AVAILABLE,&available);
+		if(!available)
+			return false;
+	}
+
+	auto toProfilerTime = [this](u32 query){
+		u64 gpuTime = 0;
+		glGetQueryObjectui64v(query,GL_QUERY_RESULT,&gpuTime);
+		return static_cast<u64>(std::max<i64>(static_cast<i64>(gpuTime) + this->gpuToProfilerOffset,0));
+	};
+
+	// queries were issued in order on one context, so their times can't decrease, which also makes every zone
+	// end after it began and nest inside the zone it was opened in
+	u64 previousTime = 0;
+	bool ordered 	 = true;
+	for(u32 i = 0;i < frame.usedQueries;i++)
+	{
+		const u64 time = toProfilerTime(frame.queries[i]);
+		ordered 	   = ordered && time >= previousTime;
+		previousTime   = time;
+	}
+	this->invalidFrames += !ordered;
+	this->readFrames++;
+
+	this->events.clear();
+	for(const GPUZone &zone : frame.zones)
+	{
+		const u64 begin = toProfilerTime(frame.queries[zone.beginQuery]);
+		const u64 end 	= toProfilerTime(frame.queries[zone.endQuery]);
+		this->events.push_back(ProfileEvent{
+			.name  = zone.name,
+			.begin = begin,
+			.end   = std::max(begin,end),
+			.value = 0.0,
+			.type  = ZONE_EVENT,
+			.track = this->track
+		});
+	}
+	Profiler::Get().AddEvents(this->events);
+	return true;
+}
+
+void GPUProfiler::PrintStatistics() const
+{
+	if(this->supported)
+		std::cout << "GPU profiler frames read back: " << this->readFrames
+				  << ", dropped (results not ready after " << framesInFlight << " frames): " << this->droppedFrames << std::endl;
+}
+
+// Fails if the timestamps of a read back frame were out of order, or if no frame was ever read back although
+// enough frames were rendered for the first slot to come around again
+bool GPUProfiler::Verify() const
+{
+	if(!this->supported)
+		return true;
+
+	if(this->invalidFrames != 0)
+		std::cout << "GPU profiler read back " << this->invalidFrames << " frames with timestamps out of order!" << std::endl;
+	if(this->readFrames == 0 && this->frameIndex > framesInFlight)
+		std::cout << "GPU profiler didn't read back any of " << this->frameIndex << " frames!" << std::endl;
+
+	return this->invalidFrames == 0 && (this->readFrames != 0 || this->frameIndex <= framesInFlight);
+}
+
+void GPUProfiler::Delete()
+{
+	for(GPUFrame &frame : this->frames)
+	{
+		if(!frame.queries.empty())
+			glDeleteQueries(frame.queries.size(),frame.queries.data());
+		frame = GPUFrame{};
+	}
+	this->supported = false;
+	this->inFrame 	= false;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <algorithm>
+
+#include <GLEW/glew.h>
+
+#include "types.hpp"
+#include "profiler.hpp"
+
+// Compiles to nothing unless PROFILER_ENABLED is defined, like the CPU zones
+#if defined(PROFILER_ENABLED)
+	#define PROFILE_GPU_SCOPE(gpuProfiler,name) GPUProfileScope PROFILE_CONCATENATE(gpuProfileScope,__LINE__)(gpuProfiler,name)
+#else
+	#define PROFILE_GPU_SCOPE(gpuProfiler,name)
+#endif
+
+// Zone of a frame, begin and end index the frame's timestamp queries
+struct GPUZone
+{
+	const char *name;
+	u32 		beginQuery;
+	u32 		endQuery = ~0u; // ~0u while the zone is open
+};
+
+// Timestamp queries issued during one frame, read back when the slot is reused framesInFlight frames later
+struct GPUFrame
+{
+	std::vector<u32> 	 queries; 		  // pooled query objects, only grows
+	u32 				 usedQueries = 0;
+	std::vector<GPUZone> zones;
+	std::vector<u32> 	 openZones; 	  // stack of indices into zones
+};
+
+// GPU profiler built on GL_TIMESTAMP queries (glQueryCounter), which unlike GL_TIME_ELAPSED queries can nest.
+// Zones are recorded into the slot of the current frame and read back when the slot comes around again, by then
+// the GPU has normally finished the frame so reading never stalls. Results which still aren't available are dropped.
+// GPU timestamps are mapped onto the CPU profiler's clock with an offset measured with glGetInteger64v(GL_TIMESTAMP)
+// and the zones are added to the CPU profiler on their own "GPU" track, so they show up in the same trace and
+// statistics, framesInFlight frames late. Zones may only be opened between BeginFrame and EndFrame on the GL thread
+struct GPUProfiler
+{
+	static constexpr u32 framesInFlight 	 = 3;
+	static constexpr u32 calibrationInterval = 120; // frames, the clocks drift apart slowly
+	static constexpr u32 queryPoolGrowth 	 = 32;
+
+	std::array<GPUFrame,framesInFlight> frames;
+	u64 								frameIndex 			= 0;
+	u32 								track 				= 0;
+	i64 								gpuToProfilerOffset = 0; // nanoseconds added to a GPU timestamp
+	u64 								droppedFrames 		= 0;
+	u64 								readFrames 			= 0;
+	u64 								invalidFrames 		= 0; // read back with timestamps out of issue order
+	bool 								supported 			= false;
+	bool 								inFrame 			= false;
+	std::vector<ProfileEvent> 			events; // scratch of ReadBack
+
+	void Create();
+	void BeginFrame();
+	void EndFrame();
+	void BeginZone(const char *name);
+	void EndZone();
+	void PrintStatistics() const;
+	bool Verify() const;
+	void Delete();
+
+	u32  Timestamp(GPUFrame &frame);
+	void Calibrate();
+	bool ReadBack(GPUFrame &frame);
+};
+
+// Times the GL commands issued from its construction to the end of the scope, use PROFILE_GPU_SCOPE
+struct GPUProfileScope
+{
+	GPUProfiler &profiler;
+
+	GPUProfileScope(GPUProfiler &profiler,const char *name) : profiler(profiler)
+	{
+		this->profiler.BeginZone(name);
+	}
+	~GPUProfileScope()
+	{
+		this->profiler.EndZone();
+	}
+};
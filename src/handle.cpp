@@ -0,0 +1,21 @@
+#include "handle.hpp"
+
+u32 NameTable::Intern(const std::string &name)
+{
+	const auto [id,inserted] = this->ids.try_emplace(name,this->names.size());
+	if(inserted)
+		this->names.push_back(name);
+
+	return id->second;
+}
+
+u32 NameTable::Find(const std::string &name) const
+{
+	const auto id = this->ids.find(name);
+	return id != this->ids.end() ? id->second : ~0u;
+}
+
+const std::string &NameTable::Name(u32 id) const
+{
+	return this->names[id];
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "types.hpp"
+
+// 32-bit reference to an element of a SlotMap, the slot index is stored in the low 20 bits and the slot's
+// generation in the high 12 bits. Generations start at 1, so a default constructed handle is never valid.
+// Tag only keeps handles of different resource types from being mixed up
+template<typename Tag>
+struct Handle
+{
+	static constexpr u32 indexBits 		= 20;
+	static constexpr u32 indexMask 		= (1u << indexBits) - 1;
+	static constexpr u32 generationMask = (1u << (32 - indexBits)) - 1;
+
+	u32 value = 0;
+
+	u32  Index() const 		{ return this->value & indexMask; }
+	u32  Generation() const { return this->value >> indexBits; }
+	bool IsNull() const 	{ return this->value == 0; }
+
+	bool operator==(const Handle &handle) const = default;
+
+	static Handle Make(u32 index,u32 generation) { return Handle{.value = generation << indexBits | index}; }
+};
+
+// Slot of a SlotMap, denseIndex is the next free slot (or ~0u) while the slot is free
+struct SlotMapSlot
+{
+	u32 denseIndex;
+	u32 generation;
+};
+
+// Elements are stored densely (iteration is a linear walk over values), handles point to slots which point
+// to the dense elements. Erasing moves the last element into the hole, so pointers and references to
+// elements are only stable until the next Insert or Erase, handles stay valid until their element is erased.
+// Erasing bumps the slot's generation, so stale handles are detected instead of reading a reused slot
+template<typename T>
+struct SlotMap
+{
+	std::vector<T> 			 values;			// dense elements
+	std::vector<u32> 		 valueSlots;		// slot of every dense element
+	std::vector<SlotMapSlot> slots;
+	u32 					 freeSlot = ~0u;	// head of the free slot list
+
+	Handle<T> Insert(T value)
+	{
+		u32 slotIndex = this->freeSlot;
+		if(slotIndex != ~0u)
+			this->freeSlot = this->slots[slotIndex].denseIndex;
+		else
+		{
+			if(this->slots.size() > Handle<T>::indexMask)
+			{
+				std::cout << "Slot map is full, no more than " << Handle<T>::indexMask + 1 << " elements can be stored!" << std::endl;
+				exit(-1);
+			}
+			slotIndex = this->slots.size();
+			this->slots.push_back(SlotMapSlot{.denseIndex = 0,.generation = 1});
+		}
+
+		SlotMapSlot &slot = this->slots[slotIndex];
+		slot.denseIndex = this->values.size();
+		this->values.push_back(std::move(value));
+		this->valueSlots.push_back(slotIndex);
+
+		return Handle<T>::Make(slotIndex,slot.generation);
+	}
+
+	void Erase(Handle<T> handle)
+	{
+		if(!Contains(handle))
+			return;
+
+		SlotMapSlot &slot = this->slots[handle.Index()];
+		const u32 last = this->values.size() - 1;
+		if(slot.denseIndex != last)
+		{
+			this->values[slot.denseIndex] 	  = std::move(this->values[last]);
+			this->valueSlots[slot.denseIndex] = this->valueSlots[last];
+			this->slots[this->valueSlots[last]].denseIndex = slot.denseIndex;
+		}
+		this->values.pop_back();
+		this->valueSlots.pop_back();
+
+		// generation 0 is skipped when it wraps around, so null handles never become valid
+		slot.generation = (slot.generation & Handle<T>::generationMask) == Handle<T>::generationMask ? 1 : slot.generation + 1;
+		slot.denseIndex = this->freeSlot;
+		this->freeSlot  = handle.Index();
+	}
+
+	bool Contains(Handle<T> handle) const
+	{
+		return handle.Index() < this->slots.size() && this->slots[handle.Index()].generation == handle.Generation() && !handle.IsNull();
+	}
+
+	// nullptr for null and stale handles
+	T *Find(Handle<T> handle) 			  { return Contains(handle) ? &this->values[this->slots[handle.Index()].denseIndex] : nullptr; }
+	const T *Find(Handle<T> handle) const { return Contains(handle) ? &this->values[this->slots[handle.Index()].denseIndex] : nullptr; }
+
+	// Stale handles are a bug of the caller, they are reported instead of returning another element
+	T &operator[](Handle<T> handle)
+	{
+		if(!Contains(handle))
+			ReportStaleHandle(handle);
+		return this->values[this->slots[handle.Index()].denseIndex];
+	}
+	const T &operator[](Handle<T> handle) const
+	{
+		if(!Contains(handle))
+			ReportStaleHandle(handle);
+		return this->values[this->slots[handle.Index()].denseIndex];
+	}
+
+	Handle<T> HandleAt(u32 denseIndex) const
+	{
+		const u32 slotIndex = this->valueSlots[denseIndex];
+		return Handle<T>::Make(slotIndex,this->slots[slotIndex].generation);
+	}
+
+	void Clear()
+	{
+		while(!this->values.empty())
+			Erase(HandleAt(this->values.size() - 1));
+	}
+
+	u64  size() const  { return this->values.size(); }
+	bool empty() const { return this->values.empty(); }
+
+	auto begin() 		{ return this->values.begin(); }
+	auto end() 	 		{ return this->values.end(); }
+	auto begin() const 	{ return this->values.begin(); }
+	auto end() const 	{ return this->values.end(); }
+
+	[[noreturn]] static void ReportStaleHandle(Handle<T> handle)
+	{
+		std::cout << "Handle (slot " << handle.Index() << ", generation " << handle.Generation()
+				  << ") doesn't refer to an existing element!" << std::endl;
+		exit(-1);
+	}
+};
+
+// Interned strings, every distinct string gets a dense 32-bit id and is stored once
+struct NameTable
+{
+	std::unordered_map<std::string,u32> ids;
+	std::vector<std::string> 			names; // string of every id
+
+	u32 				Intern(const std::string &name);
+	u32 				Find(const std::string &name) const; // ~0u if the string was never interned
+	const std::string  &Name(u32 id) const;
+};
+
+// Names of the elements of a SlotMap. Names are only resolved when resources are created and looked up
+// at load time, anything done per frame works with the handles
+template<typename T>
+struct ResourceNames
+{
+	NameTable 			   table;
+	std::vector<Handle<T>> handles; // handle of the resource with every name id, null once it has been deleted
+
+	// returns the name id, which resources keep for diagnostics
+	u32 Assign(const std::string &name,Handle<T> handle)
+	{
+		const u32 id = this->table.Intern(name);
+		this->handles.resize(this->table.names.size());
+		this->handles[id] = handle;
+		return id;
+	}
+
+	// null handle if no existing resource has the name
+	Handle<T> Find(const std::string &name) const
+	{
+		const u32 id = this->table.Find(name);
+		return id != ~0u ? this->handles[id] : Handle<T>{};
+	}
+
+	void Remove(u32 id) { this->handles[id] = Handle<T>{}; }
+
+	const std::string &Name(u32 id) const { return this->table.Name(id); }
+};
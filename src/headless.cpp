@@ -0,0 +1,264 @@
+#include "headless.hpp"
+
+#if !defined(_WIN32)
+// Requests a 4.3 core context like the window does. Without a config (surfaceless platforms may not expose any)
+// the context is created with EGL_KHR_no_config_context
+void HeadlessContext::Create()
+{
+	const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY,EGL_EXTENSIONS);
+	if(HasExtension(clientExtensions,"EGL_MESA_platform_surfaceless"))
+	{
+		this->display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,EGL_DEFAULT_DISPLAY,nullptr);
+		if(this->display != EGL_NO_DISPLAY && !eglInitialize(this->display,nullptr,nullptr))
+			this->display = EGL_NO_DISPLAY;
+	}
+	if(this->display == EGL_NO_DISPLAY)
+	{
+		this->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if(this->display == EGL_NO_DISPLAY || !eglInitialize(this->display,nullptr,nullptr))
+		{
+			std::cout << "EGL display couldn't be initialized!" << std::endl;
+			exit(-1);
+		}
+	}
+
+	if(!eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cout << "EGL display doesn't support desktop OpenGL!" << std::endl;
+		exit(-1);
+	}
+
+	const std::array<EGLint,11> configAttributes = {
+		EGL_SURFACE_TYPE, 	 EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 		 8,
+		EGL_GREEN_SIZE, 	 8,
+		EGL_BLUE_SIZE, 		 8,
+		EGL_NONE
+	};
+	EGLConfig config 	   = nullptr;
+	EGLint numberOfConfigs = 0;
+	eglChooseConfig(this->display,configAttributes.data(),&config,1,&numberOfConfigs);
+
+	const char *displayExtensions = eglQueryString(this->display,EGL_EXTENSIONS);
+	const bool surfaceless 		  = HasExtension(displayExtensions,"EGL_KHR_surfaceless_context");
+	if(numberOfConfigs == 0 && !(surfaceless && HasExtension(displayExtensions,"EGL_KHR_no_config_context")))
+	{
+		std::cout << "EGL display has no config for an OpenGL pbuffer!" << std::endl;
+		exit(-1);
+	}
+
+	const std::array<EGLint,7> contextAttributes = {
+		EGL_CONTEXT_MAJOR_VERSION, 		 4,
+		EGL_CONTEXT_MINOR_VERSION, 		 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	this->context = eglCreateContext(this->display,numberOfConfigs ? config : EGL_NO_CONFIG_KHR,EGL_NO_CONTEXT,contextAttributes.data());
+	if(this->context == EGL_NO_CONTEXT)
+	{
+		std::cout << "EGL couldn't create an OpenGL 4.3 core context!" << std::endl;
+		exit(-1);
+	}
+
+	if(!surfaceless)
+	{
+		const std::array<EGLint,5> surfaceAttributes = {EGL_WIDTH,1,EGL_HEIGHT,1,EGL_NONE};
+		this->surface = eglCreatePbufferSurface(this->display,config,surfaceAttributes.data());
+	}
+	if(!eglMakeCurrent(this->display,this->surface,this->surface,this->context))
+	{
+		std::cout << "EGL context couldn't be made current!" << std::endl;
+		exit(-1);
+	}
+
+	std::cout << "Headless OpenGL context on: " << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << std::endl;
+}
+
+void HeadlessContext::Delete()
+{
+	for(GLsync &fence : this->frameFences)
+		if(fence)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+	if(this->display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(this->display,EGL_NO_SURFACE,EGL_NO_SURFACE,EGL_NO_CONTEXT);
+	if(this->surface != EGL_NO_SURFACE)
+		eglDestroySurface(this->display,this->surface);
+	if(this->context != EGL_NO_CONTEXT)
+		eglDestroyContext(this->display,this->context);
+	eglTerminate(this->display);
+
+	this->display = EGL_NO_DISPLAY;
+	this->context = EGL_NO_CONTEXT;
+	this->surface = EGL_NO_SURFACE;
+}
+#else
+void HeadlessContext::Create()
+{
+	std::cout << "Headless mode requires EGL, which isn't available on this platform!" << std::endl;
+	exit(-1);
+}
+
+void HeadlessContext::Delete() {}
+#endif
+
+// Waits for the frame which used the fence's slot, the wait also flushes the commands of the current frame
+void HeadlessContext::EndFrame()
+{
+	GLsync &fence = this->frameFences[this->frameIndex%framesInFlight];
+	if(fence)
+	{
+		while(glClientWaitSync(fence,GL_SYNC_FLUSH_COMMANDS_BIT,1'000'000'000) == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+	}
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+	glFlush();
+	this->frameIndex++;
+}
+
+// Extension strings are space separated, a plain substring search would also match longer names
+bool HeadlessContext::HasExtension(const char *extensions,std::string_view name)
+{
+	if(!extensions)
+		return false;
+
+	std::string_view remaining = extensions;
+	while(!remaining.empty())
+	{
+		const u64 end = std::min(remaining.find(' '),remaining.size());
+		if(remaining.substr(0,end) == name)
+			return true;
+		remaining.remove_prefix(std::min(end + 1,remaining.size()));
+	}
+	return false;
+}
+
+void FrameDriver::Start()
+{
+	if(!this->compareDirectory.empty() && this->dumpDirectory.empty())
+	{
+		std::cout << "Frames can only be compared when they're dumped!" << std::endl;
+		exit(-1);
+	}
+
+	if(!this->dumpDirectory.empty())
+	{
+		std::error_code error;
+		std::filesystem::create_directories(this->dumpDirectory,error);
+		if(error)
+		{
+			std::cout << "Frame dump directory: \"" << this->dumpDirectory << "\" could not be created!" << std::endl;
+			exit(-1);
+		}
+	}
+	this->startTime = std::chrono::steady_clock::now();
+}
+
+bool FrameDriver::Running() const
+{
+	return this->frame < this->numberOfFrames;
+}
+
+f64 FrameDriver::Time() const
+{
+	return this->frame*this->timestep;
+}
+
+bool FrameDriver::ShouldDump() const
+{
+	if(this->dumpDirectory.empty())
+		return false;
+	return this->frame + 1 == this->numberOfFrames || (this->dumpInterval != 0 && this->frame%this->dumpInterval == 0);
+}
+
+// Zero padded, so the dumps sort by frame
+std::string FrameDriver::DumpPath() const
+{
+	std::ostringstream path;
+	path << this->dumpDirectory << "/frame" << std::setw(6) << std::setfill('0') << this->frame << ".ppm";
+	return path.str();
+}
+
+// Compares the dump of the current frame with the reference image of the same name, pixel by pixel
+bool FrameDriver::CompareDump() const
+{
+	const std::string path 			= DumpPath();
+	const std::string referencePath = this->compareDirectory + path.substr(this->dumpDirectory.size());
+
+	u32 width = 0,height = 0,referenceWidth = 0,referenceHeight = 0;
+	std::vector<u8> pixels,referencePixels;
+	if(!ReadImage(path,width,height,pixels) || !ReadImage(referencePath,referenceWidth,referenceHeight,referencePixels))
+		return false;
+
+	if(width != referenceWidth || height != referenceHeight)
+	{
+		std::cout << "Frame \"" << path << "\" is " << width << 'x' << height << ", the reference \"" << referencePath
+				  << "\" is " << referenceWidth << 'x' << referenceHeight << '!' << std::endl;
+		return false;
+	}
+
+	u64 differentPixels 	= 0;
+	u32 largestDifference 	= 0;
+	for(u64 pixel = 0;pixel < pixels.size()/3;pixel++)
+	{
+		u32 difference = 0;
+		for(u64 channel = pixel*3;channel < pixel*3 + 3;channel++)
+			difference = std::max<u32>(difference,std::abs(pixels[channel] - referencePixels[channel]));
+
+		differentPixels  += difference > this->tolerance;
+		largestDifference = std::max(largestDifference,difference);
+	}
+
+	if(differentPixels != 0)
+		std::cout << "Frame \"" << path << "\" differs from \"" << referencePath << "\" in " << differentPixels
+				  << " pixels, by up to " << largestDifference << '!' << std::endl;
+	return differentPixels == 0;
+}
+
+// Reads a binary PPM with 8 bit channels, like the ones written by Framebuffer::SaveColor
+bool FrameDriver::ReadImage(const std::string &path,u32 &width,u32 &height,std::vector<u8> &pixels)
+{
+	std::ifstream image(path,std::ios::in | std::ios::binary);
+	if(!image.is_open())
+	{
+		std::cout << "Image file at location: \"" << path << "\" could not be opened!" << std::endl;
+		return false;
+	}
+
+	std::string format;
+	u32 maxValue = 0;
+	image >> format >> width >> height >> maxValue;
+	image.get(); // single whitespace before the pixels
+	if(!image || format != "P6" || maxValue != 255)
+	{
+		std::cout << "Image file at location: \"" << path << "\" isn't a binary PPM with 8 bit channels!" << std::endl;
+		return false;
+	}
+
+	pixels.resize(static_cast<u64>(width)*height*3);
+	image.read(reinterpret_cast<char*>(pixels.data()),pixels.size());
+	if(!image)
+	{
+		std::cout << "Image file at location: \"" << path << "\" is truncated!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void FrameDriver::Advance()
+{
+	this->frame++;
+}
+
+void FrameDriver::PrintStatistics() const
+{
+	const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - this->startTime).count();
+	std::cout << "Rendered " << this->frame << " frames in " << seconds << "s ("
+			  << (this->frame ? 1e3*seconds/this->frame : 0.0) << "ms per frame)" << std::endl;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+
+#include <GLEW/glew.h>
+
+#if !defined(_WIN32)
+	#define EGL_NO_X11 				// X11 headers define macros (None, Status, ...) which clash with other code
+	#define MESA_EGL_NO_X11_HEADERS // older spelling of EGL_NO_X11
+	#include <EGL/egl.h>
+	#include <EGL/eglext.h>
+#endif
+
+#include "types.hpp"
+
+// OpenGL context without a window, for machines without a display (or a GPU, e.g. Mesa llvmpipe).
+// Uses EGL on the surfaceless platform when available, otherwise the default display with a pbuffer.
+// There's no usable default framebuffer either way, everything has to be rendered into framebuffer objects.
+// EndFrame stands in for the buffer swap, it keeps the CPU at most framesInFlight frames ahead of the GPU
+struct HeadlessContext
+{
+	static constexpr u32 framesInFlight = 2;
+
+#if !defined(_WIN32)
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+	EGLSurface surface = EGL_NO_SURFACE; // pbuffer, only without EGL_KHR_surfaceless_context
+#endif
+	std::array<GLsync,framesInFlight> frameFences = {};
+	u64 							  frameIndex  = 0;
+
+	void Create();
+	void EndFrame();
+	void Delete();
+
+	static bool HasExtension(const char *extensions,std::string_view name);
+};
+
+// Fixed-timestep frame driver of headless runs. Scene time advances by the same step every frame, however long
+// the frame took, and there's no input, so a given frame renders the same image on every run. Frames can be
+// dumped to files and compared with the dumps of a reference run
+struct FrameDriver
+{
+	u64 		numberOfFrames = 600;
+	f64 		timestep 	   = 1.0/60.0; // seconds of scene time per frame
+	u64 		frame 		   = 0;
+	std::string dumpDirectory;			   // nothing is dumped if empty
+	u64 		dumpInterval   = 0;		   // every dumpInterval-th frame is dumped, 0 dumps only the last frame
+	std::string compareDirectory;		   // dumps are compared with the files of the same name in it, if set
+	u64 		tolerance 	   = 0;		   // largest allowed difference of a color channel, other drivers round differently
+	std::chrono::steady_clock::time_point startTime;
+
+	void 		Start();
+	bool 		Running() const;
+	f64 		Time() const;
+	bool 		ShouldDump() const;
+	std::string DumpPath() const;
+	bool 		CompareDump() const;
+	void 		Advance();
+	void 		PrintStatistics() const;
+
+	static bool ReadImage(const std::string &path,u32 &width,u32 &height,std::vector<u8> &pixels);
+};
@@ -0,0 +1,280 @@
+#include "jobsystem.hpp"
+
+// worker the current thread belongs to, threads outside any job system have no worker
+static thread_local const JobSystem *currentJobSystem = nullptr;
+static thread_local u32 			 currentWorker 	  = ~0u;
+
+// Memory orders follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al.)
+bool JobDeque::Push(Job *job)
+{
+	const i64 bottom = this->bottom.load(std::memory_order_relaxed);
+	const i64 top 	 = this->top.load(std::memory_order_acquire);
+	if(bottom - top >= capacity)
+		return false;
+
+	this->jobs[bottom & (capacity - 1)].store(job,std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	this->bottom.store(bottom + 1,std::memory_order_relaxed);
+	return true;
+}
+
+// The last job is contended with thieves, whoever moves top past it first takes it
+Job *JobDeque::Pop()
+{
+	const i64 bottom = this->bottom.load(std::memory_order_relaxed) - 1;
+	this->bottom.store(bottom,std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	i64 top = this->top.load(std::memory_order_relaxed);
+
+	if(top > bottom) // empty
+	{
+		this->bottom.store(bottom + 1,std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job *job = this->jobs[bottom & (capacity - 1)].load(std::memory_order_relaxed);
+	if(top == bottom)
+	{
+		if(!this->top.compare_exchange_strong(top,top + 1,std::memory_order_seq_cst,std::memory_order_relaxed))
+			job = nullptr;
+		this->bottom.store(bottom + 1,std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+// Fails when another thread took the job first, even if the deque isn't empty
+Job *JobDeque::Steal()
+{
+	i64 top = this->top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const i64 bottom = this->bottom.load(std::memory_order_acquire);
+	if(top >= bottom)
+		return nullptr;
+
+	Job *job = this->jobs[top & (capacity - 1)].load(std::memory_order_relaxed);
+	if(!this->top.compare_exchange_strong(top,top + 1,std::memory_order_seq_cst,std::memory_order_relaxed))
+		return nullptr;
+
+	return job;
+}
+
+JobSystem::JobSystem(u32 threads)
+{
+	threads = std::max(1u,threads);
+	for(u32 i = 0;i < threads;i++)
+		this->deques.push_back(std::make_unique<JobDeque>());
+
+	currentJobSystem = this;
+	currentWorker 	 = 0;
+
+	this->workers.reserve(threads - 1);
+	for(u32 i = 1;i < threads;i++)
+		this->workers.emplace_back(&JobSystem::WorkerLoop,this,i);
+}
+
+JobSystem::~JobSystem()
+{
+	this->stopping.store(true);
+	this->signal.fetch_add(1,std::memory_order_release);
+	this->signal.notify_all();
+	this->workers.clear(); // joins
+
+	bool warned = false;
+	auto discard = [&warned](Job *job){
+		if(!warned)
+			std::cout << "Not all jobs have been run. Discarding the remaining jobs." << std::endl;
+		warned = true;
+		delete job;
+	};
+	for(const std::unique_ptr<JobDeque> &deque : this->deques)
+		while(Job *job = deque->Steal())
+			discard(job);
+	for(Job *job : this->mainThreadJobs)
+		discard(job);
+	for(Job *job : this->externalJobs)
+		discard(job);
+
+	if(currentJobSystem == this)
+		currentJobSystem = nullptr;
+}
+
+u32 JobSystem::NumberOfWorkers() const
+{
+	return this->deques.size();
+}
+
+bool JobSystem::IsMainThread() const
+{
+	return currentJobSystem == this && currentWorker == 0;
+}
+
+u32 JobSystem::CurrentWorker() const
+{
+	if(currentJobSystem != this)
+	{
+		std::cout << "Jobs can only be run and waited for on the threads of the job system!" << std::endl;
+		exit(-1);
+	}
+
+	return currentWorker;
+}
+
+// Jobs with an unfinished dependency are parked on the dependency and queued by the job which finishes it
+void JobSystem::Schedule(std::function<void()> function,JobCounter *counter,JobCounter *dependency)
+{
+	if(counter)
+		counter->pending.fetch_add(1,std::memory_order_relaxed);
+
+	Job *job = new Job{.function = std::move(function),.counter = counter};
+	if(dependency)
+	{
+		std::lock_guard lock(dependency->mutex);
+		if(!dependency->IsDone())
+		{
+			dependency->dependents.push_back(job);
+			return;
+		}
+	}
+
+	Enqueue(job);
+}
+
+void JobSystem::ScheduleOnMainThread(std::function<void()> function,JobCounter *counter)
+{
+	if(counter)
+		counter->pending.fetch_add(1,std::memory_order_relaxed);
+
+	std::lock_guard lock(this->mainThreadMutex);
+	this->mainThreadJobs.push_back(new Job{.function = std::move(function),.counter = counter});
+	this->queuedMainThreadJobs.fetch_add(1,std::memory_order_release);
+}
+
+// A full deque runs the job right away instead of growing
+void JobSystem::Enqueue(Job *job)
+{
+	if(currentJobSystem != this)
+	{
+		std::lock_guard lock(this->externalMutex);
+		this->externalJobs.push_back(job);
+		this->queuedExternalJobs.fetch_add(1,std::memory_order_release);
+	}
+	else if(!this->deques[currentWorker]->Push(job))
+		return Run(job);
+
+	this->signal.fetch_add(1,std::memory_order_release);
+	this->signal.notify_one();
+}
+
+// Own jobs first, then external jobs and the other deques starting after the own one, so thieves spread over the victims
+Job *JobSystem::FindJob(u32 worker)
+{
+	if(Job *job = this->deques[worker]->Pop())
+		return job;
+
+	if(this->queuedExternalJobs.load(std::memory_order_acquire) != 0)
+	{
+		std::lock_guard lock(this->externalMutex);
+		if(!this->externalJobs.empty())
+		{
+			Job *job = this->externalJobs.back();
+			this->externalJobs.pop_back();
+			this->queuedExternalJobs.fetch_sub(1,std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	const u32 numberOfWorkers = this->deques.size();
+	for(u32 i = 1;i < numberOfWorkers;i++)
+		if(Job *job = this->deques[(worker + i)%numberOfWorkers]->Steal())
+			return job;
+
+	return nullptr;
+}
+
+void JobSystem::Run(Job *job)
+{
+	PROFILE_SCOPE("Job");
+	job->function();
+	Complete(job->counter);
+	delete job;
+}
+
+// The counter is decremented under its mutex, Wait takes the mutex before returning, so a counter on
+// the waiter's stack isn't destroyed while the last job still uses it
+void JobSystem::Complete(JobCounter *counter)
+{
+	if(!counter)
+		return;
+
+	std::vector<Job*> ready;
+	{
+		std::lock_guard lock(counter->mutex);
+		if(counter->pending.fetch_sub(1,std::memory_order_acq_rel) != 1)
+			return;
+		ready.swap(counter->dependents);
+	}
+
+	for(Job *job : ready)
+		Enqueue(job);
+}
+
+// Runs the queued main thread jobs (only on the main thread) or a single other job, false if there was nothing to run
+bool JobSystem::RunPendingJob()
+{
+	const u32 worker = CurrentWorker();
+	if(worker == 0 && this->queuedMainThreadJobs.load(std::memory_order_acquire) != 0)
+		RunMainThreadJobs();
+	else if(Job *job = FindJob(worker))
+		Run(job);
+	else
+		return false;
+
+	return true;
+}
+
+// Runs other jobs until the counter is done
+void JobSystem::Wait(JobCounter &counter)
+{
+	while(!counter.IsDone())
+		if(!RunPendingJob())
+			std::this_thread::yield();
+
+	std::lock_guard lock(counter.mutex);
+}
+
+void JobSystem::RunMainThreadJobs()
+{
+	if(CurrentWorker() != 0)
+	{
+		std::cout << "Main thread jobs can only be run on the main thread!" << std::endl;
+		exit(-1);
+	}
+
+	std::vector<Job*> jobs;
+	{
+		std::lock_guard lock(this->mainThreadMutex);
+		jobs.swap(this->mainThreadJobs);
+		this->queuedMainThreadJobs.store(0,std::memory_order_relaxed);
+	}
+
+	for(Job *job : jobs)
+		Run(job);
+}
+
+// Sleeps on the signal when nothing can be stolen, a job queued after the signal was read wakes the worker right away
+void JobSystem::WorkerLoop(u32 worker)
+{
+	currentJobSystem = this;
+	currentWorker 	 = worker;
+	PROFILE_THREAD("Worker " + std::to_string(worker));
+
+	while(!this->stopping.load(std::memory_order_acquire))
+	{
+		const u32 signal = this->signal.load(std::memory_order_acquire);
+		if(Job *job = FindJob(worker))
+			Run(job);
+		else
+			this->signal.wait(signal,std::memory_order_acquire);
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <algorithm>
+
+#include "types.hpp"
+#include "profiler.hpp"
+
+struct Job;
+
+// Number of unfinished jobs, a job scheduled with a counter increments it and decrements it once it has run.
+// Jobs can depend on a counter, they're queued only after it has dropped to zero. A counter can be reused
+// once it's done
+struct JobCounter
+{
+	std::atomic<u32>  pending = 0;
+	std::mutex 		  mutex;	  // guards dependents
+	std::vector<Job*> dependents; // jobs waiting for the counter to drop to zero
+
+	bool IsDone() const { return this->pending.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job
+{
+	std::function<void()> function;
+	JobCounter 			 *counter = nullptr; // decremented after the function has returned
+};
+
+// Chase-Lev work-stealing deque. Only the owning worker pushes and pops (at the bottom, so it works on its
+// most recent, cache-warm jobs), any other worker steals from the top. Capacity is fixed, Push fails when full
+struct JobDeque
+{
+	static constexpr i64 capacity = 4096; // power of 2
+
+	alignas(64) std::atomic<i64> 		 top 	= 0;
+	alignas(64) std::atomic<i64> 		 bottom = 0;
+	std::array<std::atomic<Job*>,capacity> jobs;
+
+	bool Push(Job *job);
+	Job *Pop();
+	Job *Steal();
+};
+
+// Fixed pool of worker threads, each with its own deque. The thread that created the job system is worker 0,
+// it runs jobs while it waits on a counter, so waiting never blocks a worker the jobs may need. Idle workers
+// steal from the other deques and sleep when there's nothing to steal. Jobs scheduled from threads outside
+// the job system (e.g. I/O completion threads) go through a shared queue, waiting is only possible on the
+// threads of the job system. GL calls must stay on the main thread, jobs which need them are scheduled with
+// ScheduleOnMainThread and run by RunMainThreadJobs or while the main thread waits
+struct JobSystem
+{
+	std::vector<std::unique_ptr<JobDeque>> deques; 			 // one per worker, index 0 belongs to the main thread
+	std::vector<std::jthread> 			   workers;
+	std::atomic<u32> 					   signal 	= 0; 	 // changed whenever a job is queued, idle workers wait on it
+	std::atomic<bool> 					   stopping = false;
+	std::mutex 							   mainThreadMutex;
+	std::vector<Job*> 					   mainThreadJobs;
+	std::atomic<u32> 					   queuedMainThreadJobs = 0;
+	std::mutex 							   externalMutex;
+	std::vector<Job*> 					   externalJobs;	 // scheduled from threads outside the job system
+	std::atomic<u32> 					   queuedExternalJobs = 0;
+
+	JobSystem(u32 threads = std::max(1u,std::thread::hardware_concurrency()));
+	~JobSystem();
+
+	void Schedule(std::function<void()> function,JobCounter *counter = nullptr,JobCounter *dependency = nullptr);
+	void ScheduleOnMainThread(std::function<void()> function,JobCounter *counter = nullptr);
+	void Wait(JobCounter &counter);
+	bool RunPendingJob();
+	void RunMainThreadJobs();
+	u32  NumberOfWorkers() const;
+	u32  CurrentWorker() const;
+	bool IsMainThread() const;
+
+	// Calls function(begin,end) for slices of [0,count) of at least minimumSliceSize elements, one slice per
+	// worker at most. The calling thread takes the first slice and returns once all slices have finished
+	template<typename Function>
+	void ParallelFor(u32 count,u32 minimumSliceSize,Function &&function)
+	{
+		const u32 slices = std::clamp(count/std::max(1u,minimumSliceSize),1u,NumberOfWorkers());
+		const u32 slice  = (count + slices - 1)/slices;
+
+		JobCounter counter;
+		for(u32 i = 1;i < slices;i++)
+			Schedule([&function,i,slice,count](){
+				function(std::min(i*slice,count),std::min((i + 1)*slice,count));
+			},&counter);
+
+		function(0u,std::min(slice,count));
+		Wait(counter);
+	}
+
+	void Enqueue(Job *job);
+	Job *FindJob(u32 worker);
+	void Run(Job *job);
+	void Complete(JobCounter *counter);
+	void WorkerLoop(u32 worker);
+};
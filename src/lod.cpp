@@ -0,0 +1,313 @@
+#include "lod.hpp"
+#include "modelmanager.hpp"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+void Quadric::Add(const Quadric &quadric)
+{
+	this->xx += quadric.xx; this->xy += quadric.xy; this->xz += quadric.xz; this->xw += quadric.xw;
+	this->yy += quadric.yy; this->yz += quadric.yz; this->yw += quadric.yw;
+	this->zz += quadric.zz; this->zw += quadric.zw;
+	this->ww += quadric.ww;
+	this->weight += quadric.weight;
+}
+
+// Plane is dot(normal,p) + distance = 0, with a unit normal
+void Quadric::AddPlane(const glm::dvec3 &normal,f64 distance,f64 weight)
+{
+	this->xx += weight*normal.x*normal.x; this->xy += weight*normal.x*normal.y; this->xz += weight*normal.x*normal.z; this->xw += weight*normal.x*distance;
+	this->yy += weight*normal.y*normal.y; this->yz += weight*normal.y*normal.z; this->yw += weight*normal.y*distance;
+	this->zz += weight*normal.z*normal.z; this->zw += weight*normal.z*distance;
+	this->ww += weight*distance*distance;
+	this->weight += weight;
+}
+
+f64 Quadric::Error(const glm::vec3 &position) const
+{
+	const f64 x = position.x,y = position.y,z = position.z;
+	const f64 error = this->xx*x*x + 2.*this->xy*x*y + 2.*this->xz*x*z + 2.*this->xw*x
+					+ this->yy*y*y + 2.*this->yz*y*z + 2.*this->yw*y
+					+ this->zz*z*z + 2.*this->zw*z
+					+ this->ww;
+
+	return this->weight > 0. ? std::max(error,0.)/this->weight : 0.;
+}
+
+void MeshSimplifier::WeldIdenticalVertices(const std::vector<f32> &vertexData,u32 vertexSize,std::vector<u32> &indices)
+{
+	const u32 numberOfVertices = vertexData.size()/std::max(vertexSize,1u);
+
+	std::vector<u32> sorted(numberOfVertices);
+	std::iota(sorted.begin(),sorted.end(),0);
+	std::sort(sorted.begin(),sorted.end(),[&vertexData,vertexSize](u32 a,u32 b){
+		return std::lexicographical_compare(vertexData.begin() + a*vertexSize,vertexData.begin() + (a + 1)*vertexSize,
+											vertexData.begin() + b*vertexSize,vertexData.begin() + (b + 1)*vertexSize);
+	});
+
+	std::vector<u32> remap(numberOfVertices);
+	for(u32 i = 0;i < numberOfVertices;i++)
+	{
+		const bool same = i > 0 && std::equal(vertexData.begin() + sorted[i]*vertexSize,vertexData.begin() + (sorted[i] + 1)*vertexSize,
+											  vertexData.begin() + sorted[i - 1]*vertexSize);
+		remap[sorted[i]] = same ? remap[sorted[i - 1]] : sorted[i];
+	}
+
+	for(u32 &index : indices)
+		index = remap[index];
+}
+
+// Vertices sharing a position with another vertex lie on a seam, vertices of edges used by a single
+// triangle lie on a border, edges used by more than 2 triangles are non-manifold. All of them are locked
+std::vector<u8> MeshSimplifier::FindLockedVertices(const std::vector<glm::vec3> &positions,const std::vector<u32> &indices)
+{
+	std::vector<u8> locked(positions.size(),0);
+
+	// vertices are welded by position, so edges on the two sides of a seam count as the same edge.
+	// Vertices no triangle references (e.g. removed by WeldIdenticalVertices) don't form seams
+	std::vector<u8> referenced(positions.size(),0);
+	for(const u32 index : indices)
+		referenced[index] = 1;
+
+	std::vector<u32> sorted;
+	sorted.reserve(positions.size());
+	for(u32 vertex = 0;vertex < positions.size();vertex++)
+		if(referenced[vertex])
+			sorted.push_back(vertex);
+	std::sort(sorted.begin(),sorted.end(),[&positions](u32 a,u32 b){
+		const glm::vec3 &pa = positions[a],&pb = positions[b];
+		return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+	});
+
+	std::vector<u32> welded(positions.size());
+	for(u32 i = 0;i < sorted.size();)
+	{
+		u32 end = i + 1;
+		while(end < sorted.size() && positions[sorted[end]] == positions[sorted[i]])
+			end++;
+
+		for(u32 j = i;j < end;j++)
+		{
+			welded[sorted[j]] = sorted[i];
+			locked[sorted[j]] = end - i > 1;
+		}
+		i = end;
+	}
+
+	std::unordered_map<u64,u32> edgeTriangles;
+	edgeTriangles.reserve(indices.size());
+	for(u32 i = 0;i < indices.size();i += 3)
+		for(u32 edge = 0;edge < 3;edge++)
+		{
+			const u32 a = welded[indices[i + edge]],b = welded[indices[i + (edge + 1)%3]];
+			edgeTriangles[static_cast<u64>(std::min(a,b)) << 32 | std::max(a,b)]++;
+		}
+
+	for(const auto &[edge,triangles] : edgeTriangles)
+		if(triangles != 2)
+		{
+			locked[edge >> 32] = 1;
+			locked[edge & 0xFFFFFFFF] = 1;
+		}
+
+	return locked;
+}
+
+bool MeshSimplifier::FlipsTriangle(const std::vector<glm::vec3> &positions,const std::array<u32,3> &triangle,u32 vertex,u32 target)
+{
+	std::array<glm::vec3,3> corners;
+	for(u32 i = 0;i < 3;i++)
+		corners[i] = positions[triangle[i]];
+	const glm::vec3 before = glm::cross(corners[1] - corners[0],corners[2] - corners[0]);
+
+	for(u32 i = 0;i < 3;i++)
+		if(triangle[i] == vertex)
+			corners[i] = positions[target];
+	const glm::vec3 after = glm::cross(corners[1] - corners[0],corners[2] - corners[0]);
+
+	// degenerate results have a zero normal, so they are rejected too
+	return glm::dot(before,after) <= minimumFlipCosine*glm::length(before)*glm::length(after);
+}
+
+// Every pass collects the cheapest collapse of each unlocked vertex and applies them cheapest first.
+// A collapse locks the neighbourhood of the collapsed vertex for the rest of the pass, so the flip
+// tests of later collapses in the pass always see the triangles they will change
+f32 MeshSimplifier::Simplify(const std::vector<glm::vec3> &positions,std::vector<u32> &indices,u32 targetIndices)
+{
+	if(indices.size() <= targetIndices)
+		return 0.f;
+
+	const std::vector<u8> locked = FindLockedVertices(positions,indices);
+	const u32 numberOfVertices = positions.size();
+
+	std::vector<Quadric> quadrics(numberOfVertices);
+	for(u32 i = 0;i < indices.size();i += 3)
+	{
+		const glm::dvec3 p0 = positions[indices[i]],p1 = positions[indices[i + 1]],p2 = positions[indices[i + 2]];
+		const glm::dvec3 cross = glm::cross(p1 - p0,p2 - p0);
+		const f64 length = glm::length(cross);
+		if(length == 0.)
+			continue;
+
+		const glm::dvec3 normal = cross/length;
+		for(u32 corner = 0;corner < 3;corner++)
+			quadrics[indices[i + corner]].AddPlane(normal,-glm::dot(normal,p0),.5*length);
+	}
+
+	std::vector<u32> 		  triangleOffsets(numberOfVertices + 1);
+	std::vector<u32> 		  vertexTriangles;
+	std::vector<u32> 		  remap(numberOfVertices);
+	std::vector<u8> 		  touched(numberOfVertices);
+	std::vector<EdgeCollapse> collapses;
+	std::vector<u32> 		  vertexNeighbours,targetNeighbours;
+	f32 					  maxError = 0.f;
+
+	while(indices.size() > targetIndices)
+	{
+		// triangles around every vertex, triangleOffsets[v] is the first one of vertex v
+		std::fill(triangleOffsets.begin(),triangleOffsets.end(),0);
+		for(const u32 index : indices)
+			triangleOffsets[index + 1]++;
+		std::partial_sum(triangleOffsets.begin(),triangleOffsets.end(),triangleOffsets.begin());
+
+		vertexTriangles.resize(indices.size());
+		std::vector<u32> cursor(triangleOffsets.begin(),triangleOffsets.end() - 1);
+		for(u32 i = 0;i < indices.size();i++)
+			vertexTriangles[cursor[indices[i]]++] = i/3;
+
+		collapses.clear();
+		for(u32 vertex = 0;vertex < numberOfVertices;vertex++)
+		{
+			if(locked[vertex])
+				continue;
+
+			EdgeCollapse best = {.cost = std::numeric_limits<f32>::max(),.vertex = vertex,.target = ~0u};
+			for(u32 t = triangleOffsets[vertex];t < triangleOffsets[vertex + 1];t++)
+				for(u32 corner = 0;corner < 3;corner++)
+				{
+					const u32 target = indices[3*vertexTriangles[t] + corner];
+					if(target == vertex)
+						continue;
+
+					Quadric quadric = quadrics[vertex];
+					quadric.Add(quadrics[target]);
+					const f32 cost = quadric.Error(positions[target]);
+					if(cost < best.cost)
+						best = {.cost = cost,.vertex = vertex,.target = target};
+				}
+
+			if(best.target != ~0u)
+				collapses.push_back(best);
+		}
+		std::sort(collapses.begin(),collapses.end(),[](const EdgeCollapse &a,const EdgeCollapse &b){
+			return a.cost < b.cost;
+		});
+
+		std::iota(remap.begin(),remap.end(),0);
+		std::fill(touched.begin(),touched.end(),0);
+		u32 remainingIndices = indices.size();
+		u32 applied 		 = 0;
+
+		for(const EdgeCollapse &collapse : collapses)
+		{
+			if(remainingIndices <= targetIndices)
+				break;
+			if(touched[collapse.vertex] || touched[collapse.target])
+				continue;
+
+			// link condition: the edge's vertices may only share the neighbours of the triangles on the edge,
+			// otherwise the collapse would glue two parts of the surface together
+			vertexNeighbours.clear();
+			targetNeighbours.clear();
+			u32 edgeTriangles = 0;
+			bool flips = false;
+			for(u32 t = triangleOffsets[collapse.vertex];t < triangleOffsets[collapse.vertex + 1] && !flips;t++)
+			{
+				const u32 triangle = vertexTriangles[t];
+				const std::array<u32,3> corners = {indices[3*triangle],indices[3*triangle + 1],indices[3*triangle + 2]};
+				vertexNeighbours.insert(vertexNeighbours.end(),corners.begin(),corners.end());
+
+				if(std::find(corners.begin(),corners.end(),collapse.target) != corners.end())
+					edgeTriangles++;
+				else
+					flips = FlipsTriangle(positions,corners,collapse.vertex,collapse.target);
+			}
+			if(flips)
+				continue;
+
+			for(u32 t = triangleOffsets[collapse.target];t < triangleOffsets[collapse.target + 1];t++)
+				for(u32 corner = 0;corner < 3;corner++)
+					targetNeighbours.push_back(indices[3*vertexTriangles[t] + corner]);
+
+			std::sort(vertexNeighbours.begin(),vertexNeighbours.end());
+			vertexNeighbours.erase(std::unique(vertexNeighbours.begin(),vertexNeighbours.end()),vertexNeighbours.end());
+			std::sort(targetNeighbours.begin(),targetNeighbours.end());
+			targetNeighbours.erase(std::unique(targetNeighbours.begin(),targetNeighbours.end()),targetNeighbours.end());
+
+			u32 sharedNeighbours = 0;
+			for(const u32 neighbour : vertexNeighbours)
+				if(neighbour != collapse.vertex && neighbour != collapse.target &&
+				   std::binary_search(targetNeighbours.begin(),targetNeighbours.end(),neighbour))
+					sharedNeighbours++;
+			if(sharedNeighbours != edgeTriangles)
+				continue;
+
+			remap[collapse.vertex] = collapse.target;
+			quadrics[collapse.target].Add(quadrics[collapse.vertex]);
+			maxError = std::max(maxError,collapse.cost);
+
+			for(const u32 neighbour : vertexNeighbours)
+				touched[neighbour] = 1;
+			remainingIndices -= 3*edgeTriangles;
+			applied++;
+		}
+
+		if(applied == 0)
+			break;
+
+		// triangles which lost a corner to a collapse are dropped
+		u32 write = 0;
+		for(u32 i = 0;i < indices.size();i += 3)
+		{
+			const u32 a = remap[indices[i]],b = remap[indices[i + 1]],c = remap[indices[i + 2]];
+			if(a == b || b == c || a == c)
+				continue;
+
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+	}
+
+	return std::sqrt(maxError);
+}
+
+void LODSelector::SetProjection(f32 fovY,u32 screenHeight)
+{
+	this->pixelsPerUnit = screenHeight/(2.f*std::tan(.5f*fovY));
+}
+
+// Distance is measured to the nearest point of the world space bounds, so large models switch by their
+// closest part. The error is scaled by the largest scale of the transform
+u32 LODSelector::Select(const Model &model,const glm::mat4 &transform,const glm::vec3 &cameraPosition,u32 currentLOD) const
+{
+	if(model.numberOfLODs <= 1)
+		return 0;
+
+	const BoundingBox bounds = BoundingBox{.min = model.boundsMin,.max = model.boundsMax}.Transformed(transform);
+	const f32 distance = glm::length(glm::max(glm::max(bounds.min - cameraPosition,cameraPosition - bounds.max),glm::vec3(0.f)));
+	const f32 scale = std::max({glm::length(glm::vec3(transform[0])),glm::length(glm::vec3(transform[1])),glm::length(glm::vec3(transform[2]))});
+	const f32 errorToPixels = scale*this->pixelsPerUnit/std::max(distance,1e-4f);
+
+	for(u32 lod = model.numberOfLODs - 1;lod > 0;lod--)
+	{
+		const f32 threshold = lod > currentLOD ? (1.f - this->hysteresis)*this->pixelError : this->pixelError;
+		if(model.lods[lod].error*errorToPixels <= threshold)
+			return lod;
+	}
+
+	return 0;
+}
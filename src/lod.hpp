@@ -0,0 +1,69 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "types.hpp"
+
+struct Model;
+
+// Symmetric 4x4 matrix of the squared distance to a set of planes, weighted by the area of the triangles the
+// planes belong to. Dividing by the weight turns the error into a mean squared distance in object units
+struct Quadric
+{
+	f64 xx = 0.,xy = 0.,xz = 0.,xw = 0.;
+	f64 yy = 0.,yz = 0.,yw = 0.;
+	f64 zz = 0.,zw = 0.;
+	f64 ww = 0.;
+	f64 weight = 0.;
+
+	void Add(const Quadric &quadric);
+	void AddPlane(const glm::dvec3 &normal,f64 distance,f64 weight);
+	f64  Error(const glm::vec3 &position) const;
+};
+
+// Collapse of vertex into target, the vertex is replaced by the target in every triangle
+struct EdgeCollapse
+{
+	f32 cost;
+	u32 vertex;
+	u32 target;
+};
+
+// Quadric error metric mesh simplification by half edge collapses. Vertices are only ever moved onto
+// their neighbours, so a simplified mesh is an index buffer over the original vertices, LODs share the
+// vertex buffer of the model. Vertices on UV/normal seams (several vertices at the same position) and
+// on open borders are never collapsed, so the attributes along seams and the outline of open meshes are kept
+struct MeshSimplifier
+{
+	static constexpr f32 minimumFlipCosine = .2f; // collapses turning a triangle normal by more than ~78 degrees are rejected
+
+	// Simplifies the triangles in place until at most targetIndices remain or no collapse is possible.
+	// Returns the error of the worst collapse in object units: the square root of its quadric's mean squared distance
+	// to the original planes. It's an RMS distance, parts of the surface can be further from the original one
+	static f32 Simplify(const std::vector<glm::vec3> &positions,std::vector<u32> &indices,u32 targetIndices);
+
+	// Points indices of vertices with identical data (all vertexSize floats) to the first of them. Files often repeat
+	// vertices with the same attributes, those would otherwise be mistaken for seams
+	static void WeldIdenticalVertices(const std::vector<f32> &vertexData,u32 vertexSize,std::vector<u32> &indices);
+
+	static std::vector<u8> FindLockedVertices(const std::vector<glm::vec3> &positions,const std::vector<u32> &indices);
+	static bool 		   FlipsTriangle(const std::vector<glm::vec3> &positions,const std::array<u32,3> &triangle,u32 vertex,u32 target);
+};
+
+// Picks the coarsest LOD whose error projects to at most pixelError pixels. A coarser LOD than the
+// current one is only taken once its projected error drops below (1 - hysteresis)*pixelError, so an
+// object resting at the switching distance doesn't alternate between two LODs every frame
+struct LODSelector
+{
+	f32 pixelError 	  = 1.f;
+	f32 hysteresis 	  = .25f;
+	f32 pixelsPerUnit = 1.f; // pixels covered by a unit length at distance 1, set by SetProjection
+
+	void SetProjection(f32 fovY,u32 screenHeight);
+	u32  Select(const Model &model,const glm::mat4 &transform,const glm::vec3 &cameraPosition,u32 currentLOD) const;
+};
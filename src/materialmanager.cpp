@@ -0,0 +1,225 @@
+#include "materialmanager.hpp"
+
+MaterialManager::~MaterialManager()
+{
+	if(!this->materials.empty())
+	{
+		std::cout << "Not all materials have been manually deleted. " 
+					 "Automatically deleting:" << std::endl;
+		for(const auto &[materialName,material] : this->materials)
+			std::cout << '\t' << materialName << std::endl;
+		
+		DeleteAllMaterials();
+	}
+}
+
+// Reads the offsets of all block members from the program, so no lookups by name are needed while rendering
+void MaterialManager::CreateMaterialLayout(const MaterialLayoutInfo &layoutInfo)
+{
+	const u32 variableInterface = layoutInfo.interface == GL_SHADER_STORAGE_BLOCK ? GL_BUFFER_VARIABLE : GL_UNIFORM;
+
+	const u32 blockIndex = glGetProgramResourceIndex(layoutInfo.programID,layoutInfo.interface,layoutInfo.blockName.c_str());
+	if(blockIndex == GL_INVALID_INDEX)
+	{
+		std::cout << "Block \"" << layoutInfo.blockName << "\" can't be found in the shader program used by layout \"" 
+				  << layoutInfo.name << "\"!" << std::endl;
+		exit(-1);
+	}
+
+	const std::array<u32,3> blockProperties = {GL_BUFFER_BINDING,GL_BUFFER_DATA_SIZE,GL_NUM_ACTIVE_VARIABLES};
+	std::array<i32,3> blockValues;
+	glGetProgramResourceiv(layoutInfo.programID,layoutInfo.interface,blockIndex,blockProperties.size(),blockProperties.data(),
+						   blockValues.size(),nullptr,blockValues.data());
+
+	MaterialLayout layout;
+	layout.bufferTarget = layoutInfo.interface == GL_SHADER_STORAGE_BLOCK ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER;
+	layout.binding 		= blockValues[0];
+	layout.blockSize 	= blockValues[1];
+
+	std::vector<i32> variableIndices(blockValues[2]);
+	const u32 activeVariables = GL_ACTIVE_VARIABLES;
+	glGetProgramResourceiv(layoutInfo.programID,layoutInfo.interface,blockIndex,1,&activeVariables,
+						   variableIndices.size(),nullptr,variableIndices.data());
+
+	const std::array<u32,6> variableProperties = {GL_NAME_LENGTH,GL_TYPE,GL_OFFSET,GL_ARRAY_SIZE,GL_ARRAY_STRIDE,GL_MATRIX_STRIDE};
+	for(const i32 variableIndex : variableIndices)
+	{
+		std::array<i32,6> values;
+		glGetProgramResourceiv(layoutInfo.programID,variableInterface,variableIndex,variableProperties.size(),variableProperties.data(),
+							   values.size(),nullptr,values.data());
+		
+		MaterialParameter parameter;
+		parameter.name.resize(values[0]);
+		glGetProgramResourceName(layoutInfo.programID,variableInterface,variableIndex,values[0],nullptr,parameter.name.data());
+		parameter.name.resize(values[0] - 1); // drop '\0' 
+
+		parameter.type 	 = values[1];
+		parameter.offset = values[2];
+
+		// arrays of matrices are set as one sequence of columns, which requires the matrices to follow each other
+		const u32 arraySize   = values[3];
+		const u32 arrayStride = values[4];
+		const u32 columns 	  = MatrixColumns(parameter.type);
+		parameter.numberOfElements = arraySize*columns;
+		parameter.elementSize 	   = ElementSize(parameter.type);
+		parameter.elementStride    = columns > 1 ? values[5] : (arrayStride > 0 ? arrayStride : parameter.elementSize);
+
+		if(parameter.elementSize == 0 || parameter.numberOfElements == 0 || (columns > 1 && arraySize > 1 && arrayStride != columns*values[5]))
+		{
+			std::cout << "Block member \"" << parameter.name << "\" of layout \"" << layoutInfo.name 
+					  << "\" has an unsupported type!" << std::endl;
+			exit(-1);
+		}
+		parameter.size = (parameter.numberOfElements - 1)*parameter.elementStride + parameter.elementSize;
+
+		layout.parameters.push_back(parameter);
+	}
+
+	// parameters are kept in memory order, so neighbouring writes extend the same dirty range
+	std::sort(layout.parameters.begin(),layout.parameters.end(),[](const MaterialParameter &a,const MaterialParameter &b){
+		return a.offset < b.offset;
+	});
+
+	this->layouts.insert_or_assign(layoutInfo.name,layout);
+}
+
+void MaterialManager::CreateMaterial(const MaterialInfo &materialInfo)
+{
+	const auto layout = this->layouts.find(materialInfo.layoutName);
+	if(layout == this->layouts.end())
+	{
+		std::cout << "Material layout \"" << materialInfo.layoutName << "\" required by material \"" 
+				  << materialInfo.name << "\" has not been created!" << std::endl;
+		exit(-1);
+	}
+
+	Material material;
+	material.layout 	= &layout->second;
+	material.block.resize(layout->second.blockSize,0);
+	material.dirtyBegin = layout->second.blockSize;
+	material.dirtyEnd   = 0;
+
+	glGenBuffers(1,&material.bufferID);
+	glBindBuffer(layout->second.bufferTarget,material.bufferID);
+	glBufferData(layout->second.bufferTarget,material.block.size(),material.block.data(),GL_DYNAMIC_DRAW);
+
+	this->materials.insert(std::make_pair(materialInfo.name,material));
+}
+
+// Meant for load time, the returned reference stays valid until the material is deleted
+Material &MaterialManager::GetMaterial(const std::string &materialName)
+{
+	const auto material = this->materials.find(materialName);
+	if(material == this->materials.end())
+	{
+		std::cout << "Material \"" << materialName << "\" has not been created!" << std::endl;
+		exit(-1);
+	}
+
+	return material->second;
+}
+
+u32 MaterialManager::GetParameterIndex(const std::string &layoutName,const std::string &parameterName)
+{
+	const auto layout = this->layouts.find(layoutName);
+	if(layout == this->layouts.end())
+	{
+		std::cout << "Material layout \"" << layoutName << "\" has not been created!" << std::endl;
+		exit(-1);
+	}
+	const std::vector<MaterialParameter> &parameters = layout->second.parameters;
+
+	for(u32 i = 0;i < parameters.size();i++)
+		if(parameters[i].name == parameterName)
+			return i;
+
+	std::cout << "Parameter \"" << parameterName << "\" can't be found in the material layout \"" 
+			  << layoutName << "\"!" << std::endl;
+	exit(-1);
+}
+
+// Writes the bytes changed since the last upload with a single call
+void Material::Upload()
+{
+	if(this->dirtyBegin >= this->dirtyEnd)
+		return;
+
+	glBindBuffer(this->layout->bufferTarget,this->bufferID);
+	glBufferSubData(this->layout->bufferTarget,this->dirtyBegin,this->dirtyEnd - this->dirtyBegin,
+					this->block.data() + this->dirtyBegin);
+
+	this->dirtyBegin = this->layout->blockSize;
+	this->dirtyEnd   = 0;
+}
+
+// Same as Upload, but the changed bytes are copied into the command buffer and written when it is replayed
+void Material::RecordUpload(CommandBuffer &commandBuffer)
+{
+	if(this->dirtyBegin >= this->dirtyEnd)
+		return;
+
+	commandBuffer.UpdateBuffer(this->layout->bufferTarget,this->bufferID,this->dirtyBegin,this->dirtyEnd - this->dirtyBegin,
+							   this->block.data() + this->dirtyBegin);
+
+	this->dirtyBegin = this->layout->blockSize;
+	this->dirtyEnd   = 0;
+}
+
+void MaterialManager::DeleteMaterial(const std::string &materialName)
+{
+	const auto material = this->materials.find(materialName);
+	if(material == this->materials.end())
+	{
+		std::cout << "Material \"" << materialName << "\" can't be deleted, it has not been created!" << std::endl;
+		return;
+	}
+	glDeleteBuffers(1,&material->second.bufferID);
+
+	this->materials.erase(material);
+}
+
+void MaterialManager::DeleteAllMaterials()
+{
+	std::vector<u32> sequentialBuffers;
+	sequentialBuffers.reserve(this->materials.size());
+
+	for(const auto &[materialName,material] : this->materials)
+		sequentialBuffers.push_back(material.bufferID);
+	this->materials.clear();
+
+	glDeleteBuffers(sequentialBuffers.size(),sequentialBuffers.data());
+}
+
+// Size of a scalar or vector, or of a single matrix column, as passed to Material::Set (glm layout). 0 if the type isn't supported
+u32 MaterialManager::ElementSize(u32 type)
+{
+	switch(type)
+	{
+		case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT: case GL_BOOL:
+			return 4;
+		case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_FLOAT_MAT2:
+			return 8;
+		case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_FLOAT_MAT3:
+			return 12;
+		case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_FLOAT_MAT4:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+// Matrices are stored as columns which are GL_MATRIX_STRIDE bytes apart, other types count as a single column
+u32 MaterialManager::MatrixColumns(u32 type)
+{
+	switch(type)
+	{
+		case GL_FLOAT_MAT2:
+			return 2;
+		case GL_FLOAT_MAT3:
+			return 3;
+		case GL_FLOAT_MAT4:
+			return 4;
+		default:
+			return 1;
+	}
+}
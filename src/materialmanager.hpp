@@ -0,0 +1,130 @@
+#pragma once
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <array>
+
+#include <GLEW/glew.h>
+#include <glm/glm.hpp>
+
+#include "types.hpp"
+#include "commandbuffer.hpp"
+
+// Contains information for reflection of a uniform/shader storage block into a material layout
+struct MaterialLayoutInfo
+{
+	std::string name;		// name used to reference the created layout
+	u32 		programID;	// shader program containing the block
+	std::string blockName;	// name of the block in the shader source
+	u32 		interface;	// GL_UNIFORM_BLOCK or GL_SHADER_STORAGE_BLOCK
+};
+
+// Position of a single block member inside the CPU-side parameter block. The value passed to Material::Set is
+// a sequence of tightly packed elements (array elements, matrix columns or both), the block may space them further
+// apart, e.g. the columns of a std140 mat3 or the elements of a std140 float array are 16 bytes apart
+struct MaterialParameter
+{
+	std::string name;			  // name of the member as reported by the program
+	u32 		type;			  // GLSL type of the member (GL_FLOAT_MAT4, ...)
+	u32 		offset; 		  // byte offset of the member inside the block
+	u32 		size;			  // number of bytes spanned by the member in the block (whole array for arrays)
+	u32 		numberOfElements; // array elements times matrix columns
+	u32 		elementSize;	  // bytes of a single element in the value
+	u32 		elementStride;	  // distance between consecutive elements in the block
+};
+
+// Layout of a block obtained through program reflection, shared by every material created from it
+struct MaterialLayout
+{
+	u32 							 bufferTarget;	// GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+	u32 							 binding;		// binding point specified in the shader (layout(binding = ...))
+	u32 							 blockSize;		// size of the whole block in bytes
+	std::vector<MaterialParameter> 	 parameters;
+};
+
+// Contains information for creation of a material
+struct MaterialInfo
+{
+	std::string name;		// name used to reference the created material
+	std::string layoutName;	// layout the parameter block is created from
+};
+
+// CPU-side copy of a block, only the bytes changed since the last upload are written to the buffer
+struct Material
+{
+	const MaterialLayout *layout;
+	std::vector<u8> 	  block;		// CPU-side copy of the block contents
+	u32 				  bufferID; 	// buffer backing the block on the GPU
+	u32 				  dirtyBegin;	// first byte changed since the last upload
+	u32 				  dirtyEnd;		// one past the last byte changed since the last upload
+
+	// Copies the value into the block if it differs from the current one, parameterIndex is obtained
+	// through MaterialManager::GetParameterIndex when the material is loaded 
+	template<typename T>
+	void Set(u32 parameterIndex,const T &value)
+	{
+		const MaterialParameter &parameter = this->layout->parameters[parameterIndex];
+		if(sizeof(T) != parameter.numberOfElements*parameter.elementSize)
+		{
+			std::cout << "Value of " << sizeof(T) << " bytes can't be assigned to material parameter \"" 
+					  << parameter.name << "\" of " << parameter.numberOfElements*parameter.elementSize << " bytes!" << std::endl;
+			exit(-1);
+		}
+
+		u8 		 *destination = this->block.data() + parameter.offset;
+		const u8 *source 	  = reinterpret_cast<const u8*>(&value);
+		bool 	  changed 	  = false;
+		if(parameter.elementStride == parameter.elementSize) // packed the same way in the block, copied at once
+		{
+			changed = std::memcmp(destination,source,sizeof(T)) != 0;
+			if(changed)
+				std::memcpy(destination,source,sizeof(T));
+		}
+		else
+		{
+			for(u32 i = 0;i < parameter.numberOfElements;i++)
+			{
+				u8 		 *element 		= destination + i*parameter.elementStride;
+				const u8 *elementSource = source + i*parameter.elementSize;
+				if(std::memcmp(element,elementSource,parameter.elementSize) == 0)
+					continue;
+
+				std::memcpy(element,elementSource,parameter.elementSize);
+				changed = true;
+			}
+		}
+		if(!changed)
+			return;
+
+		this->dirtyBegin = std::min(this->dirtyBegin,parameter.offset);
+		this->dirtyEnd   = std::max(this->dirtyEnd,parameter.offset + parameter.size);
+	}
+
+	void Upload();
+	void RecordUpload(CommandBuffer &commandBuffer);
+};
+
+// Manages materials whose parameter blocks are laid out through program reflection
+struct MaterialManager
+{
+	std::unordered_map<std::string,MaterialLayout> layouts;
+	std::unordered_map<std::string,Material> 	   materials;
+
+	~MaterialManager();
+
+	void CreateMaterialLayout(const MaterialLayoutInfo &layoutInfo);
+	void CreateMaterial(const MaterialInfo &materialInfo);
+
+	Material &GetMaterial(const std::string &materialName);
+	u32 	  GetParameterIndex(const std::string &layoutName,const std::string &parameterName);
+
+	void DeleteMaterial(const std::string &materialName);
+	void DeleteAllMaterials();
+
+	static u32 ElementSize(u32 type);
+	static u32 MatrixColumns(u32 type);
+};
@@ -6,40 +6,82 @@ ModelManager::~ModelManager()
 	{
 		std::cout << "Not all models have been manually deleted. " 
 					 "Automatically deleting:" << std::endl;
-		for(const auto &[modelName,model] : this->models)
-			std::cout << '\t' << modelName << std::endl;
+		for(const Model &model : this->models)
+			std::cout << '\t' << this->modelNames.Name(model.name) << std::endl;
 		
 		DeleteAllModels();
 	}
 }
 
-// Only handles triangulized meshes 
-void ModelManager::LoadModel(const ModelInfo &modelInfo)
+// Only handles triangulized meshes. Returns a null handle if the file couldn't be opened or parsed
+ModelHandle ModelManager::LoadModel(const ModelInfo &modelInfo)
 {
-	std::ifstream modelFile(modelInfo.pathToModel,std::ios::in);
-    
-    if(!modelFile.is_open())
-    {
-        std::cout << "Model file at location: \"" << modelInfo.pathToModel
-				  << "\" could not be opened!" << std::endl;
-        exit(-1);
-    }
-
-	Model model;
+	if(!this->modelNames.Find(modelInfo.modelName).IsNull())
+	{
+		std::cout << "Model \"" << modelInfo.modelName << "\" has already been loaded!" << std::endl;
+		exit(-1);
+	}
+
+	const FileData modelFile = this->fileReader ? this->fileReader->Read(modelInfo.pathToModel) : FileReader::ReadFile(modelInfo.pathToModel);
+	ModelData modelData;
+	if(!modelFile.loaded || !ParseModel(modelInfo,modelFile.Text(),modelData))
+		return ModelHandle{};
+
+	return AddModel(modelInfo.modelName,std::move(modelData));
+}
+
+// The file is read through the file reader (if set, otherwise in a job), parsing, LOD generation and the
+// BVH build run in a job, the upload on the main thread. Failures (including a name which is already used)
+// are reported and result in a null handle
+Task<ModelHandle> ModelManager::LoadModelAsync(ModelInfo modelInfo)
+{
+	FileData modelFile;
+	if(this->fileReader)
+		modelFile = std::move(co_await this->fileReader->ReadAsync(modelInfo.pathToModel)); // resumes in a job
+	else
+	{
+		co_await ResumeOnWorker{*this->jobSystem};
+		modelFile = FileReader::ReadFile(modelInfo.pathToModel);
+	}
+
+	ModelData modelData;
+	const bool parsed = modelFile.loaded && ParseModel(modelInfo,modelFile.Text(),modelData);
+
+	co_await ResumeOnMainThread{*this->jobSystem};
+	if(!parsed)
+		co_return ModelHandle{};
+	if(!this->modelNames.Find(modelInfo.modelName).IsNull())
+	{
+		std::cout << "Model \"" << modelInfo.modelName << "\" has already been loaded!" << std::endl;
+		co_return ModelHandle{};
+	}
+
+	co_return AddModel(modelInfo.modelName,std::move(modelData));
+}
+
+// Doesn't touch GL or the manager's containers, so it can run on any thread
+bool ModelManager::ParseModel(const ModelInfo &modelInfo,std::string_view source,ModelData &modelData) const
+{
+	PROFILE_SCOPE("ModelManager::ParseModel");
+	Model 				  &model = modelData.model;
 	std::vector<glm::vec3> vertices; 			// describes only vertex coordinates
 	std::vector<glm::vec2> textureCoords;		// describes only vertex texture coordinates
 	std::vector<glm::vec3> normals; 			// describes only vertex normals
-	std::vector<f32>       vertexComponent; 	// contains complete description of vertices
+	std::vector<f32>      &vertexComponent = modelData.vertexComponent; // contains complete description of vertices
+	std::vector<u32> 	  &indices = modelData.indices; 				  // 3 indices into vertexComponent per face
+	std::unordered_map<std::string,u32> uniqueVertices; // face vertex record (e.g. "3/1/2") -> index of the vertex it produced
 	u32 				   lineNumber = 1;  	// keeps track of the line number in the parsed file for error reporting
 	bool				   firstTime = true;
 	
 	try
 	{
-		for(std::string line;std::getline(modelFile,line);lineNumber++)
+		for(;!source.empty();lineNumber++)
 		{
-			std::string_view inputLine = line;
+			const u64 		 lineEnd   = source.find('\n');
+			std::string_view inputLine = source.substr(0,lineEnd);
+			source.remove_prefix(lineEnd == std::string_view::npos ? source.size() : lineEnd + 1);
 
-			if(inputLine.length() == 0 || line.starts_with('#')) // line is empty or is a comment
+			if(inputLine.length() == 0 || inputLine.starts_with('#')) // line is empty or is a comment
 				continue;
 			else if(inputLine.starts_with("vt")) 	// texture coordinate record found
 			{
@@ -112,6 +154,12 @@ void ModelManager::LoadModel(const ModelInfo &modelInfo)
 				{
 					auto faceVertex = inputLine.substr(delimiters[i],delimiters[i + 1] - delimiters[i] - 1);
 
+					// a combination of position, texture coordinate and normal already used by another face is shared
+					const auto [uniqueVertex,inserted] = uniqueVertices.try_emplace(std::string(faceVertex),model.numberOfVertices);
+					indices.push_back(uniqueVertex->second);
+					if(!inserted)
+						continue;
+
 					switch(model.structure)
 					{
 						case VERTICES_ONLY: 							// structure: v_x v_y v_z
@@ -175,114 +223,372 @@ void ModelManager::LoadModel(const ModelInfo &modelInfo)
 	{
 		std::cout << "Error occured while parsing the file \"" << modelInfo.pathToModel << "\" on line " << lineNumber << ":\n"
 				  << e.what() << '\n';
-		return;
+		return false;
 	}
 
-	model.numberOfVertices *= 3; // each face is composed of 3 vertices
+	model.numberOfIndices = indices.size();
 
-	glGenVertexArrays(1,&model.vertexArrayID);
-	glGenBuffers(1,&model.vertexBufferID);
+	// positions are the first 3 floats of every vertex
+	const u32 vertexSize = vertexComponent.size()/std::max(model.numberOfVertices,1u);
+	std::vector<glm::vec3> positions;
+	if(modelInfo.buildBVH || modelInfo.numberOfLODs > 1)
+	{
+		positions.resize(model.numberOfVertices);
+		for(u32 i = 0;i < model.numberOfVertices;i++)
+			positions[i] = glm::vec3(vertexComponent[i*vertexSize],vertexComponent[i*vertexSize + 1],vertexComponent[i*vertexSize + 2]);
+	}
 
-	glBindVertexArray(model.vertexArrayID);
-	glBindBuffer(GL_ARRAY_BUFFER,model.vertexBufferID);
+	modelData.hasBVH = modelInfo.buildBVH;
+	if(modelInfo.buildBVH)
+		modelData.meshBVH.Build(positions,indices,this->jobSystem);
 
-	glBufferData(GL_ARRAY_BUFFER,vertexComponent.size()*sizeof(f32),vertexComponent.data(),GL_STATIC_DRAW);
+	// every LOD is simplified from the previous one, its indices are appended after the previous LOD's indices.
+	// The chain ends early once a simplification can't remove at least a tenth of the triangles
+	model.lods[0] = ModelLOD{.firstIndex = 0,.numberOfIndices = model.numberOfIndices,.error = 0.f};
+	std::vector<u32> lodIndices;
+	for(u32 lod = 1;lod < std::min(modelInfo.numberOfLODs,Model::maxLODs);lod++)
+	{
+		const ModelLOD &previous = model.lods[lod - 1];
+		lodIndices.assign(indices.begin() + previous.firstIndex,indices.begin() + previous.firstIndex + previous.numberOfIndices);
+		if(lod == 1)
+			MeshSimplifier::WeldIdenticalVertices(vertexComponent,vertexSize,lodIndices);
+
+		const f32 error = MeshSimplifier::Simplify(positions,lodIndices,previous.numberOfIndices/6*3);
+		if(10*lodIndices.size() > 9*previous.numberOfIndices)
+			break;
 
-	switch(model.structure)
+		model.lods[lod] = ModelLOD{
+			.firstIndex 	 = static_cast<u32>(indices.size()),
+			.numberOfIndices = static_cast<u32>(lodIndices.size()),
+			.error 			 = previous.error + error // errors of the simplification steps can add up
+		};
+		indices.insert(indices.end(),lodIndices.begin(),lodIndices.end());
+		model.numberOfLODs = lod + 1;
+	}
+
+	if(!vertices.empty())
+	{
+		model.boundsMin = model.boundsMax = vertices.front();
+		for(const glm::vec3 &vertex : vertices)
+		{
+			model.boundsMin = glm::min(model.boundsMin,vertex);
+			model.boundsMax = glm::max(model.boundsMax,vertex);
+		}
+	}
+
+	return true;
+}
+
+// Copies the parsed geometry into the arena of its structure, GL thread only
+ModelHandle ModelManager::AddModel(const std::string &modelName,ModelData &&modelData)
+{
+	PROFILE_SCOPE("ModelManager::AddModel");
+	Model 				   &model 			= modelData.model;
+	const std::vector<f32> &vertexComponent = modelData.vertexComponent;
+	const std::vector<u32> &indices 		= modelData.indices;
+	if(modelData.hasBVH)
+		model.meshBVH = this->meshBVHs.Insert(std::move(modelData.meshBVH));
+
+	GeometryArena &arena = GetArena(model.structure);
+
+	model.baseVertex = AllocateRange(arena.freeVertices,model.numberOfVertices);
+	model.firstIndex = AllocateRange(arena.freeIndices,indices.size());
+	if(model.baseVertex == ~0u || model.firstIndex == ~0u) // arena is full, it is grown and the allocation retried
+	{
+		if(model.baseVertex != ~0u)
+			FreeRange(arena.freeVertices,model.baseVertex,model.numberOfVertices);
+		if(model.firstIndex != ~0u)
+			FreeRange(arena.freeIndices,model.firstIndex,indices.size());
+
+		GrowArena(arena,model.numberOfVertices,indices.size());
+
+		model.baseVertex = AllocateRange(arena.freeVertices,model.numberOfVertices);
+		model.firstIndex = AllocateRange(arena.freeIndices,indices.size());
+	}
+	model.vertexArrayID = arena.vertexArrayID;
+	for(u32 lod = 0;lod < model.numberOfLODs;lod++)
+		model.lods[lod].firstIndex += model.firstIndex;
+
+	// copy write target is used, so the element array binding of the currently bound vertex array isn't changed
+	glBindBuffer(GL_COPY_WRITE_BUFFER,arena.vertexBufferID);
+	glBufferSubData(GL_COPY_WRITE_BUFFER,static_cast<u64>(model.baseVertex)*arena.vertexStride,vertexComponent.size()*sizeof(f32),vertexComponent.data());
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER,arena.indexBufferID);
+	glBufferSubData(GL_COPY_WRITE_BUFFER,static_cast<u64>(model.firstIndex)*sizeof(u32),indices.size()*sizeof(u32),indices.data());
+
+	const ModelHandle handle = this->models.Insert(model);
+	this->models[handle].name = this->modelNames.Assign(modelName,handle);
+
+	return handle;
+}
+
+// Meant for load time, unknown names are reported instead of creating an empty model
+ModelHandle ModelManager::GetModel(const std::string &modelName) const
+{
+	const ModelHandle model = this->modelNames.Find(modelName);
+	if(model.IsNull())
+	{
+		std::cout << "Model \"" << modelName << "\" hasn't been loaded!" << std::endl;
+		exit(-1);
+	}
+
+	return model;
+}
+
+// Returns the arena storing models of the given structure, creating its buffers and vertex array on first use
+GeometryArena &ModelManager::GetArena(ModelStructure structure)
+{
+	GeometryArena &arena = this->arenas[structure];
+	if(arena.vertexArrayID != 0)
+		return arena;
+
+	if(this->defaultInstanceBufferID == 0)
+	{
+		const InstanceData identity = {
+			.transform = glm::mat4(1.f),
+			.color 	   = glm::vec4(1.f)
+		};
+		glGenBuffers(1,&this->defaultInstanceBufferID);
+		glBindBuffer(GL_COPY_WRITE_BUFFER,this->defaultInstanceBufferID);
+		glBufferData(GL_COPY_WRITE_BUFFER,sizeof(InstanceData),&identity,GL_STATIC_DRAW);
+	}
+
+	const std::array<u32,4> vertexSizes = {3,6,5,8}; // floats per vertex of each structure
+	arena.vertexStride = vertexSizes[structure]*sizeof(f32);
+
+	glGenVertexArrays(1,&arena.vertexArrayID);
+	BindVertexArray(arena.vertexArrayID);
+
+	// vertex attributes are read from binding 0 (arena vertex buffer)
+	switch(structure)
 	{
 		case VERTICES_ONLY:
 			// vertex position
-			glVertexAttribPointer(0,3,GL_FLOAT,false,3*sizeof(f32),reinterpret_cast<void*>(0));
+			glVertexAttribFormat(0,3,GL_FLOAT,false,0);
+			glVertexAttribBinding(0,0);
 			glEnableVertexAttribArray(0);
-			break;	
+			break;
 
 		case VERTICES_AND_NORMALS:
 			// vertex position
-			glVertexAttribPointer(0,3,GL_FLOAT,false,6*sizeof(f32),reinterpret_cast<void*>(0));
+			glVertexAttribFormat(0,3,GL_FLOAT,false,0);
+			glVertexAttribBinding(0,0);
 			glEnableVertexAttribArray(0);
 
 			// vertex normal
-			glVertexAttribPointer(1,3,GL_FLOAT,false,6*sizeof(f32),reinterpret_cast<void*>(3*sizeof(f32)));
+			glVertexAttribFormat(1,3,GL_FLOAT,false,3*sizeof(f32));
+			glVertexAttribBinding(1,0);
 			glEnableVertexAttribArray(1);
 			break;
 
 		case VERTICES_AND_TEXTURE_COORDINATES:
 			// vertex position
-			glVertexAttribPointer(0,3,GL_FLOAT,false,5*sizeof(f32),reinterpret_cast<void*>(0));
+			glVertexAttribFormat(0,3,GL_FLOAT,false,0);
+			glVertexAttribBinding(0,0);
 			glEnableVertexAttribArray(0);
 
 			// texture coordinate
-			glVertexAttribPointer(1,2,GL_FLOAT,false,5*sizeof(f32),reinterpret_cast<void*>(3*sizeof(f32)));
+			glVertexAttribFormat(1,2,GL_FLOAT,false,3*sizeof(f32));
+			glVertexAttribBinding(1,0);
 			glEnableVertexAttribArray(1);
 			break;
 
 		case VERTICES_TEXTURE_COORDINATES_AND_NORMALS:
 			// vertex posiiotn
-			glVertexAttribPointer(0,3,GL_FLOAT,false,8*sizeof(f32),reinterpret_cast<void*>(0));
+			glVertexAttribFormat(0,3,GL_FLOAT,false,0);
+			glVertexAttribBinding(0,0);
 			glEnableVertexAttribArray(0);
 
 			// texture coordinate
-			glVertexAttribPointer(1,2,GL_FLOAT,false,8*sizeof(f32),reinterpret_cast<void*>(3*sizeof(f32)));
+			glVertexAttribFormat(1,2,GL_FLOAT,false,3*sizeof(f32));
+			glVertexAttribBinding(1,0);
 			glEnableVertexAttribArray(1);
 
 			// vertex normal
-			glVertexAttribPointer(2,3,GL_FLOAT,false,8*sizeof(f32),reinterpret_cast<void*>(5*sizeof(f32)));
+			glVertexAttribFormat(2,3,GL_FLOAT,false,5*sizeof(f32));
+			glVertexAttribBinding(2,0);
 			glEnableVertexAttribArray(2);
 	}
 
-	this->models.insert(std::make_pair(modelInfo.modelName,model));
+	// instance attributes are read from binding 1, a mat4 attribute occupies 4 consecutive locations (one per column)
+	for(u32 column = 0;column < 4;column++)
+	{
+		glVertexAttribFormat(3 + column,4,GL_FLOAT,false,offsetof(InstanceData,transform) + column*sizeof(glm::vec4));
+		glVertexAttribBinding(3 + column,1);
+		glEnableVertexAttribArray(3 + column);
+	}
+	glVertexAttribFormat(7,4,GL_FLOAT,false,offsetof(InstanceData,color));
+	glVertexAttribBinding(7,1);
+	glEnableVertexAttribArray(7);
+
+	glVertexBindingDivisor(1,1);
+	glBindVertexBuffer(1,this->defaultInstanceBufferID,0,sizeof(InstanceData));
+
+	GrowArena(arena,initialArenaVertices,3*initialArenaVertices);
+
+	return arena;
 }
 
-void ModelManager::DeleteModel(const std::string &modelName)
+// Reallocates the arena buffers with at least the requested amount of extra space, existing
+// geometry is copied on the GPU, so models keep their offsets
+void ModelManager::GrowArena(GeometryArena &arena,u32 minimumVertices,u32 minimumIndices)
 {
-	const Model model = this->models[modelName];
-	this->models.erase(modelName);
+	const u32 vertexCapacity = std::max(2*arena.vertexCapacity,arena.vertexCapacity + minimumVertices);
+	const u32 indexCapacity  = std::max(2*arena.indexCapacity,arena.indexCapacity + minimumIndices);
+
+	std::array<u32,2> buffers;
+	glGenBuffers(buffers.size(),buffers.data());
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER,buffers[0]);
+	glBufferData(GL_COPY_WRITE_BUFFER,static_cast<u64>(vertexCapacity)*arena.vertexStride,nullptr,GL_STATIC_DRAW);
+	if(arena.vertexBufferID != 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER,arena.vertexBufferID);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,0,0,static_cast<u64>(arena.vertexCapacity)*arena.vertexStride);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER,buffers[1]);
+	glBufferData(GL_COPY_WRITE_BUFFER,static_cast<u64>(indexCapacity)*sizeof(u32),nullptr,GL_STATIC_DRAW);
+	if(arena.indexBufferID != 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER,arena.indexBufferID);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,0,0,static_cast<u64>(arena.indexCapacity)*sizeof(u32));
+	}
+
+	const std::array<u32,2> oldBuffers = {arena.vertexBufferID,arena.indexBufferID};
+	DeleteBuffers(oldBuffers.data(),oldBuffers.size());
+
+	FreeRange(arena.freeVertices,arena.vertexCapacity,vertexCapacity - arena.vertexCapacity);
+	FreeRange(arena.freeIndices,arena.indexCapacity,indexCapacity - arena.indexCapacity);
+
+	arena.vertexBufferID = buffers[0];
+	arena.indexBufferID  = buffers[1];
+	arena.vertexCapacity = vertexCapacity;
+	arena.indexCapacity  = indexCapacity;
 
-	glDeleteBuffers(1,&model.vertexBufferID);
-	glDeleteVertexArrays(1,&model.vertexArrayID);
+	BindVertexArray(arena.vertexArrayID);
+	glBindVertexBuffer(0,arena.vertexBufferID,0,arena.vertexStride);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,arena.indexBufferID);
+	BindVertexArray(0);
 }
 
-void ModelManager::DeleteSelectedModels(const std::vector<std::string> &modelNames)
+// Buffers are deleted at runtime (released models, grown arenas), so their names can come back while the cache is in use
+void ModelManager::DeleteBuffers(const u32 *bufferIDs,u32 count)
 {
-	const u32 numberOfModels = modelNames.size();
+	glDeleteBuffers(count,bufferIDs);
+	if(this->glState)
+		for(u32 i = 0;i < count;i++)
+			this->glState->OnDelete(GL_BUFFER,bufferIDs[i]);
+}
 
-	std::vector<u32> sequentialVertexBuffers;
-	std::vector<u32> sequentialVertexArrays;
-	sequentialVertexBuffers.resize(numberOfModels);
-	sequentialVertexArrays.resize(numberOfModels);
+// Arenas can be created and grown while frames are drawn (asynchronous loads), the cache has to see those binds
+void ModelManager::BindVertexArray(u32 vertexArrayID)
+{
+	if(this->glState)
+		this->glState->BindVertexArray(vertexArrayID);
+	else
+		glBindVertexArray(vertexArrayID);
+}
 
-	for(u32 i = 0;i < numberOfModels;i++)
-	{
-		const Model model = this->models[modelNames[i]];
-		this->models.erase(modelNames[i]);
+// First fit allocation, returns ~0u if no free range is large enough
+u32 ModelManager::AllocateRange(std::vector<GeometryRange> &freeRanges,u32 size)
+{
+	for(auto range = freeRanges.begin();range != freeRanges.end();range++)
+		if(range->size >= size)
+		{
+			const u32 offset = range->offset;
+			range->offset += size;
+			range->size   -= size;
+			if(range->size == 0)
+				freeRanges.erase(range);
 
-		sequentialVertexBuffers[i] = model.vertexBufferID;
-		sequentialVertexArrays[i]  = model.vertexArrayID;
+			return offset;
+		}
+
+	return ~0u;
+}
+
+// Returns the range to the free list, merging it with adjacent free ranges
+void ModelManager::FreeRange(std::vector<GeometryRange> &freeRanges,u32 offset,u32 size)
+{
+	if(size == 0)
+		return;
+
+	auto range = std::lower_bound(freeRanges.begin(),freeRanges.end(),offset,[](const GeometryRange &range,u32 offset){
+		return range.offset < offset;
+	});
+	range = freeRanges.insert(range,GeometryRange{.offset = offset,.size = size});
+
+	if(range + 1 != freeRanges.end() && range->offset + range->size == (range + 1)->offset)
+	{
+		range->size += (range + 1)->size;
+		freeRanges.erase(range + 1);
+	}
+	if(range != freeRanges.begin() && (range - 1)->offset + (range - 1)->size == range->offset)
+	{
+		(range - 1)->size += range->size;
+		freeRanges.erase(range);
 	}
+}
+
+void ModelManager::ReleaseModelGeometry(const Model &model)
+{
+	GeometryArena &arena = this->arenas[model.structure];
+	FreeRange(arena.freeVertices,model.baseVertex,model.numberOfVertices);
+	for(u32 lod = 0;lod < model.numberOfLODs;lod++)
+		FreeRange(arena.freeIndices,model.lods[lod].firstIndex,model.lods[lod].numberOfIndices);
+}
+
+void ModelManager::DeleteModel(ModelHandle modelHandle)
+{
+	const Model model = this->models[modelHandle];
+	this->models.Erase(modelHandle);
+	this->meshBVHs.Erase(model.meshBVH);
+	this->modelNames.Remove(model.name);
 
-	glDeleteBuffers(numberOfModels,sequentialVertexBuffers.data());
-	glDeleteVertexArrays(numberOfModels,sequentialVertexArrays.data());
+	ReleaseModelGeometry(model);
 }
 
+void ModelManager::DeleteSelectedModels(const std::vector<ModelHandle> &models)
+{
+	for(const ModelHandle modelHandle : models)
+	{
+		const Model model = this->models[modelHandle];
+		this->models.Erase(modelHandle);
+		this->meshBVHs.Erase(model.meshBVH);
+		this->modelNames.Remove(model.name);
+
+		ReleaseModelGeometry(model);
+	}
+}
+
+// Also deletes the geometry arenas, since no model is using them anymore
 void ModelManager::DeleteAllModels()
 {
-	const u32 numberOfModels = this->models.size();
+	for(const Model &model : this->models)
+		this->modelNames.Remove(model.name);
+	this->models.Clear();
+	this->meshBVHs.Clear();
 
-	std::vector<u32> sequentialVertexBuffers;
-	std::vector<u32> sequentialVertexArrays;
-	sequentialVertexBuffers.resize(numberOfModels);
-	sequentialVertexArrays.resize(numberOfModels);
+	DeleteArenas();
+}
 
-	u32 i = 0;
-	for(const auto &[modelName,model] : this->models)
+void ModelManager::DeleteArenas()
+{
+	for(GeometryArena &arena : this->arenas)
 	{
-		sequentialVertexBuffers[i] = model.vertexBufferID;
-		sequentialVertexArrays[i]  = model.vertexArrayID;
+		if(arena.vertexArrayID == 0)
+			continue;
+
+		const std::array<u32,2> buffers = {arena.vertexBufferID,arena.indexBufferID};
+		DeleteBuffers(buffers.data(),buffers.size());
+		glDeleteVertexArrays(1,&arena.vertexArrayID);
+		if(this->glState)
+			this->glState->OnDelete(GL_VERTEX_ARRAY,arena.vertexArrayID);
 
-		i++;
+		arena = GeometryArena{};
 	}
-	this->models.clear();
 
-	glDeleteBuffers(numberOfModels,sequentialVertexBuffers.data());
-	glDeleteVertexArrays(numberOfModels,sequentialVertexArrays.data());
+	DeleteBuffers(&this->defaultInstanceBufferID,1);
+	this->defaultInstanceBufferID = 0;
 }
\ No newline at end of file
@@ -8,17 +8,29 @@
 #include <string>
 #include <string_view>
 #include <stdexcept>
+#include <cstddef>
+#include <algorithm>
 
 #include <GLEW/glew.h>
 #include <glm/glm.hpp>
 
 #include "types.hpp"
 #include "misc.hpp"
+#include "bvh.hpp"
+#include "lod.hpp"
+#include "handle.hpp"
+#include "jobsystem.hpp"
+#include "task.hpp"
+#include "filereader.hpp"
+#include "glstate.hpp"
+#include "profiler.hpp"
 
 struct ModelInfo
 {
 	std::string modelName; 		// name used to reference the loaded model data
 	std::string pathToModel;	// path to .obj file containing the model data
+	bool 		buildBVH = false; // builds a triangle BVH for ray queries against the model
+	u32 		numberOfLODs = 1; // LOD 0 is the loaded mesh, every further LOD is simplified to about half of the triangles of the previous one
 };
 
 enum ModelStructure : u32
@@ -29,25 +41,109 @@ enum ModelStructure : u32
 	VERTICES_TEXTURE_COORDINATES_AND_NORMALS	// contains vetices, texture coordinates and normals
 };
 
+// Per-instance attributes, bound to locations 3-6 (transform columns) and 7 (color)
+struct InstanceData
+{
+	glm::mat4 transform;
+	glm::vec4 color;
+};
+
+// Range of the arena index buffer drawn for one level of detail, all LODs of a model share its vertices
+struct ModelLOD
+{
+	u32 firstIndex;
+	u32 numberOfIndices;
+	f32 error; // object space error estimate, see MeshSimplifier::Simplify (RMS distance, not a bound on the largest one)
+};
+
+using MeshBVHHandle = Handle<MeshBVH>;
+
 struct Model
 {
-	ModelStructure structure;			// specifies the the structure of each vertex 
-	u32 		   vertexArrayID;		// name of the OpenGL object required for submitting a draw call 
-	u32 		   vertexBufferID;		// name of the OpenGL object specifying vertex structure
-	u32			   numberOfVertices;	// specifies the number of vertices the model contains
+	static constexpr u32 maxLODs = 8;
+
+	ModelStructure structure;				// specifies the the structure of each vertex 
+	u32 		   vertexArrayID;			// vertex array of the geometry arena the model is stored in (shared by all models of the same structure)
+	u32 		   baseVertex;				// first vertex of the model inside the arena's vertex buffer
+	u32			   numberOfVertices;		// specifies the number of unique vertices the model contains
+	u32 		   firstIndex;				// first index of the model inside the arena's index buffer
+	u32 		   numberOfIndices;			// number of indices drawn, 3 per triangle
+	glm::vec3 	   boundsMin 		  = glm::vec3(0.f); // object space bounding box of the vertex positions
+	glm::vec3 	   boundsMax 		  = glm::vec3(0.f);
+	std::array<ModelLOD,maxLODs> lods = {}; // lods[0] is firstIndex/numberOfIndices, coarser LODs follow it in the index buffer
+	u32 		   numberOfLODs 	  = 1;
+	MeshBVHHandle  meshBVH 			  = {};	 // triangle BVH, null if the model wasn't loaded with buildBVH
+	u32 		   name 			  = ~0u; // id in ModelManager::modelNames
 };
 
-// Manages the model (mesh) data loaded from .obj files
+using ModelHandle = Handle<Model>;
+
+// Parsed model which hasn't been uploaded yet
+struct ModelData
+{
+	Model 			 model;
+	std::vector<f32> vertexComponent; // interleaved vertices
+	std::vector<u32> indices; 		  // indices of all LODs, relative to the model's first index
+	MeshBVH 		 meshBVH;
+	bool 			 hasBVH = false;
+};
+
+// Free block of a geometry arena buffer, in vertices or indices
+struct GeometryRange
+{
+	u32 offset;
+	u32 size;
+};
+
+// Vertex and index buffers shared by every model with the same vertex structure, models get sub-ranges
+// of the buffers, so they can all be drawn with the same vertex array (and a single multi-draw)
+struct GeometryArena
+{
+	u32 						vertexArrayID  = 0;	// 0 until the first model with this structure is loaded
+	u32 						vertexBufferID = 0;
+	u32 						indexBufferID  = 0;
+	u32 						vertexStride   = 0;	// size of a single vertex in bytes
+	u32 						vertexCapacity = 0;	// size of the vertex buffer in vertices
+	u32 						indexCapacity  = 0;	// size of the index buffer in indices
+	std::vector<GeometryRange>  freeVertices;		// unused vertex ranges, sorted by offset
+	std::vector<GeometryRange>  freeIndices;		// unused index ranges, sorted by offset
+};
+
+// Manages the model (mesh) data loaded from .obj files. Models are referenced by handles, names are only
+// resolved at load time
 struct ModelManager
 {
-	std::unordered_map<std::string,Model> models;
+	static constexpr u32 initialArenaVertices = 1 << 16; // arenas start with room for this many vertices and 3 times as many indices
+
+	SlotMap<Model> 				models;
+	SlotMap<MeshBVH> 			meshBVHs;						// triangle BVHs of the models loaded with buildBVH
+	ResourceNames<Model> 		modelNames;
+	std::array<GeometryArena,4> arenas;							// one arena per ModelStructure
+	u32 						defaultInstanceBufferID = 0;	// single identity instance bound for items which aren't drawn through a DrawBatch
+	JobSystem 				   *jobSystem = nullptr;			// builds large mesh BVHs in parallel when set, required by LoadModelAsync
+	FileReader 				   *fileReader = nullptr;			// reads the files (from mounted archives first) when set
+	GLState 				   *glState = nullptr;				// vertex array binds go through the cache and it's told about deleted objects when set
 
 	~ModelManager();
 	
-	void LoadModel(const ModelInfo &modelInfo);
+	ModelHandle 	  LoadModel(const ModelInfo &modelInfo);
+	Task<ModelHandle> LoadModelAsync(ModelInfo modelInfo);
+	bool 			  ParseModel(const ModelInfo &modelInfo,std::string_view source,ModelData &modelData) const;
+	ModelHandle 	  AddModel(const std::string &modelName,ModelData &&modelData);
+	ModelHandle GetModel(const std::string &modelName) const;
 
-	void DeleteModel(const std::string &modelName);
-	void DeleteSelectedModels(const std::vector<std::string> &modelNames);
+	void DeleteModel(ModelHandle model);
+	void DeleteSelectedModels(const std::vector<ModelHandle> &models);
 	void DeleteAllModels();
+
+	GeometryArena &GetArena(ModelStructure structure);
+	void 		   GrowArena(GeometryArena &arena,u32 minimumVertices,u32 minimumIndices);
+	void 		   DeleteArenas();
+	void 		   ReleaseModelGeometry(const Model &model);
+	void 		   BindVertexArray(u32 vertexArrayID);
+	void 		   DeleteBuffers(const u32 *bufferIDs,u32 count);
+
+	static u32  AllocateRange(std::vector<GeometryRange> &freeRanges,u32 size);
+	static void FreeRange(std::vector<GeometryRange> &freeRanges,u32 offset,u32 size);
 }; 
 
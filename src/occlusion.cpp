@@ -0,0 +1,360 @@
+#include "occlusion.hpp"
+
+#include <cmath>
+#include <bit>
+#include <memory>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+#endif
+
+static constexpr u32 simdWidth = 8;
+
+void OcclusionCuller::Begin(const glm::mat4 &viewProjection)
+{
+	this->viewProjection = viewProjection;
+	this->depthBuffer.assign(width*height + simdWidth,1.f);
+	this->rasterizedTriangles = 0;
+}
+
+// Triangles are 3 consecutive vertices (like MeshBVH::triangles). Triangles reaching behind the near plane
+// are skipped instead of being clipped, which only makes the occluder smaller, never hides a visible object
+void OcclusionCuller::RasterizeOccluder(const std::vector<glm::vec3> &triangles,const glm::mat4 &transform)
+{
+	PROFILE_SCOPE("OcclusionCuller::RasterizeOccluder");
+	const glm::mat4 modelViewProjection = this->viewProjection*transform;
+
+	for(u32 triangle = 0;triangle + 2 < triangles.size();triangle += 3)
+	{
+		std::array<glm::vec3,3> screen;
+		bool behindNearPlane = false;
+		for(u32 vertex = 0;vertex < 3;vertex++)
+		{
+			const glm::vec4 clip = modelViewProjection*glm::vec4(triangles[triangle + vertex],1.f);
+			behindNearPlane |= clip.w < nearClipW;
+
+			const glm::vec3 ndc = glm::vec3(clip)/clip.w;
+			screen[vertex] = glm::vec3((.5f*ndc.x + .5f)*width,(.5f*ndc.y + .5f)*height,ndc.z);
+		}
+
+		if(!behindNearPlane)
+			RasterizeTriangle(screen[0],screen[1],screen[2]);
+	}
+}
+
+// Edge functions are evaluated at pixel centers, 8 pixels of a row at once. Both windings are rasterized
+void OcclusionCuller::RasterizeTriangle(glm::vec3 vertex0,glm::vec3 vertex1,glm::vec3 vertex2)
+{
+	f32 area = (vertex1.x - vertex0.x)*(vertex2.y - vertex0.y) - (vertex1.y - vertex0.y)*(vertex2.x - vertex0.x);
+	if(area == 0.f)
+		return;
+	if(area < 0.f)
+	{
+		std::swap(vertex1,vertex2);
+		area = -area;
+	}
+
+	const i32 minX = std::max(0,static_cast<i32>(std::floor(std::min({vertex0.x,vertex1.x,vertex2.x}))));
+	const i32 maxX = std::min(static_cast<i32>(width) - 1,static_cast<i32>(std::ceil(std::max({vertex0.x,vertex1.x,vertex2.x}))));
+	const i32 minY = std::max(0,static_cast<i32>(std::floor(std::min({vertex0.y,vertex1.y,vertex2.y}))));
+	const i32 maxY = std::min(static_cast<i32>(height) - 1,static_cast<i32>(std::ceil(std::max({vertex0.y,vertex1.y,vertex2.y}))));
+	if(minX > maxX || minY > maxY)
+		return;
+
+	this->rasterizedTriangles++;
+
+	// edge i is opposite to vertex i, e(p) = (b - a) x (p - a) is positive inside, so e(x + 1) = e(x) - (b.y - a.y)
+	const std::array<glm::vec3,3> vertices = {vertex0,vertex1,vertex2};
+	std::array<f32,3> edgeStepX,edgeStepY,edgeStart;
+	for(u32 edge = 0;edge < 3;edge++)
+	{
+		const glm::vec3 &a = vertices[(edge + 1)%3];
+		const glm::vec3 &b = vertices[(edge + 2)%3];
+
+		edgeStepX[edge] = -(b.y - a.y);
+		edgeStepY[edge] = b.x - a.x;
+		edgeStart[edge] = (b.x - a.x)*(minY + .5f - a.y) - (b.y - a.y)*(minX + .5f - a.x);
+	}
+
+	// depth is linear in screen space, z = sum(e_i*z_i)/area
+	const f32 depthStepX = (edgeStepX[0]*vertex0.z + edgeStepX[1]*vertex1.z + edgeStepX[2]*vertex2.z)/area;
+	const f32 depthStepY = (edgeStepY[0]*vertex0.z + edgeStepY[1]*vertex1.z + edgeStepY[2]*vertex2.z)/area;
+	const f32 depthStart = (edgeStart[0]*vertex0.z + edgeStart[1]*vertex1.z + edgeStart[2]*vertex2.z)/area;
+
+	for(i32 y = minY;y <= maxY;y++)
+	{
+		const f32 row = static_cast<f32>(y - minY);
+		f32 *depthRow = this->depthBuffer.data() + y*width;
+
+		i32 x = minX;
+#if defined(__AVX__)
+		const __m256 offsets = _mm256_setr_ps(0.f,1.f,2.f,3.f,4.f,5.f,6.f,7.f);
+		for(;x <= maxX;x += simdWidth)
+		{
+			const __m256 column = _mm256_add_ps(_mm256_set1_ps(static_cast<f32>(x - minX)),offsets);
+
+			__m256 inside = _mm256_cmp_ps(column,_mm256_set1_ps(static_cast<f32>(maxX - minX)),_CMP_LE_OQ);
+			for(u32 edge = 0;edge < 3;edge++)
+			{
+				const __m256 value = _mm256_add_ps(_mm256_set1_ps(edgeStart[edge] + row*edgeStepY[edge]),
+												   _mm256_mul_ps(column,_mm256_set1_ps(edgeStepX[edge])));
+				inside = _mm256_and_ps(inside,_mm256_cmp_ps(value,_mm256_setzero_ps(),_CMP_GE_OQ));
+			}
+			if(_mm256_movemask_ps(inside) == 0)
+				continue;
+
+			const __m256 depth   = _mm256_add_ps(_mm256_set1_ps(depthStart + row*depthStepY),
+												 _mm256_mul_ps(column,_mm256_set1_ps(depthStepX)));
+			const __m256 current = _mm256_loadu_ps(depthRow + x);
+			_mm256_storeu_ps(depthRow + x,_mm256_blendv_ps(current,_mm256_min_ps(current,depth),inside));
+		}
+#else
+		for(;x <= maxX;x++)
+		{
+			const f32 column = static_cast<f32>(x - minX);
+
+			bool inside = true;
+			for(u32 edge = 0;edge < 3;edge++)
+				inside &= edgeStart[edge] + row*edgeStepY[edge] + column*edgeStepX[edge] >= 0.f;
+
+			if(inside)
+				depthRow[x] = std::min(depthRow[x],depthStart + row*depthStepY + column*depthStepX);
+		}
+#endif
+	}
+}
+
+// The pyramid is only read during the frame, so its levels are allocated from the frame resource
+// (the levels inherit the resource of the outer vector)
+void OcclusionCuller::BuildHierarchy(std::pmr::memory_resource *frameResource)
+{
+	PROFILE_SCOPE("OcclusionCuller::BuildHierarchy");
+	std::destroy_at(&this->hierarchy);
+	std::construct_at(&this->hierarchy,frameResource);
+	this->hierarchy.reserve(std::bit_width(std::max(width,height))); // references to the levels stay valid while they're built
+	this->hierarchy.emplace_back(this->depthBuffer.begin(),this->depthBuffer.begin() + width*height);
+
+	for(u32 levelWidth = width,levelHeight = height;levelWidth > 1 || levelHeight > 1;)
+	{
+		const u32 belowWidth  = levelWidth;
+		const u32 belowHeight = levelHeight;
+		levelWidth  = std::max(1u,levelWidth/2);
+		levelHeight = std::max(1u,levelHeight/2);
+
+		std::pmr::vector<f32> &level = this->hierarchy.emplace_back(levelWidth*levelHeight);
+		const std::pmr::vector<f32> &below = this->hierarchy[this->hierarchy.size() - 2];
+		for(u32 y = 0;y < levelHeight;y++)
+			for(u32 x = 0;x < levelWidth;x++)
+			{
+				const u32 x0 = std::min(2*x,belowWidth - 1),x1 = std::min(2*x + 1,belowWidth - 1);
+				const u32 y0 = std::min(2*y,belowHeight - 1),y1 = std::min(2*y + 1,belowHeight - 1);
+				level[y*levelWidth + x] = std::max(std::max(below[y0*belowWidth + x0],below[y0*belowWidth + x1]),
+												   std::max(below[y1*belowWidth + x0],below[y1*belowWidth + x1]));
+			}
+	}
+}
+
+// Box is occluded if its nearest point is behind the farthest occluder depth in every texel it covers
+bool OcclusionCuller::IsVisible(const BoundingBox &box) const
+{
+	if(this->hierarchy.empty())
+		return true;
+
+	// the 8 corners are projected at once
+	std::array<f32,8> clipX,clipY,clipZ,clipW;
+#if defined(__AVX__)
+	const __m256 cornersX = _mm256_setr_ps(box.min.x,box.max.x,box.min.x,box.max.x,box.min.x,box.max.x,box.min.x,box.max.x);
+	const __m256 cornersY = _mm256_setr_ps(box.min.y,box.min.y,box.max.y,box.max.y,box.min.y,box.min.y,box.max.y,box.max.y);
+	const __m256 cornersZ = _mm256_setr_ps(box.min.z,box.min.z,box.min.z,box.min.z,box.max.z,box.max.z,box.max.z,box.max.z);
+
+	std::array<f32*,4> outputs = {clipX.data(),clipY.data(),clipZ.data(),clipW.data()};
+	for(u32 row = 0;row < 4;row++)
+	{
+		const glm::mat4 &m = this->viewProjection;
+		const __m256 result = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cornersX,_mm256_set1_ps(m[0][row])),
+														  _mm256_mul_ps(cornersY,_mm256_set1_ps(m[1][row]))),
+											_mm256_add_ps(_mm256_mul_ps(cornersZ,_mm256_set1_ps(m[2][row])),
+														  _mm256_set1_ps(m[3][row])));
+		_mm256_storeu_ps(outputs[row],result);
+	}
+#else
+	for(u32 corner = 0;corner < 8;corner++)
+	{
+		const glm::vec3 position(corner & 1 ? box.max.x : box.min.x,corner & 2 ? box.max.y : box.min.y,corner & 4 ? box.max.z : box.min.z);
+		const glm::vec4 clip = this->viewProjection*glm::vec4(position,1.f);
+		clipX[corner] = clip.x;
+		clipY[corner] = clip.y;
+		clipZ[corner] = clip.z;
+		clipW[corner] = clip.w;
+	}
+#endif
+
+	glm::vec2 screenMin(std::numeric_limits<f32>::max()),screenMax(std::numeric_limits<f32>::lowest());
+	f32 nearestDepth = std::numeric_limits<f32>::max();
+	for(u32 corner = 0;corner < 8;corner++)
+	{
+		if(clipW[corner] < nearClipW) // box reaches behind the camera
+			return true;
+
+		const glm::vec2 screen((.5f*clipX[corner]/clipW[corner] + .5f)*width,(.5f*clipY[corner]/clipW[corner] + .5f)*height);
+		screenMin 	 = glm::min(screenMin,screen);
+		screenMax 	 = glm::max(screenMax,screen);
+		nearestDepth = std::min(nearestDepth,clipZ[corner]/clipW[corner]);
+	}
+
+	const i32 minX = std::max(0,static_cast<i32>(std::floor(screenMin.x)));
+	const i32 maxX = std::min(static_cast<i32>(width) - 1,static_cast<i32>(std::floor(screenMax.x)));
+	const i32 minY = std::max(0,static_cast<i32>(std::floor(screenMin.y)));
+	const i32 maxY = std::min(static_cast<i32>(height) - 1,static_cast<i32>(std::floor(screenMax.y)));
+	if(minX > maxX || minY > maxY) // outside the screen, left to the frustum test
+		return true;
+
+	// coarsest level at which the rectangle still spans at most 2 texels in each direction
+	u32 level = 0;
+	while(level + 1 < this->hierarchy.size() && ((maxX >> level) - (minX >> level) > 1 || (maxY >> level) - (minY >> level) > 1))
+		level++;
+
+	const u32 levelWidth  = std::max(1u,width >> level);
+	const u32 levelHeight = std::max(1u,height >> level);
+	const std::pmr::vector<f32> &depths = this->hierarchy[level];
+	for(u32 y = std::min<u32>(minY >> level,levelHeight - 1);y <= std::min<u32>(maxY >> level,levelHeight - 1);y++)
+		for(u32 x = std::min<u32>(minX >> level,levelWidth - 1);x <= std::min<u32>(maxX >> level,levelWidth - 1);x++)
+			if(nearestDepth <= depths[y*levelWidth + x])
+				return true;
+
+	return false;
+}
+
+// Checks the depth buffer, the pyramid and IsVisible against a scalar reference, the occluder has to be the only one
+// rasterized since Begin. A pixel covered by the reference may only be missed if its center lies on a triangle edge,
+// and a box may only be reported as occluded if the reference finds no occluder texel it is in front of.
+// Boxes are spread over the screen at several depths, so tests at every pyramid level and on both sides of the occluder are covered
+bool OcclusionCuller::Verify(const std::vector<glm::vec3> &triangles,const glm::mat4 &transform) const
+{
+	const f64 edgeTolerance  = 1e-5; // in barycentric coordinates
+	const f32 depthTolerance = 1e-4f;
+
+	// bounds of the expected depth of every pixel: covered by any triangle touching its center,
+	// and covered only by triangles clearly containing its center
+	std::vector<f32> nearest(width*height,1.f),farthest(width*height,1.f);
+	const glm::mat4 modelViewProjection = this->viewProjection*transform;
+	for(u32 triangle = 0;triangle + 2 < triangles.size();triangle += 3)
+	{
+		std::array<glm::dvec3,3> screen;
+		bool behindNearPlane = false;
+		for(u32 vertex = 0;vertex < 3;vertex++)
+		{
+			const glm::vec4 clip = modelViewProjection*glm::vec4(triangles[triangle + vertex],1.f);
+			behindNearPlane |= clip.w < nearClipW;
+
+			const glm::vec3 ndc = glm::vec3(clip)/clip.w;
+			screen[vertex] = glm::dvec3((.5f*ndc.x + .5f)*width,(.5f*ndc.y + .5f)*height,ndc.z);
+		}
+
+		const f64 area = (screen[1].x - screen[0].x)*(screen[2].y - screen[0].y) - (screen[1].y - screen[0].y)*(screen[2].x - screen[0].x);
+		if(behindNearPlane || area == 0.)
+			continue;
+
+		for(u32 y = 0;y < height;y++)
+			for(u32 x = 0;x < width;x++)
+			{
+				const glm::dvec2 center(x + .5,y + .5);
+				std::array<f64,3> barycentric;
+				for(u32 edge = 0;edge < 3;edge++)
+				{
+					const glm::dvec3 &a = screen[(edge + 1)%3];
+					const glm::dvec3 &b = screen[(edge + 2)%3];
+					barycentric[edge] = ((b.x - a.x)*(center.y - a.y) - (b.y - a.y)*(center.x - a.x))/area;
+				}
+				const f64 smallest = std::min({barycentric[0],barycentric[1],barycentric[2]});
+				if(smallest < -edgeTolerance)
+					continue;
+
+				const f32 depth = static_cast<f32>(barycentric[0]*screen[0].z + barycentric[1]*screen[1].z + barycentric[2]*screen[2].z);
+				nearest[y*width + x] = std::min(nearest[y*width + x],depth);
+				if(smallest > edgeTolerance)
+					farthest[y*width + x] = std::min(farthest[y*width + x],depth);
+			}
+	}
+
+	u32 wrongPixels = 0;
+	for(u32 i = 0;i < width*height;i++)
+		wrongPixels += this->depthBuffer[i] < nearest[i] - depthTolerance || this->depthBuffer[i] > farthest[i] + depthTolerance;
+
+	// every texel has to be at least as far as the texels it covers in the level below
+	u32 wrongTexels = 0;
+	for(u32 level = 1;level < this->hierarchy.size();level++)
+	{
+		const u32 levelWidth  = std::max(1u,width >> level);
+		const u32 levelHeight = std::max(1u,height >> level);
+		const u32 belowWidth  = std::max(1u,width >> (level - 1));
+		const u32 belowHeight = std::max(1u,height >> (level - 1));
+		for(u32 y = 0;y < belowHeight;y++)
+			for(u32 x = 0;x < belowWidth;x++)
+				wrongTexels += this->hierarchy[level][std::min(y/2,levelHeight - 1)*levelWidth + std::min(x/2,levelWidth - 1)] <
+							   this->hierarchy[level - 1][y*belowWidth + x];
+	}
+
+	// boxes of about 4x4 pixels at fixed depths and just in front of and behind the occluder,
+	// occluded ones have to be behind the depth of every pixel they cover
+	const glm::mat4 inverseViewProjection = glm::inverse(this->viewProjection);
+	auto unproject = [&](const glm::vec3 &ndc){
+		const glm::vec4 position = inverseViewProjection*glm::vec4(ndc,1.f);
+		return glm::vec3(position)/position.w;
+	};
+	const std::array<f32,2> depths 			= {.9f,.999f};
+	const std::array<f32,3> occluderOffsets = {-1e-2f,-1e-3f,1e-3f};
+	const u32 boxesX = 32,boxesY = 16;
+	u32 testedBoxes = 0,wrongBoxes = 0;
+	for(u32 boxY = 0;boxY < boxesY;boxY++)
+		for(u32 boxX = 0;boxX < boxesX;boxX++)
+		{
+			const glm::vec2 center((boxX + .5f)*2.f/boxesX - 1.f,(boxY + .5f)*2.f/boxesY - 1.f);
+			const f32 		occluderDepth = this->depthBuffer[static_cast<u32>((.5f*center.y + .5f)*height)*width + static_cast<u32>((.5f*center.x + .5f)*width)];
+
+			std::vector<f32> boxDepths(depths.begin(),depths.end());
+			if(occluderDepth < 1.f)
+				for(const f32 offset : occluderOffsets)
+					boxDepths.push_back(occluderDepth + offset);
+
+			for(const f32 depth : boxDepths)
+			{
+				const glm::vec3 extent(4.f/width,4.f/height,1e-3f*(1.f - depth));
+				BoundingBox box;
+				for(u32 corner = 0;corner < 8;corner++)
+					box.Grow(unproject(glm::vec3(center,depth) + glm::vec3(corner & 1 ? extent.x : -extent.x,corner & 2 ? extent.y : -extent.y,
+																		   corner & 4 ? extent.z : -extent.z)));
+				testedBoxes++;
+
+				if(IsVisible(box))
+					continue;
+
+				glm::vec2 screenMin(std::numeric_limits<f32>::max()),screenMax(std::numeric_limits<f32>::lowest());
+				f32 nearestDepth = std::numeric_limits<f32>::max();
+				for(u32 corner = 0;corner < 8;corner++)
+				{
+					const glm::vec3 position(corner & 1 ? box.max.x : box.min.x,corner & 2 ? box.max.y : box.min.y,corner & 4 ? box.max.z : box.min.z);
+					const glm::vec4 clip = this->viewProjection*glm::vec4(position,1.f);
+					screenMin 	 = glm::min(screenMin,glm::vec2((.5f*clip.x/clip.w + .5f)*width,(.5f*clip.y/clip.w + .5f)*height));
+					screenMax 	 = glm::max(screenMax,glm::vec2((.5f*clip.x/clip.w + .5f)*width,(.5f*clip.y/clip.w + .5f)*height));
+					nearestDepth = std::min(nearestDepth,clip.z/clip.w);
+				}
+
+				// pixels the box clearly covers, the box is visible if it's clearly in front of any of them
+				bool visible = false;
+				for(i32 y = std::max(0,static_cast<i32>(std::floor(screenMin.y + 1e-3f)));y <= std::min(static_cast<i32>(height) - 1,static_cast<i32>(std::floor(screenMax.y - 1e-3f)));y++)
+					for(i32 x = std::max(0,static_cast<i32>(std::floor(screenMin.x + 1e-3f)));x <= std::min(static_cast<i32>(width) - 1,static_cast<i32>(std::floor(screenMax.x - 1e-3f)));x++)
+						visible |= nearestDepth + depthTolerance <= this->depthBuffer[y*width + x];
+				wrongBoxes += visible;
+			}
+		}
+
+	if(wrongPixels != 0)
+		std::cout << "Occlusion depth buffer differs from the reference rasterization at " << wrongPixels << " pixels!" << std::endl;
+	if(wrongTexels != 0)
+		std::cout << "Occlusion pyramid has " << wrongTexels << " texels nearer than the texels they cover!" << std::endl;
+	if(wrongBoxes != 0)
+		std::cout << "Occlusion test culled " << wrongBoxes << " of " << testedBoxes << " boxes in front of the occluder!" << std::endl;
+
+	return wrongPixels == 0 && wrongTexels == 0 && wrongBoxes == 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <memory_resource>
+#include <array>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "types.hpp"
+#include "bvh.hpp"
+#include "profiler.hpp"
+
+// Depth-only software rasterizer for occluders with a hierarchical depth pyramid built from its output.
+// Designated occluders (large, closed meshes) are rendered into a small depth buffer every frame, boxes
+// are then tested against the pyramid level at which they cover at most 2x2 texels, so a test reads at
+// most 4 values. Everything runs on the CPU, the results are available before any draw is submitted.
+// Depth is stored as NDC z, 1 (far plane) where nothing was rasterized
+struct OcclusionCuller
+{
+	static constexpr u32 width 		 = 256;
+	static constexpr u32 height 	 = 128;
+	static constexpr f32 nearClipW 	 = 1e-4f; // triangles/boxes with a vertex closer than this (clip w) aren't projected
+
+	glm::mat4 								viewProjection;
+	std::vector<f32> 						depthBuffer;		// width*height, padded by a SIMD register, so rows can be read past their end
+	std::pmr::vector<std::pmr::vector<f32>> hierarchy;		// level 0 is a copy of the depth buffer, texels of higher levels are maxima of 2x2 texels below
+	u32 									rasterizedTriangles = 0; // triangles rasterized since the last Begin
+
+	void Begin(const glm::mat4 &viewProjection);
+	void RasterizeOccluder(const std::vector<glm::vec3> &triangles,const glm::mat4 &transform);
+	void BuildHierarchy(std::pmr::memory_resource *frameResource = std::pmr::get_default_resource());
+	bool IsVisible(const BoundingBox &box) const;
+	bool Verify(const std::vector<glm::vec3> &triangles,const glm::mat4 &transform) const;
+
+	void RasterizeTriangle(glm::vec3 vertex0,glm::vec3 vertex1,glm::vec3 vertex2);
+};
@@ -4,6 +4,11 @@
 #include <cstdlib>
 #include <fstream>
 #include <chrono>
+#include <vector>
+#include <string_view>
+#include <filesystem>
+#include <charconv>
+#include <optional>
 
 #include <GLEW/glew.h>
 #include <GLFW/glfw3.h>
@@ -19,6 +24,22 @@
 #include "texturemanager.hpp"
 #include "camera.hpp"
 #include "mouse.hpp"
+#include "glstate.hpp"
+#include "materialmanager.hpp"
+#include "renderqueue.hpp"
+#include "scene.hpp"
+#include "culling.hpp"
+#include "gpuculler.hpp"
+#include "framebuffer.hpp"
+#include "assetregistry.hpp"
+#include "framearena.hpp"
+#include "jobsystem.hpp"
+#include "filereader.hpp"
+#include "archive.hpp"
+#include "profiler.hpp"
+#include "gpuprofiler.hpp"
+#include "headless.hpp"
+#include "task.hpp"
 #include "misc.hpp"
 
 namespace Modes
@@ -30,6 +51,8 @@ namespace Modes
 	};
 	bool mouseModeChanged = false;
 
+	bool pickRequested = false; // cast a ray from the camera on the next frame
+
 	u32 currentDrawMode = 0;
 	const std::array drawModes = {
 		GL_FILL,
@@ -53,41 +76,144 @@ void GetInput(GLFWwindow *window, Camera *camera, Mouse *mouse);
 // LCRTL - descend
 // R 	 - toggle camera look
 // TAB 	 - change draw mode
+// P 	 - pick the object in the view center
 // ESC	 - exit
 
 
-int main()
+int main(int argc,char **argv)
 {
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE,GLFW_OPENGL_CORE_PROFILE);
-	//Toggle resizable window 
-	//glfwWindowHint(GLFW_RESIZABLE,false);
-
-	GLFWwindow *window = glfwCreateWindow(windowWidth,windowHeight,"OpenGLWin",0,0);
-	
-	if(!window)
+	// "OpenGL --pack assets assets.pack" packs the loose assets into an archive
+	if(argc == 4 && std::string_view(argv[1]) == "--pack")
+	{
+		Archive archive;
+		const bool packed = Archive::Pack(argv[2],argv[3]) && archive.Open(argv[3]) && archive.Verify();
+		return packed ? 0 : -1;
+	}
+
+	// "OpenGL --trace trace.json" captures a profiler trace of the whole run (Chrome trace event format).
+	// "OpenGL --headless" renders without a window at a fixed timestep, options:
+	//	--frames N 			number of frames to render (600)
+	//	--size WxH 			size of the rendered frames (1280x720)
+	//	--dump directory 	writes the last frame to the directory as PPM
+	//	--dump-interval N 	also writes every N-th frame
+	//	--compare directory compares the dumps with the reference images of the same name in the directory
+	//	--tolerance N 		largest difference of a color channel the comparison allows (0)
+	// "OpenGL --verify" checks the compute dispatches once, compares the GPU culling results of every frame with
+	// the CPU reference and checks the order of the GPU profiler's timestamps. The exit code is -1 on a mismatch
+	// of these checks or of a frame comparison, and on a dump which couldn't be written
+	std::string tracePath;
+	bool headless = false;
+	bool verify   = false;
+	FrameDriver frameDriver;
+
+	auto parseNumber = [](std::string_view text,u64 &value){
+		const auto [end,error] = std::from_chars(text.data(),text.data() + text.size(),value);
+		if(error != std::errc() || end != text.data() + text.size())
+		{
+			std::cout << "Invalid number: \"" << text << '"' << std::endl;
+			exit(-1);
+		}
+	};
+	for(i32 i = 1;i < argc;i++)
 	{
-		std::cout << "Window couldn't be created!" << std::endl;
-		exit(-1);
+		const std::string_view argument = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if(argument == "--headless")
+			headless = true;
+		else if(argument == "--verify")
+			verify = true;
+		else if(argument == "--trace" && hasValue)
+			tracePath = argv[++i];
+		else if(argument == "--frames" && hasValue)
+			parseNumber(argv[++i],frameDriver.numberOfFrames);
+		else if(argument == "--dump" && hasValue)
+			frameDriver.dumpDirectory = argv[++i];
+		else if(argument == "--dump-interval" && hasValue)
+			parseNumber(argv[++i],frameDriver.dumpInterval);
+		else if(argument == "--compare" && hasValue)
+			frameDriver.compareDirectory = argv[++i];
+		else if(argument == "--tolerance" && hasValue)
+			parseNumber(argv[++i],frameDriver.tolerance);
+		else if(argument == "--size" && hasValue)
+		{
+			const std::string_view size = argv[++i];
+			const u64 separator = std::min(size.find('x'),size.size());
+			u64 width = 0,height = 0;
+			parseNumber(size.substr(0,separator),width);
+			parseNumber(size.substr(std::min(separator + 1,size.size())),height);
+			windowWidth  = static_cast<u32>(std::clamp<u64>(width,1,16384));
+			windowHeight = static_cast<u32>(std::clamp<u64>(height,1,16384));
+		}
+		else
+		{
+			std::cout << "Unknown argument: \"" << argument << '"' << std::endl;
+			exit(-1);
+		}
 	}
+	PROFILE_THREAD("Main");
+	if(!tracePath.empty())
+		Profiler::Get().StartCapture();
+
+	GLFWwindow *window = nullptr;
+	HeadlessContext headlessContext;
+	if(headless)
+		headlessContext.Create();
+	else
+	{
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE,GLFW_OPENGL_CORE_PROFILE);
+		//Toggle resizable window 
+		//glfwWindowHint(GLFW_RESIZABLE,false);
+
+		window = glfwCreateWindow(windowWidth,windowHeight,"OpenGLWin",0,0);
+		
+		if(!window)
+		{
+			std::cout << "Window couldn't be created!" << std::endl;
+			exit(-1);
+		}
 
-	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window,FramebufferResizeCB);
-	glfwSetKeyCallback(window,KeyPressedCB);
+		glfwMakeContextCurrent(window);
+		glfwSetFramebufferSizeCallback(window,FramebufferResizeCB);
+		glfwSetKeyCallback(window,KeyPressedCB);
+	}
 
+	// a GLEW built for GLX reports the missing GLX display in headless mode, the entry points are loaded regardless
   	glewInit();
 
-  	glViewport(0,0,1280,720);
-  	glEnable(GL_DEPTH_TEST);  
+  	glViewport(0,0,windowWidth,windowHeight);
+
+	// the main thread is worker 0 of the job system
+	JobSystem jobSystem;
+
+	// asset files are read from the packed archive if there is one (release), anything it doesn't contain is read
+	// from the loose files (development). Loose files are read with io_uring where available, reads finish in jobs
+	Archive assetArchive;
+	FileReader fileReader;
+	fileReader.Start(jobSystem);
+	if(std::filesystem::exists("assets.pack") && assetArchive.Open("assets.pack"))
+		fileReader.Mount(assetArchive);
 
 	ModelManager modelManager;
+	TextureManager textureManager;
+	modelManager.jobSystem 	  = &jobSystem;
+	modelManager.fileReader   = &fileReader;
+	textureManager.jobSystem  = &jobSystem;
+	textureManager.fileReader = &fileReader;
+
+	// files are loaded through the registry, so entries sharing a file and import settings share the loaded asset
+	AssetRegistry assetRegistry;
+	std::vector<ModelHandle> 	loadedModels;
+	std::vector<TextureHandle> 	loadedTextures;
 
 	const std::array modelInfos = {
 		ModelInfo{
 			.modelName   = "house",
-			.pathToModel = "assets/models/houseVT.obj"
+			.pathToModel = "assets/models/houseVT.obj",
+			.buildBVH 	 = true
 		},
 		ModelInfo{
 			.modelName   = "skyboxCube",
@@ -95,20 +221,29 @@ int main()
 		},
 		ModelInfo{
 			.modelName   = "cube",
-			.pathToModel = "assets/models/cubeVN.obj"
+			.pathToModel = "assets/models/cubeVN.obj",
+			.buildBVH 	 = true
+		},
+		ModelInfo{
+			.modelName 	  = "teapot",
+			.pathToModel  = "assets/models/teapotV.obj",
+			.buildBVH 	  = true,
+			.numberOfLODs = 5
 		}
 	};
 	
+	// all loads are started before any is waited for, so parsing and decoding overlap and only the uploads
+	// are serialized on the main thread
+	std::vector<Task<ModelHandle>> 	 modelLoads;
+	std::vector<Task<TextureHandle>> textureLoads;
 	for(const auto &modelInfo : modelInfos)
-		modelManager.LoadModel(modelInfo);
-	
-  	TextureManager textureManager;
+		modelLoads.push_back(assetRegistry.AcquireModelAsync(jobSystem,modelManager,modelInfo));
 
 	const TextureInfo textureInfo = {
 		.name 		 = "house",
 		.pathToImage = "assets/textures/house.jpg"
 	};
-  	textureManager.CreateTextureFromImage(textureInfo);
+	textureLoads.push_back(assetRegistry.AcquireTextureAsync(jobSystem,textureManager,textureInfo));
 
 	const CubemapTextureInfo cubemapInfo = {
 		.name = "skybox",
@@ -121,41 +256,91 @@ int main()
 			"assets/textures/skybox/negz.jpg"
 		}
 	};
-	textureManager.CreateCubemapFromImages(cubemapInfo);
+	textureLoads.push_back(assetRegistry.AcquireCubemapAsync(jobSystem,textureManager,cubemapInfo));
+
+	for(Task<ModelHandle> &load : modelLoads)
+		loadedModels.push_back(load.Wait(jobSystem));
+	for(Task<TextureHandle> &load : textureLoads)
+		loadedTextures.push_back(load.Wait(jobSystem));
 
 
 	ShaderManager shaderManager;
+	shaderManager.fileReader = &fileReader;
+
+	// model and skybox modules are loaded from the SPIR-V built by "make shaders" if it's available, the
+	// sources are compiled otherwise. The culling shader's work group size is a specialization constant
+	const u32 cullWorkGroupSize = 128;
 
 	const std::array shaderModuleInfos = {
 		ShaderModuleInfo{
 			.name 		  = "texturedmodelVert",
-			.pathToShader = "assets/shaders/texturedmodel.vert",				
-			.type 		  = GL_VERTEX_SHADER
+			.pathToShader = "assets/shaders/model.vert",				
+			.type 		  = GL_VERTEX_SHADER,
+			.defines 	  = {{"TEXTURED",""}},
+			.pathToBinary = "assets/shaders/spirv/texturedmodel.vert.spv"
 		},
 		ShaderModuleInfo{
 			.name 		  = "texturedmodelFrag",
-			.pathToShader = "assets/shaders/texturedmodel.frag",
-			.type 		  = GL_FRAGMENT_SHADER
+			.pathToShader = "assets/shaders/model.frag",
+			.type 		  = GL_FRAGMENT_SHADER,
+			.defines 	  = {{"TEXTURED",""}},
+			.pathToBinary = "assets/shaders/spirv/texturedmodel.frag.spv"
+		},
+		ShaderModuleInfo{
+			.name 		  = "texturedinstancedmodelVert",
+			.pathToShader = "assets/shaders/model.vert",
+			.type 		  = GL_VERTEX_SHADER,
+			.defines 	  = {{"TEXTURED",""},{"INSTANCED",""}},
+			.pathToBinary = "assets/shaders/spirv/texturedinstancedmodel.vert.spv"
 		},
 		ShaderModuleInfo{
-			.name 		  = "coloredmodelVert",
-			.pathToShader = "assets/shaders/coloredmodel.vert",				
-			.type 		  = GL_VERTEX_SHADER
+			.name 		  = "texturedinstancedmodelFrag",
+			.pathToShader = "assets/shaders/model.frag",
+			.type 		  = GL_FRAGMENT_SHADER,
+			.defines 	  = {{"TEXTURED",""},{"INSTANCED",""}},
+			.pathToBinary = "assets/shaders/spirv/texturedinstancedmodel.frag.spv"
 		},
 		ShaderModuleInfo{
-			.name 		  = "coloredmodelFrag",
-			.pathToShader = "assets/shaders/coloredmodel.frag",
-			.type 		  = GL_FRAGMENT_SHADER
+			.name 		  = "instancedmodelVert",
+			.pathToShader = "assets/shaders/model.vert",				
+			.type 		  = GL_VERTEX_SHADER,
+			.defines 	  = {{"INSTANCED",""}},
+			.pathToBinary = "assets/shaders/spirv/instancedmodel.vert.spv"
+		},
+		ShaderModuleInfo{
+			.name 		  = "instancedmodelFrag",
+			.pathToShader = "assets/shaders/model.frag",
+			.type 		  = GL_FRAGMENT_SHADER,
+			.defines 	  = {{"INSTANCED",""}},
+			.pathToBinary = "assets/shaders/spirv/instancedmodel.frag.spv"
 		},
 		ShaderModuleInfo{
 			.name 		  = "skyboxVert",
 			.pathToShader = "assets/shaders/skybox.vert",
-			.type 		  = GL_VERTEX_SHADER
+			.type 		  = GL_VERTEX_SHADER,
+			.pathToBinary = "assets/shaders/spirv/skybox.vert.spv"
 		},
 		ShaderModuleInfo{
 			.name 		  = "skyboxFrag",
 			.pathToShader = "assets/shaders/skybox.frag",
-			.type 		  = GL_FRAGMENT_SHADER
+			.type 		  = GL_FRAGMENT_SHADER,
+			.pathToBinary = "assets/shaders/spirv/skybox.frag.spv"
+		},
+		ShaderModuleInfo{
+			.name 		  			 = "gpucullComp",
+			.pathToShader 			 = "assets/shaders/gpucull.comp",
+			.type 		  			 = GL_COMPUTE_SHADER,
+			.specializationConstants = {{.constantID = 0,.value = cullWorkGroupSize}}
+		},
+		ShaderModuleInfo{
+			.name 		  = "gpucompactComp",
+			.pathToShader = "assets/shaders/gpucompact.comp",
+			.type 		  = GL_COMPUTE_SHADER
+		},
+		ShaderModuleInfo{
+			.name 		  = "hizComp",
+			.pathToShader = "assets/shaders/hiz.comp",
+			.type 		  = GL_COMPUTE_SHADER
 		}
 	};
 	for(const auto &shaderModuleInfo : shaderModuleInfos)
@@ -171,10 +356,18 @@ int main()
 			.deleteModules = true
 		},
 		ShaderProgramInfo{
-			.name          = "coloredmodel",
+			.name          = "texturedinstancedmodel",
+			.moduleNames   = {
+				"texturedinstancedmodelVert",
+				"texturedinstancedmodelFrag"
+			},
+			.deleteModules = true
+		},
+		ShaderProgramInfo{
+			.name          = "instancedmodel",
 			.moduleNames   = {
-				"coloredmodelVert",
-				"coloredmodelFrag"
+				"instancedmodelVert",
+				"instancedmodelFrag"
 			},
 			.deleteModules = true
 		},
@@ -185,48 +378,266 @@ int main()
 				"skyboxFrag"
 			},
 			.deleteModules = true
+		},
+		ShaderProgramInfo{
+			.name          = "gpucull",
+			.moduleNames   = {"gpucullComp"},
+			.deleteModules = true
+		},
+		ShaderProgramInfo{
+			.name          = "gpucompact",
+			.moduleNames   = {"gpucompactComp"},
+			.deleteModules = true
+		},
+		ShaderProgramInfo{
+			.name          = "hiz",
+			.moduleNames   = {"hizComp"},
+			.deleteModules = true
 		}
 	};
 	for(const auto &shaderProgramInfo : shaderProgramInfos)
 		shaderManager.CreateShaderProgram(shaderProgramInfo);
 
+	// only used by the checks of --verify
+	if(verify)
+	{
+		shaderManager.CreateShaderModule(ShaderModuleInfo{
+			.name 		  = "dispatchcheckComp",
+			.pathToShader = "assets/shaders/dispatchcheck.comp",
+			.type 		  = GL_COMPUTE_SHADER
+		});
+		shaderManager.CreateShaderProgram(ShaderProgramInfo{
+			.name          = "dispatchcheck",
+			.moduleNames   = {"dispatchcheckComp"},
+			.deleteModules = true
+		});
+	}
+
+	// names are resolved once, the rest of the program only uses the handles
+	const ShaderProgramHandle texturedProgramHandle  		  = shaderManager.GetShaderProgram("texturedmodel");
+	const ShaderProgramHandle skyboxProgramHandle 	 		  = shaderManager.GetShaderProgram("skybox");
+	const ShaderProgramHandle instancedProgramHandle 		  = shaderManager.GetShaderProgram("instancedmodel");
+	const ShaderProgramHandle texturedInstancedProgramHandle = shaderManager.GetShaderProgram("texturedinstancedmodel");
+
 	const std::array textureSamplerVariables = {
 		ShaderVariable<i32>{
-			.programName  = "texturedmodel",
+			.program 	  = texturedProgramHandle,
 			.variableName = "textureSampler",
 			.newValue     = 0 // texture sampler is linked to GL_TEXTURE0 binding
 		},
 		ShaderVariable<i32>{
-			.programName  = "skybox",
+			.program 	  = skyboxProgramHandle,
 			.variableName = "cubemapSampler",
 			.newValue     = 0
 		}
 	};
-	shaderManager.UseShaderProgram("texturedmodel");
+	shaderManager.UseShaderProgram(texturedProgramHandle);
 	shaderManager.SetVariable(textureSamplerVariables[0]);
 
-	shaderManager.UseShaderProgram("skybox");
+	shaderManager.UseShaderProgram(skyboxProgramHandle);
 	shaderManager.SetVariable(textureSamplerVariables[1]);
 
   	Camera camera(glm::vec3(0.f,0.f,3.f),glm::vec3(0.f,0.f,0.f));
 
-  	if(!glfwRawMouseMotionSupported())
-  	{
-    	std::cout << "Raw mouse input not supported!" << std::endl;
-    	exit(-1);
-  	}
+	// headless runs have no input, the camera stays where it starts
+	std::optional<Mouse> mouse;
+	if(!headless)
+	{
+		if(glfwRawMouseMotionSupported())
+			glfwSetInputMode(window,GLFW_RAW_MOUSE_MOTION,true);
+		else
+			std::cout << "Raw mouse input not supported, the cursor position is used instead." << std::endl;
+
+		mouse.emplace(window);
+	}
 
-	glfwSetInputMode(window,GLFW_RAW_MOUSE_MOTION,true);
+	const u32 texturedProgram 		   = shaderManager.shaderPrograms[texturedProgramHandle].programID;
+	const u32 skyboxProgram   		   = shaderManager.shaderPrograms[skyboxProgramHandle].programID;
+	const u32 instancedProgram 		   = shaderManager.shaderPrograms[instancedProgramHandle].programID;
+	const u32 texturedInstancedProgram = shaderManager.shaderPrograms[texturedInstancedProgramHandle].programID;
 
-	Mouse mouse(window);
+	MaterialManager materialManager;
+
+	// colored model uses the same Transforms block, std140 guarantees an identical layout
+	const std::array materialLayoutInfos = {
+		MaterialLayoutInfo{
+			.name 	   = "transforms",
+			.programID = texturedProgram,
+			.blockName = "Transforms",
+			.interface = GL_UNIFORM_BLOCK
+		},
+		MaterialLayoutInfo{
+			.name 	   = "skyboxTransforms",
+			.programID = skyboxProgram,
+			.blockName = "SkyboxTransforms",
+			.interface = GL_UNIFORM_BLOCK
+		}
+	};
+	for(const auto &materialLayoutInfo : materialLayoutInfos)
+		materialManager.CreateMaterialLayout(materialLayoutInfo);
+
+	const std::array materialInfos = {
+		MaterialInfo{
+			.name 		= "house",
+			.layoutName = "transforms"
+		},
+		MaterialInfo{
+			.name 		= "cube",
+			.layoutName = "transforms"
+		},
+		MaterialInfo{
+			.name 		= "cubeField",
+			.layoutName = "transforms"
+		},
+		MaterialInfo{
+			.name 		= "teapot",
+			.layoutName = "transforms"
+		},
+		MaterialInfo{
+			.name 		= "skybox",
+			.layoutName = "skyboxTransforms"
+		}
+	};
+	for(const auto &materialInfo : materialInfos)
+		materialManager.CreateMaterial(materialInfo);
+
+	Material &houseMaterial 	= materialManager.GetMaterial("house");
+	Material &cubeMaterial 		= materialManager.GetMaterial("cube");
+	Material &skyboxMaterial 	= materialManager.GetMaterial("skybox");
+	Material &cubeFieldMaterial = materialManager.GetMaterial("cubeField");
+	Material &teapotMaterial 	= materialManager.GetMaterial("teapot");
+
+	const u32 viewParameter 	  	  = materialManager.GetParameterIndex("transforms","view");
+	const u32 projectionParameter 	  = materialManager.GetParameterIndex("transforms","projection");
+	const u32 skyboxViewParameter 	  = materialManager.GetParameterIndex("skyboxTransforms","view");
+	const u32 skyboxProjectionParameter = materialManager.GetParameterIndex("skyboxTransforms","projection");
+
+	// field of cubes below the scene, culled on the GPU and drawn with a single indirect draw call
+	const u32 cubeFieldSide = 320;
+	std::vector<InstanceData> cubeField(cubeFieldSide*cubeFieldSide);
+	for(u32 x = 0;x < cubeFieldSide;x++)
+		for(u32 z = 0;z < cubeFieldSide;z++)
+		{
+			const glm::vec3 position(3.f*x - 1.5f*cubeFieldSide,-20.f,3.f*z - 1.5f*cubeFieldSide);
+			cubeField[x*cubeFieldSide + z] = InstanceData{
+				.transform = glm::translate(glm::mat4(1.f),position),
+				.color 	   = glm::vec4(x/static_cast<f32>(cubeFieldSide),.5f,z/static_cast<f32>(cubeFieldSide),1.f)
+			};
+		}
+
+	GPUCuller gpuCuller{
+		.info = {
+			.cullProgram 	= shaderManager.GetComputeProgram(shaderManager.GetShaderProgram("gpucull")),
+			.compactProgram = shaderManager.GetComputeProgram(shaderManager.GetShaderProgram("gpucompact")),
+			.hizProgram 	= shaderManager.GetComputeProgram(shaderManager.GetShaderProgram("hiz"))
+		}
+	};
+	const ModelHandle houseHandle 	   = modelManager.GetModel("house");
+	const ModelHandle cubeHandle 	   = modelManager.GetModel("cube");
+	const ModelHandle skyboxCubeHandle = modelManager.GetModel("skyboxCube");
+	const ModelHandle teapotHandle 	   = modelManager.GetModel("teapot");
+
+	gpuCuller.AddGroup(modelManager.models[cubeHandle],cubeField.data(),cubeField.size());
+	gpuCuller.Upload();
+
+	// no model is loaded or deleted while the main loop runs, so references into the slot map stay valid
+	const Model &house 		= modelManager.models[houseHandle];
+	const Model &cube 		= modelManager.models[cubeHandle];
+	const Model &skyboxCube = modelManager.models[skyboxCubeHandle];
+	const Model &teapot 	= modelManager.models[teapotHandle];
+	const u32 houseTexture  = textureManager.textures[textureManager.GetTexture("house")].textureID;
+	const u32 skyboxTexture = textureManager.textures[textureManager.GetTexture("skybox")].textureID;
+
+	// transient per-frame data is allocated from here, declared first so it outlives the containers using it
+	FrameAllocator frameAllocator;
+
+	RenderQueue renderQueue;
+	renderQueue.farPlane = 500.f;
+	FrustumCuller frustumCuller;
+
+	// house hides whatever is behind it, its triangles are rasterized into the occlusion depth buffer
+	OcclusionCuller occlusionCuller;
+	const std::vector<glm::vec3> &houseTriangles = modelManager.meshBVHs[house.meshBVH].triangles;
+
+	// cube is attached to the house, so it follows the house's transform
+	Scene scene;
+	const u32 houseNode = scene.CreateNode(SceneNodeInfo{
+		.position = glm::vec3(.1f,0.f,0.f)
+	});
+	const u32 cubeNode = scene.CreateNode(SceneNodeInfo{
+		.parent   = houseNode,
+		.position = glm::vec3(-2.1f,0.f,3.f)
+	});
+
+	// teapot is drawn with the LOD matching its size on screen, the selected LOD is kept between frames for the hysteresis
+	const u32 teapotNode = scene.CreateNode(SceneNodeInfo{
+		.position = glm::vec3(12.f,0.f,-6.f)
+	});
+	LODSelector lodSelector;
+	u32 teapotLOD = 0;
+
+	// world nodes, the BVH over their world bounds is refitted every frame. It's used for picking and
+	// the frustum culling of their items, which are submitted in the same order
+	const std::array sceneNodes  = {houseNode,cubeNode,teapotNode};
+	const std::array sceneModels = {houseHandle,cubeHandle,teapotHandle};
+	std::vector<BoundingBox> sceneBounds(sceneNodes.size());
+	BVH sceneBVH;
+
+	// scene is rendered offscreen, so its depth can be reduced into the pyramid used by the GPU culler
+	Framebuffer sceneFramebuffer;
+	sceneFramebuffer.Create(windowWidth,windowHeight);
+
+	// managers have changed the bindings while creating resources, so the cache starts from unknown state
+	GLState glState;
+	glState.SetDepthTest(true);
+	modelManager.glState   = &glState;
+	textureManager.glState = &glState;
+
+	// GPU timings are read back a few frames late and added to the profiler on their own track
+	GPUProfiler gpuProfiler;
+	gpuProfiler.Create();
+	renderQueue.gpuProfiler = &gpuProfiler;
+
+	// results of --verify, frame dumps and frame comparisons which didn't succeed
+	u64 verifiedChecks = 0;
+	u64 failedChecks   = 0;
+	auto check = [&](bool valid){
+		verifiedChecks++;
+		failedChecks += !valid;
+	};
+	if(verify)
+		check(shaderManager.VerifyDispatch(shaderManager.GetComputeProgram(shaderManager.GetShaderProgram("dispatchcheck")),glState));
 
 	// Main loop
- 	while(!glfwWindowShouldClose(window))
+	frameDriver.Start();
+ 	while(headless ? frameDriver.Running() : !glfwWindowShouldClose(window))
   	{
+		// a minimized window has a 0 x 0 framebuffer, which the scene framebuffer and the depth pyramid can't be
+		// created with, so nothing is rendered until the window is restored
+		if(!headless && (windowWidth == 0 || windowHeight == 0))
+		{
+			glfwWaitEvents();
+			continue;
+		}
+
+    	frameAllocator.BeginFrame();
+		gpuProfiler.BeginFrame();
+
     	// Input
-    	GetInput(window,&camera,&mouse);
+		if(!headless)
+		{
+			PROFILE_SCOPE("Input");
+    		GetInput(window,&camera,&*mouse);
+		}
 
     	// Render
+		if(sceneFramebuffer.width != windowWidth || sceneFramebuffer.height != windowHeight)
+		{
+			sceneFramebuffer.Create(windowWidth,windowHeight);
+			glState.Invalidate();
+		}
+		sceneFramebuffer.Bind();
+
     	glClearColor(.3f,.3f,.3f,2.f);
     	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -235,107 +646,222 @@ int main()
     	//model = glm::translate(model,glm::vec3(glm::sin(time),0.0f,0.0f));
     	//model = glm::rotate(model,5*glm::sin(time),glm::vec3(0.5f,0.3f,0.0f));
 
-		const std::array MVP = {
-			ShaderVariable<glm::mat4>{ // model
-				.programName  = "texturedmodel",
-				.variableName = "model",
-				.newValue 	  = glm::translate(glm::mat4(1.f),glm::vec3(.1f,0.f,0.f))
-			},
-			ShaderVariable<glm::mat4>{ // view
-				.programName  = "texturedmodel",
-				.variableName = "view",
-				.newValue 	  = glm::lookAt(camera.position,camera.position+camera.direction,glm::vec3(0.f,1.f,0.f))
-			},
-			ShaderVariable<glm::mat4>{ // projection
-				.programName  = "texturedmodel",
-				.variableName = "projection",
-				.newValue 	  = glm::perspective(glm::radians(45.0f),windowWidth/static_cast<f32>(windowHeight),.1f,100.f)
-			}
-		};
+		const glm::mat4 view 	   = glm::lookAt(camera.position,camera.position+camera.direction,glm::vec3(0.f,1.f,0.f));
+		const glm::mat4 projection = glm::perspective(glm::radians(45.0f),windowWidth/static_cast<f32>(windowHeight),.1f,500.f);
 
-		const std::array MVPcube = {
-			ShaderVariable<glm::mat4>{ // model
-				.programName  = "coloredmodel",
-				.variableName = "model",
-				.newValue 	  = glm::translate(glm::mat4(1.f),glm::vec3(-2.f,0.f,3.f))
-			},
-			ShaderVariable<glm::mat4>{ // view
-				.programName  = "coloredmodel",
-				.variableName = "view",
-				.newValue 	  = glm::lookAt(camera.position,camera.position+camera.direction,glm::vec3(0.f,1.f,0.f))
-			},
-			ShaderVariable<glm::mat4>{ // projection
-				.programName  = "coloredmodel",
-				.variableName = "projection",
-				.newValue 	  = glm::perspective(glm::radians(45.0f),windowWidth/static_cast<f32>(windowHeight),.1f,100.f)
-			}
-		};
+		// only the bytes which changed since the previous frame are uploaded
+		houseMaterial.Set(viewParameter,view);
+		houseMaterial.Set(projectionParameter,projection);
 
-		const std::array VPskybox = {
-			ShaderVariable<glm::mat4>{ // view
-				.programName  = "skybox",
-				.variableName = "view",
-				.newValue 	  = glm::mat4(glm::mat3(glm::lookAt(camera.position,camera.position+camera.direction,glm::vec3(0.0f,1.0f,0.0f))))
-			},
-			ShaderVariable<glm::mat4>{ // projection
-				.programName  = "skybox",
-				.variableName = "projection",
-				.newValue 	  = glm::perspective(glm::radians(45.0f),windowWidth/static_cast<f32>(windowHeight),0.1f,100.0f)
-			}
-		};
+		cubeMaterial.Set(viewParameter,view);
+		cubeMaterial.Set(projectionParameter,projection);
 
-		//house
-		const Model &house = modelManager.models["house"];
+		cubeFieldMaterial.Set(viewParameter,view);
+		cubeFieldMaterial.Set(projectionParameter,projection);
 
-    	glActiveTexture(GL_TEXTURE0);
-    	glBindTexture(GL_TEXTURE_2D,textureManager.textures["house"]);
-    
-		shaderManager.UseShaderProgram("texturedmodel");
-		for(const auto &variable : MVP)
-			shaderManager.SetVariable(variable);
+		teapotMaterial.Set(viewParameter,view);
+		teapotMaterial.Set(projectionParameter,projection);
 
-		glBindVertexArray(house.vertexArrayID);
-		glDrawArrays(GL_TRIANGLES,0,house.numberOfVertices);
-		glBindVertexArray(0);
-		
-		//cube
-		const Model &cube = modelManager.models["cube"];
+		skyboxMaterial.Set(skyboxViewParameter,glm::mat4(glm::mat3(view)));
+		skyboxMaterial.Set(skyboxProjectionParameter,projection);
+
+		glState.SetPolygonMode(Modes::drawModes[Modes::currentDrawMode]);
+
+		const f32 time = static_cast<f32>(headless ? frameDriver.Time() : glfwGetTime());
+		scene.SetRotation(cubeNode,glm::angleAxis(time,glm::vec3(0.f,1.f,0.f)));
+		scene.UpdateTransforms();
+
+		const glm::mat4 &houseTransform = scene.GetWorldMatrix(houseNode);
+		const glm::mat4 &cubeTransform  = scene.GetWorldMatrix(cubeNode);
+		const glm::mat4 &teapotTransform = scene.GetWorldMatrix(teapotNode);
 
-		shaderManager.UseShaderProgram("coloredmodel");
-		for(const auto &variable : MVPcube)
-			shaderManager.SetVariable(variable);
+		lodSelector.SetProjection(glm::radians(45.f),windowHeight);
+		teapotLOD = lodSelector.Select(teapot,teapotTransform,camera.position,teapotLOD);
 
-		glBindVertexArray(cube.vertexArrayID);
-		glDrawArrays(GL_TRIANGLES,0,cube.numberOfVertices);
-		glBindVertexArray(0);
+		for(u32 i = 0;i < sceneNodes.size();i++)
+		{
+			const Model &model = modelManager.models[sceneModels[i]];
+			sceneBounds[i] = BoundingBox{.min = model.boundsMin,.max = model.boundsMax}.Transformed(scene.GetWorldMatrix(sceneNodes[i]));
+		}
+		if(sceneBVH.nodes.empty())
+			sceneBVH.Build(sceneBounds,&jobSystem);
+		else
+			sceneBVH.Refit(sceneBounds);
 
-		// skybox
-		glDepthFunc(GL_LEQUAL); 
+		if(Modes::pickRequested)
+		{
+			// instance boxes are tested first, only the meshes of the hit instances are traversed in object space
+			const Ray ray{
+				.origin    = camera.position,
+				.direction = camera.direction
+			};
+			const RayHit hit = sceneBVH.CastRay(ray,[&](u32 primitive,const Ray &ray,f32 tMax){
+				const glm::mat4 inverseTransform = glm::inverse(scene.GetWorldMatrix(sceneNodes[primitive]));
+				const Ray objectRay{
+					.origin    = glm::vec3(inverseTransform*glm::vec4(ray.origin,1.f)),
+					.direction = glm::vec3(inverseTransform*glm::vec4(ray.direction,0.f)),
+					.tMax 	   = tMax
+				};
+				return modelManager.meshBVHs[modelManager.models[sceneModels[primitive]].meshBVH].CastRay(objectRay).t;
+			});
+
+			if(hit.primitive != ~0u)
+				std::cout << "Picked \"" << modelManager.modelNames.Name(modelManager.models[sceneModels[hit.primitive]].name) << "\" at distance " << hit.t << std::endl;
+			else
+				std::cout << "Nothing picked" << std::endl;
+			Modes::pickRequested = false;
+		}
 
-		const Model &skyboxCube = modelManager.models["skyboxCube"];
+		// submission order doesn't matter, the queue orders the draws by their keys.
+		// World items go through the culler, which submits only those inside the view frustum (found through
+		// sceneBVH, so they're submitted in the order of sceneNodes).
+		// They're batched, visible items of the same arena and material are drawn with a single multi-draw
+		renderQueue.Clear(frameAllocator.Resource());
+		frustumCuller.Clear(frameAllocator.Resource());
+		renderQueue.Submit(RenderItem{
+			.model 	   	   = &skyboxCube,
+			.programID 	   = skyboxProgram,
+			.textureTarget = GL_TEXTURE_CUBE_MAP,
+			.textureID 	   = skyboxTexture,
+			.material  	   = &skyboxMaterial,
+			.layer 	   	   = LAYER_SKYBOX,
+			.gpuZone 	   = "GPU skybox"
+		});
+		frustumCuller.Submit(RenderItem{
+			.model 	   			= &house,
+			.programID 			= texturedInstancedProgram,
+			.textureID 			= houseTexture,
+			.material  			= &houseMaterial,
+			.transform 			= houseTransform,
+			.batched 			= true,
+			.depth 				= glm::distance(camera.position,glm::vec3(houseTransform[3])),
+			.gpuZone 			= "GPU house"
+		});
+		frustumCuller.Submit(RenderItem{
+			.model 	   			= &cube,
+			.programID 			= instancedProgram,
+			.material  			= &cubeMaterial,
+			.transform 			= cubeTransform,
+			.batched 			= true,
+			.depth 				= glm::distance(camera.position,glm::vec3(cubeTransform[3])),
+			.gpuZone 			= "GPU cube"
+		});
+		frustumCuller.Submit(RenderItem{
+			.model 	   			= &teapot,
+			.programID 			= instancedProgram,
+			.material  			= &teapotMaterial,
+			.transform 			= teapotTransform,
+			.batched 			= true,
+			.lod 				= teapotLOD,
+			.depth 				= glm::distance(camera.position,glm::vec3(teapotTransform[3])),
+			.gpuZone 			= "GPU teapot"
+		});
+		occlusionCuller.Begin(projection*view);
+		occlusionCuller.RasterizeOccluder(houseTriangles,houseTransform);
+		occlusionCuller.BuildHierarchy(frameAllocator.Resource());
+		if(verify)
+			check(occlusionCuller.Verify(houseTriangles,houseTransform));
+
+		frustumCuller.Cull(Frustum::FromViewProjection(projection*view),renderQueue,&occlusionCuller,&sceneBVH);
+		PROFILE_COUNTER("Render items",renderQueue.items.size());
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP,textureManager.textures["skybox"]);
+		{
+			PROFILE_GPU_SCOPE(gpuProfiler,"GPU culling");
+			gpuCuller.Cull(shaderManager,glState,projection*view);
+		}
+		if(verify)
+			check(gpuCuller.Verify(glState));
 
-		shaderManager.UseShaderProgram("skybox");
-		for(const auto &variable : VPskybox)
-			shaderManager.SetVariable(variable);
+		renderQueue.Sort();
+		{
+			PROFILE_GPU_SCOPE(gpuProfiler,"GPU scene");
+			renderQueue.Execute(glState,modelManager,jobSystem);
+		}
 
-		glBindVertexArray(skyboxCube.vertexArrayID);
-		glDrawArrays(GL_TRIANGLES,0,skyboxCube.numberOfVertices);
-		glDepthFunc(GL_LESS); 
+		{
+			PROFILE_GPU_SCOPE(gpuProfiler,"GPU cube field");
+			cubeFieldMaterial.Upload();
+			glState.UseProgram(instancedProgram);
+			glState.BindBufferBase(cubeFieldMaterial.layout->bufferTarget,cubeFieldMaterial.layout->binding,cubeFieldMaterial.bufferID);
+			gpuCuller.Draw(shaderManager,glState);
+		}
+
+		if(!headless)
+		{
+			PROFILE_GPU_SCOPE(gpuProfiler,"GPU blit");
+			sceneFramebuffer.BlitToDefault(windowWidth,windowHeight);
+		}
+		else if(frameDriver.ShouldDump())
+		{
+			// an unwritten dump fails the run so scripted captures notice it
+			const bool saved = sceneFramebuffer.SaveColor(frameDriver.DumpPath());
+			check(saved);
+			if(saved && !frameDriver.compareDirectory.empty())
+				check(frameDriver.CompareDump());
+		}
+		{
+			PROFILE_GPU_SCOPE(gpuProfiler,"GPU Hi-Z");
+			gpuCuller.BuildHiZ(shaderManager,glState,sceneFramebuffer.depthTextureID,sceneFramebuffer.width,sceneFramebuffer.height);
+		}
+		gpuProfiler.EndFrame();
 		
     	// Reset for next frame
-    	glfwSwapBuffers(window);
-    	glfwPollEvents();
+		{
+			PROFILE_SCOPE("SwapBuffers"); // includes waiting for vsync, or for the GPU when headless
+			if(headless)
+				headlessContext.EndFrame();
+			else
+    			glfwSwapBuffers(window);
+		}
+		assetRegistry.EndFrame(modelManager,textureManager);
+		jobSystem.RunMainThreadJobs(); // GL work queued by jobs during the frame
+		if(!headless)
+    		glfwPollEvents();
+		frameDriver.Advance();
+
+		PROFILE_COUNTER("Frame arena bytes",frameAllocator.lastFrame.allocatedBytes);
+		PROFILE_FRAME();
   	}
 
+	if(headless)
+	{
+		glFinish();
+		frameDriver.PrintStatistics();
+	}
+	glState.PrintStatistics();
+	frustumCuller.PrintStatistics();
+	frameAllocator.PrintStatistics();
+	gpuProfiler.PrintStatistics();
+	Profiler::Get().PrintStatistics();
+	if(verify)
+		check(gpuProfiler.Verify());
+	if(verifiedChecks != 0)
+		std::cout << "Verification failed in " << failedChecks << " of " << verifiedChecks << " checks" << std::endl;
+	if(!tracePath.empty())
+		Profiler::Get().WriteTrace(tracePath);
+
+	renderQueue.Delete();
+	gpuProfiler.Delete();
+	gpuCuller.Delete();
+	sceneFramebuffer.Delete();
+
+	for(const ModelHandle model : loadedModels)
+		assetRegistry.ReleaseModel(model);
+	for(const TextureHandle texture : loadedTextures)
+		assetRegistry.ReleaseTexture(texture);
+	assetRegistry.Flush(modelManager,textureManager);
+
+	materialManager.DeleteAllMaterials();
 	shaderManager.DeleteAllShaderPrograms();
 	textureManager.DeleteAllTextures();
 	modelManager.DeleteAllModels();
+	fileReader.Stop();
 
-  	glfwTerminate();
-  	return 0;
+	if(headless)
+		headlessContext.Delete();
+	else
+  		glfwTerminate();
+  	return failedChecks == 0 ? 0 : -1;
 }
 
 void FramebufferResizeCB([[maybe_unused]] GLFWwindow *window, i32 width, i32 height)
@@ -444,6 +970,12 @@ void KeyPressedCB(GLFWwindow *window, i32 key, [[maybe_unused]] i32 scancode, i3
 			glfwSetInputMode(window,GLFW_CURSOR,Modes::mouseModes[Modes::currentMouseMode]);
 			break;
 
+		//picking with a ray from the center of the screen
+		case GLFW_KEY_P:
+			if(action == GLFW_PRESS)
+				Modes::pickRequested = true;
+			break;
+
 		//render mode switch 
 		case GLFW_KEY_TAB:
 			if(action == GLFW_PRESS)
@@ -453,8 +985,6 @@ void KeyPressedCB(GLFWwindow *window, i32 key, [[maybe_unused]] i32 scancode, i3
 				else
 					Modes::currentDrawMode++;
 			}
-			
-			glPolygonMode(GL_FRONT_AND_BACK,Modes::drawModes[Modes::currentDrawMode]);
 			break;
 	}
 }
@@ -0,0 +1,246 @@
+#include "profiler.hpp"
+
+#include <iomanip>
+
+Profiler::Profiler()
+{
+	this->startTicks = Ticks();
+	this->startTime  = std::chrono::steady_clock::now();
+}
+
+// First use on a thread, the buffer is kept after the thread exits so its last events can still be collected
+ProfileThreadBuffer &Profiler::RegisterThread()
+{
+	std::lock_guard lock(this->tracksMutex);
+	ProfileThreadBuffer &buffer = *this->buffers.emplace_back(std::make_unique<ProfileThreadBuffer>());
+	buffer.track = this->trackNames.size();
+	this->trackNames.push_back("Thread " + std::to_string(this->buffers.size() - 1));
+
+	threadBuffer = &buffer;
+	return buffer;
+}
+
+void Profiler::SetThreadName(const std::string &name)
+{
+	const u32 track = (threadBuffer ? threadBuffer : &RegisterThread())->track;
+
+	std::lock_guard lock(this->tracksMutex);
+	this->trackNames[track] = name;
+}
+
+// Track for events which aren't recorded by a thread (e.g. GPU timings), they're added with AddEvents
+u32 Profiler::AddTrack(const std::string &name)
+{
+	std::lock_guard lock(this->tracksMutex);
+	this->trackNames.push_back(name);
+	return this->trackNames.size() - 1;
+}
+
+// Events with timestamps in nanoseconds since the profiler's start and their track set, main thread only
+void Profiler::AddEvents(const std::vector<ProfileEvent> &events)
+{
+	for(const ProfileEvent &event : events)
+		Accumulate(event);
+}
+
+// The tick rate is measured over the whole run, so it gets more accurate the longer the profiler runs
+void Profiler::Calibrate()
+{
+	const u64 elapsedTicks = Ticks() - this->startTicks;
+	const f64 elapsedTime  = std::chrono::duration<f64,std::nano>(std::chrono::steady_clock::now() - this->startTime).count();
+	if(elapsedTicks != 0)
+		this->nanosecondsPerTick = elapsedTime/elapsedTicks;
+}
+
+// Ticks from before the start (e.g. read on a core with a slightly different TSC) are clamped to the start
+u64 Profiler::NanosecondsSinceStart(u64 ticks) const
+{
+	return ticks > this->startTicks ? static_cast<u64>((ticks - this->startTicks)*this->nanosecondsPerTick) : 0;
+}
+
+u64 Profiler::NanosecondsSinceStart(std::chrono::steady_clock::time_point time) const
+{
+	return time > this->startTime ? std::chrono::duration_cast<std::chrono::nanoseconds>(time - this->startTime).count() : 0;
+}
+
+// Records the frame marker, collects the events of every thread and starts a new frame of the statistics
+void Profiler::MarkFrame()
+{
+	Record(ProfileEvent{.name = "Frame",.begin = Ticks(),.end = 0,.value = 0.0,.type = FRAME_EVENT});
+	Calibrate();
+
+	{
+		std::lock_guard lock(this->tracksMutex);
+		for(const std::unique_ptr<ProfileThreadBuffer> &buffer : this->buffers)
+			Collect(*buffer);
+	}
+
+	const u32 slot = this->frames%ZoneStatistics::windowSize;
+	for(auto &[name,zone] : this->statistics)
+	{
+		zone.frameTimes[slot] = zone.currentTime;
+		zone.frameCalls[slot] = zone.currentCalls;
+		zone.currentCalls 	  = 0;
+		if(!zone.isCounter) // counters keep their last value
+			zone.currentTime = 0.0;
+	}
+	this->frames++;
+}
+
+// Copying races with the owning thread, which may overwrite the oldest events meanwhile. Events which
+// could have been overwritten during the copy are dropped
+void Profiler::Collect(ProfileThreadBuffer &buffer)
+{
+	const u64 written = buffer.written.load(std::memory_order_acquire);
+	const u64 first   = std::max(buffer.read,written > ProfileThreadBuffer::capacity ? written - ProfileThreadBuffer::capacity : 0);
+
+	this->collected.clear();
+	for(u64 i = first;i < written;i++)
+		this->collected.push_back(buffer.events[i & (ProfileThreadBuffer::capacity - 1)]);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const u64 writtenAfterCopy = buffer.written.load(std::memory_order_relaxed);
+	const u64 firstIntact 	   = std::max(first,writtenAfterCopy > ProfileThreadBuffer::capacity ? writtenAfterCopy - ProfileThreadBuffer::capacity : 0);
+
+	this->droppedEvents += firstIntact - buffer.read;
+	for(u64 i = firstIntact;i < written;i++)
+	{
+		ProfileEvent event = this->collected[i - first];
+		event.begin = NanosecondsSinceStart(event.begin);
+		event.end 	= event.type == ZONE_EVENT ? NanosecondsSinceStart(event.end) : event.begin;
+		event.track = buffer.track;
+		Accumulate(event);
+	}
+	buffer.read = written;
+}
+
+void Profiler::Accumulate(const ProfileEvent &event)
+{
+	if(event.type != FRAME_EVENT)
+	{
+		ZoneStatistics &zone = this->statistics[event.name];
+		zone.isCounter = event.type == COUNTER_EVENT;
+		zone.currentTime = zone.isCounter ? event.value : zone.currentTime + (event.end - event.begin)/1e6;
+		zone.currentCalls++;
+	}
+
+	if(!this->capturing)
+		return;
+	if(this->capturedEvents.size() == maximumCapturedEvents)
+	{
+		std::cout << "Profiler capture is full, the capture has been stopped." << std::endl;
+		this->capturing = false;
+		return;
+	}
+	this->capturedEvents.push_back(event);
+}
+
+void Profiler::StartCapture()
+{
+	this->capturedEvents.clear();
+	this->capturing = true;
+}
+
+void Profiler::StopCapture()
+{
+	this->capturing = false;
+}
+
+// Chrome trace event format: zones are complete ("X") events, which nest by time, counters are "C" events
+// and frame markers global instant events. Timestamps are in microseconds
+bool Profiler::WriteTrace(const std::string &path) const
+{
+	std::ofstream trace(path,std::ios::out | std::ios::trunc);
+	if(!trace.is_open())
+	{
+		std::cout << "Trace file at location: \"" << path << "\" could not be created!" << std::endl;
+		return false;
+	}
+
+	auto escaped = [](std::string_view text){
+		std::string result;
+		for(const char character : text)
+		{
+			if(character == '"' || character == '\\')
+				result += '\\';
+			result += character;
+		}
+		return result;
+	};
+
+	trace << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for(u32 track = 0;track < this->trackNames.size();track++)
+		trace << (track ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track
+			  << ",\"args\":{\"name\":\"" << escaped(this->trackNames[track]) << "\"}}";
+
+	for(const ProfileEvent &event : this->capturedEvents)
+	{
+		trace << ",\n{\"name\":\"" << escaped(event.name) << "\",\"pid\":1,\"tid\":" << event.track << ",\"ts\":" << event.begin/1e3;
+		switch(event.type)
+		{
+			case ZONE_EVENT:
+				trace << ",\"ph\":\"X\",\"dur\":" << (event.end - event.begin)/1e3 << '}';
+				break;
+			case COUNTER_EVENT:
+				trace << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+				break;
+			case FRAME_EVENT:
+				trace << ",\"ph\":\"i\",\"s\":\"g\"}";
+				break;
+		}
+	}
+	trace << "\n]}\n";
+
+	if(!trace)
+	{
+		std::cout << "Trace file at location: \"" << path << "\" could not be written!" << std::endl;
+		return false;
+	}
+	std::cout << "Wrote " << this->capturedEvents.size() << " profiler events to \"" << path << '"' << std::endl;
+	return true;
+}
+
+// Zones sorted by their average time per frame over the last frames, counters after them
+void Profiler::PrintStatistics() const
+{
+	const u32 windowFrames = std::min<u64>(this->frames,ZoneStatistics::windowSize);
+	if(windowFrames == 0 || this->statistics.empty())
+		return;
+
+	struct Row
+	{
+		std::string_view name;
+		f64 			 average;
+		f64 			 minimum;
+		f64 			 maximum;
+		f64 			 callsPerFrame;
+		bool 			 isCounter;
+	};
+	std::vector<Row> rows;
+	for(const auto &[name,zone] : this->statistics)
+	{
+		Row row = {.name = name,.average = 0.0,.minimum = zone.frameTimes[0],.maximum = zone.frameTimes[0],.callsPerFrame = 0.0,.isCounter = zone.isCounter};
+		for(u32 i = 0;i < windowFrames;i++)
+		{
+			row.average 	  += zone.frameTimes[i]/windowFrames;
+			row.minimum 	   = std::min(row.minimum,zone.frameTimes[i]);
+			row.maximum 	   = std::max(row.maximum,zone.frameTimes[i]);
+			row.callsPerFrame += static_cast<f64>(zone.frameCalls[i])/windowFrames;
+		}
+		rows.push_back(row);
+	}
+	std::sort(rows.begin(),rows.end(),[](const Row &a,const Row &b){
+		return a.isCounter != b.isCounter ? b.isCounter : a.average > b.average;
+	});
+
+	std::cout << "Profiler, last " << windowFrames << " frames (times in ms per frame):\n" << std::fixed << std::setprecision(3)
+			  << '\t' << std::left << std::setw(32) << "zone" << std::right << std::setw(12) << "average" << std::setw(12) << "min"
+			  << std::setw(12) << "max" << std::setw(14) << "calls/frame" << '\n';
+	for(const Row &row : rows)
+		std::cout << '\t' << std::left << std::setw(32) << (std::string(row.name) + (row.isCounter ? " (counter)" : "")) << std::right
+				  << std::setw(12) << row.average << std::setw(12) << row.minimum << std::setw(12) << row.maximum
+				  << std::setw(14) << row.callsPerFrame << '\n';
+	if(this->droppedEvents != 0)
+		std::cout << '\t' << this->droppedEvents << " events were overwritten before they could be collected\n";
+	std::cout << std::defaultfloat << std::flush;
+}
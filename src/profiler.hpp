@@ -0,0 +1,172 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+#endif
+
+#include "types.hpp"
+
+// Instrumentation compiles to nothing unless PROFILER_ENABLED is defined (see REQ in the makefile).
+// Names have to be string literals (or otherwise live forever), zones and counters are identified by them
+#if defined(PROFILER_ENABLED)
+	#define PROFILE_CONCATENATE_(a,b) 	a##b
+	#define PROFILE_CONCATENATE(a,b) 	PROFILE_CONCATENATE_(a,b)
+	#define PROFILE_SCOPE(name) 		ProfileScope PROFILE_CONCATENATE(profileScope,__LINE__)(name)
+	#define PROFILE_COUNTER(name,value) Profiler::Get().RecordCounter(name,value)
+	#define PROFILE_FRAME() 			Profiler::Get().MarkFrame()
+	#define PROFILE_THREAD(name) 		Profiler::Get().SetThreadName(name)
+	constexpr bool profilerEnabled = true;
+#else
+	#define PROFILE_SCOPE(name)
+	#define PROFILE_COUNTER(name,value) ((void)0)
+	#define PROFILE_FRAME() 			((void)0)
+	#define PROFILE_THREAD(name) 		((void)0)
+	constexpr bool profilerEnabled = false;
+#endif
+
+enum ProfileEventType : u32
+{
+	ZONE_EVENT,		// begin and end of a scope
+	COUNTER_EVENT,	// value at begin
+	FRAME_EVENT		// start of a new frame at begin
+};
+
+// Timestamps are in ticks of Profiler::Ticks while recorded, in nanoseconds since the profiler's start once collected
+struct ProfileEvent
+{
+	const char 		*name;
+	u64 			 begin;
+	u64 			 end;
+	f64 			 value;
+	ProfileEventType type;
+	u32 			 track = 0; // thread (or e.g. GPU queue) the event belongs to, set when collected
+};
+
+// Ring of the events of a single thread. Only the owning thread writes, without locks or atomic read-modify-writes.
+// The profiler copies the events out once per frame, events overwritten before that are dropped
+struct ProfileThreadBuffer
+{
+	static constexpr u64 capacity = 1 << 14; // power of 2
+
+	std::array<ProfileEvent,capacity> events;
+	std::atomic<u64> 				  written = 0; // events ever written
+	u64 							  read 	  = 0; // events ever collected, only used by the collecting thread
+	u32 							  track;
+
+	void Push(const ProfileEvent &event)
+	{
+		const u64 index = this->written.load(std::memory_order_relaxed);
+		this->events[index & (capacity - 1)] = event;
+		this->written.store(index + 1,std::memory_order_release);
+	}
+};
+
+// Per-frame totals of a zone (or the values of a counter) over the last windowSize frames
+struct ZoneStatistics
+{
+	static constexpr u32 windowSize = 120;
+
+	std::array<f64,windowSize> frameTimes = {}; // milliseconds, or the last value of a counter
+	std::array<u32,windowSize> frameCalls = {};
+	f64 					   currentTime  = 0.0;
+	u32 					   currentCalls = 0;
+	bool 					   isCounter 	= false;
+};
+
+// CPU profiler. Zones are recorded into per-thread ring buffers, MarkFrame (main thread, once per frame) collects
+// them into rolling per-zone statistics and, while capturing, into a trace which can be written in the Chrome
+// trace event format (chrome://tracing, ui.perfetto.dev). Timestamps come from the TSC on x86, calibrated
+// against steady_clock, and from steady_clock elsewhere
+struct Profiler
+{
+	static constexpr u64 maximumCapturedEvents = 1 << 22;
+
+	std::mutex 										  tracksMutex; // guards buffers and trackNames
+	std::vector<std::unique_ptr<ProfileThreadBuffer>> buffers;
+	std::vector<std::string> 						  trackNames;
+	u64 											  startTicks;
+	std::chrono::steady_clock::time_point 			  startTime;
+	f64 											  nanosecondsPerTick = 1.0;
+	u64 											  frames 			 = 0;
+	u64 											  droppedEvents 	 = 0;
+	std::unordered_map<std::string_view,ZoneStatistics> statistics;
+	bool 											  capturing = false;
+	std::vector<ProfileEvent> 						  capturedEvents;
+	std::vector<ProfileEvent> 						  collected; // scratch of Collect
+
+	inline static thread_local ProfileThreadBuffer *threadBuffer = nullptr;
+
+	Profiler();
+
+	static Profiler &Get()
+	{
+		static Profiler profiler;
+		return profiler;
+	}
+
+	static u64 Ticks()
+	{
+#if defined(__x86_64__) || defined(_M_X64)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	void Record(const ProfileEvent &event)
+	{
+		(threadBuffer ? threadBuffer : &RegisterThread())->Push(event);
+	}
+
+	void RecordCounter(const char *name,f64 value)
+	{
+		Record(ProfileEvent{.name = name,.begin = Ticks(),.end = 0,.value = value,.type = COUNTER_EVENT});
+	}
+
+	void SetThreadName(const std::string &name);
+	u32  AddTrack(const std::string &name);
+	void AddEvents(const std::vector<ProfileEvent> &events);
+	u64  NanosecondsSinceStart(u64 ticks) const;
+	u64  NanosecondsSinceStart(std::chrono::steady_clock::time_point time) const;
+
+	void MarkFrame();
+	void StartCapture();
+	void StopCapture();
+	bool WriteTrace(const std::string &path) const;
+	void PrintStatistics() const;
+
+	ProfileThreadBuffer &RegisterThread();
+	void 				 Calibrate();
+	void 				 Collect(ProfileThreadBuffer &buffer);
+	void 				 Accumulate(const ProfileEvent &event);
+};
+
+// Records a zone from its construction to the end of the scope, use PROFILE_SCOPE
+struct ProfileScope
+{
+	const char *name;
+	u64 		begin;
+
+	explicit ProfileScope(const char *name) : name(name),begin(Profiler::Ticks()) {}
+	~ProfileScope()
+	{
+		Profiler::Get().Record(ProfileEvent{.name = this->name,.begin = this->begin,.end = Profiler::Ticks(),.value = 0.0,.type = ZONE_EVENT});
+	}
+};
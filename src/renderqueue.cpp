@@ -0,0 +1,215 @@
+#include "renderqueue.hpp"
+
+void RenderQueue::Submit(const RenderItem &item)
+{
+	this->entries.push_back(RenderSortEntry{
+		.key 	   = MakeKey(item),
+		.itemIndex = static_cast<u32>(this->items.size())
+	});
+	this->items.push_back(item);
+}
+
+// Translucent world items are drawn after the skybox, since they don't write depth the skybox would cover them
+u32 RenderQueue::Pass(const RenderItem &item)
+{
+	switch(item.layer)
+	{
+		case LAYER_WORLD:   return item.translucent ? 2 : 0;
+		case LAYER_SKYBOX:  return 1;
+		case LAYER_OVERLAY: return 3;
+	}
+
+	return 3;
+}
+
+u64 RenderQueue::MakeKey(const RenderItem &item) const
+{
+	const u64 depthBits = (1ull << 24) - 1;
+	const u64 depth 	= static_cast<u64>(std::clamp(item.depth/this->farPlane,0.f,1.f)*depthBits);
+	const u64 program 	= item.programID & ((1ull << 10) - 1);
+	const u64 texture 	= item.textureID & ((1ull << 12) - 1);
+	const u64 mesh 		= (item.model->vertexArrayID & 0x1F) << 10 | (item.model->lods[item.lod].firstIndex & 0x3FF); // arena vertex array first, so it changes the least
+
+	u64 key = static_cast<u64>(Pass(item)) << 62 | static_cast<u64>(item.translucent) << 61;
+	if(item.translucent)
+		key |= (depthBits - depth) << 37 | program << 27 | texture << 15 | mesh;
+	else
+		key |= program << 51 | texture << 39 | mesh << 24 | depth;
+
+	return key;
+}
+
+// LSD radix sort over 8-bit digits, digits which are equal in all keys are skipped
+void RenderQueue::RadixSort(std::pmr::vector<RenderSortEntry> &entries,std::pmr::vector<RenderSortEntry> &scratch)
+{
+	scratch.resize(entries.size());
+
+	for(u32 shift = 0;shift < 64;shift += 8)
+	{
+		std::array<u32,256> histogram = {};
+		for(const RenderSortEntry &entry : entries)
+			histogram[(entry.key >> shift) & 0xFF]++;
+
+		if(histogram[(entries.front().key >> shift) & 0xFF] == entries.size()) // all keys share the digit
+			continue;
+
+		u32 sum = 0;
+		for(u32 &count : histogram)
+		{
+			const u32 bucketSize = count;
+			count = sum;
+			sum  += bucketSize;
+		}
+
+		for(const RenderSortEntry &entry : entries)
+			scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+
+		entries.swap(scratch);
+	}
+}
+
+void RenderQueue::Sort()
+{
+	PROFILE_SCOPE("RenderQueue::Sort");
+	if(this->entries.size() > 1)
+		RadixSort(this->entries,this->scratch);
+}
+
+// Items are batched if they're drawn with the same state, depth and blend state follow from layer and translucency
+bool RenderQueue::SameBatch(const RenderItem &first,const RenderItem &item)
+{
+	return item.batched && first.batched && item.programID == first.programID && item.textureTarget == first.textureTarget &&
+		   item.textureID == first.textureID && item.material == first.material && item.layer == first.layer &&
+		   item.translucent == first.translucent && item.model->vertexArrayID == first.model->vertexArrayID;
+}
+
+// Records every item with its full state, redundant state is filtered by the state cache during replay.
+// Materials are only read, their uploads have already been recorded by RecordUploads. Batches of the slice
+// are reused, so their buffers are only reallocated when a batch outgrows them
+void RenderQueue::RecordSlice(CommandBuffer &commandBuffer,std::deque<DrawBatch> &sliceBatches,u32 begin,u32 end,u32 defaultInstanceBufferID) const
+{
+	commandBuffer.Clear();
+	u32 usedBatches = 0;
+
+	for(u32 i = begin;i < end;)
+	{
+		const RenderItem &item = this->items[this->entries[i].itemIndex];
+		const Model &model = *item.model;
+		const ModelLOD &lod = model.lods[item.lod];
+		const bool timed = profilerEnabled && this->gpuProfiler && item.gpuZone;
+
+		if(timed)
+			commandBuffer.BeginGPUZone(item.gpuZone);
+		commandBuffer.SetDepthFunction(item.layer == LAYER_SKYBOX ? GL_LEQUAL : GL_LESS);
+		commandBuffer.SetDepthMask(!item.translucent);
+		commandBuffer.SetBlend(item.translucent);
+		if(item.translucent)
+			commandBuffer.SetBlendFunction(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+
+		commandBuffer.UseProgram(item.programID);
+		if(item.textureID != 0)
+			commandBuffer.BindTexture(0,item.textureTarget,item.textureID);
+
+		if(item.material)
+			commandBuffer.BindBufferBase(item.material->layout->bufferTarget,item.material->layout->binding,item.material->bufferID);
+
+		// the instance stream is part of the arena's vertex array, which is shared by every model of the arena, so it's
+		// bound for every item. Otherwise an unbatched item drawn with a program reading instance attributes would
+		// read the instances the previous batch (or the GPU culler) left bound, instead of the identity instance
+		commandBuffer.BindVertexArray(model.vertexArrayID);
+		u32 next = i + 1;
+		if(item.batched)
+		{
+			while(next < end && SameBatch(item,this->items[this->entries[next].itemIndex]))
+				next++;
+
+			if(usedBatches == sliceBatches.size())
+				sliceBatches.emplace_back();
+			DrawBatch &batch = sliceBatches[usedBatches++];
+			batch.Clear();
+			for(u32 j = i;j < next;j++)
+			{
+				const RenderItem &batchedItem = this->items[this->entries[j].itemIndex];
+				batch.Add(*batchedItem.model,batchedItem.lod,InstanceData{
+					.transform = batchedItem.transform,
+					.color 	   = glm::vec4(1.f)
+				});
+			}
+			commandBuffer.SubmitBatch(&batch); // binds its own instance stream
+		}
+		else
+		{
+			commandBuffer.BindInstanceBuffer(defaultInstanceBufferID,sizeof(InstanceData));
+			commandBuffer.DrawElements(lod.numberOfIndices,lod.firstIndex,model.baseVertex,0);
+		}
+
+		if(timed)
+			commandBuffer.EndGPUZone();
+		i = next;
+	}
+}
+
+// Serial pass on the submitting thread, writes the transforms into the materials and records the upload of every
+// changed material once, so the slices replayed after it all draw with this frame's blocks
+void RenderQueue::RecordUploads()
+{
+	this->uploadBuffer.Clear();
+	for(const RenderSortEntry &entry : this->entries)
+	{
+		const RenderItem &item = this->items[entry.itemIndex];
+		if(!item.material)
+			continue;
+
+		if(item.transformParameter != ~0u && !item.batched) // batched items pass their transforms as instances
+			item.material->Set(item.transformParameter,item.transform);
+		item.material->RecordUpload(this->uploadBuffer);
+	}
+}
+
+// Splits the sorted items into contiguous slices recorded in parallel, so the merged buffers keep the sorted order
+void RenderQueue::Record(const ModelManager &modelManager,JobSystem &jobSystem)
+{
+	PROFILE_SCOPE("RenderQueue::Record");
+	RecordUploads();
+
+	const u32 numberOfItems = this->entries.size();
+	const u32 slices 		= std::clamp(numberOfItems/minimumItemsPerSlice,1u,jobSystem.NumberOfWorkers());
+	const u32 slice  		= (numberOfItems + slices - 1)/slices;
+
+	this->commandBuffers.resize(std::max(static_cast<u32>(this->commandBuffers.size()),slices));
+	this->batches.resize(this->commandBuffers.size());
+	for(u32 i = slices;i < this->commandBuffers.size();i++) // buffers unused this frame mustn't be replayed
+		this->commandBuffers[i].Clear();
+
+	jobSystem.ParallelFor(slices,1,[this,slice,numberOfItems,&modelManager](u32 firstSlice,u32 endSlice){
+		for(u32 i = firstSlice;i < endSlice;i++)
+			RecordSlice(this->commandBuffers[i],this->batches[i],std::min(i*slice,numberOfItems),std::min((i + 1)*slice,numberOfItems),
+						modelManager.defaultInstanceBufferID);
+	});
+}
+
+void RenderQueue::Execute(GLState &glState,const ModelManager &modelManager,JobSystem &jobSystem)
+{
+	PROFILE_SCOPE("RenderQueue::Execute");
+	Record(modelManager,jobSystem);
+
+	this->uploadBuffer.Execute(glState,this->gpuProfiler);
+	for(const CommandBuffer &commandBuffer : this->commandBuffers)
+		commandBuffer.Execute(glState,this->gpuProfiler);
+}
+
+// The scratch buffer is rebound too, since the radix sort swaps it with the entries
+void RenderQueue::Clear(std::pmr::memory_resource *frameResource)
+{
+	RebindToFrame(this->items,frameResource);
+	RebindToFrame(this->entries,frameResource);
+	RebindToFrame(this->scratch,frameResource);
+}
+
+void RenderQueue::Delete()
+{
+	for(std::deque<DrawBatch> &sliceBatches : this->batches)
+		for(DrawBatch &batch : sliceBatches)
+			batch.Delete();
+	this->batches.clear();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <memory_resource>
+#include <array>
+#include <deque>
+#include <algorithm>
+
+#include <GLEW/glew.h>
+#include <glm/glm.hpp>
+
+#include "types.hpp"
+#include "modelmanager.hpp"
+#include "materialmanager.hpp"
+#include "glstate.hpp"
+#include "commandbuffer.hpp"
+#include "drawbatch.hpp"
+#include "framearena.hpp"
+#include "jobsystem.hpp"
+#include "profiler.hpp"
+#include "gpuprofiler.hpp"
+
+// Layers are drawn in order, regardless of the order in which the items were submitted
+enum RenderLayer : u32
+{
+	LAYER_WORLD,	// regular scene geometry
+	LAYER_SKYBOX,	// drawn after opaque world geometry with GL_LEQUAL, so it only fills the background
+	LAYER_OVERLAY	// drawn last, on top of everything
+};
+
+// Single draw submitted to the render queue
+struct RenderItem
+{
+	const Model *model;
+	u32 		 programID;
+	u32 		 textureTarget 		 = GL_TEXTURE_2D;
+	u32 		 textureID 			 = 0;	 // texture bound to unit 0, 0 if the item isn't textured
+	Material 	*material 			 = nullptr;
+	u32 		 transformParameter  = ~0u;	 // material parameter receiving the transform, ~0u if the transform isn't used
+	glm::mat4 	 transform 			 = glm::mat4(1.f);
+	RenderLayer  layer 				 = LAYER_WORLD;
+	bool 		 translucent 		 = false;
+	bool 		 batched 			 = false; // drawn through a DrawBatch, the program reads the transform from the instance attributes
+	u32 		 lod 				 = 0;	  // index into model->lods
+	f32 		 depth 				 = 0.f;	  // distance from the camera, used for front-to-back/back-to-front ordering
+	const char 	*gpuZone 			 = nullptr; // GPU profiler zone timing the item's draw, nullptr if it isn't timed
+};
+
+// Sort key with index of the item it belongs to
+struct RenderSortEntry
+{
+	u64 key;
+	u32 itemIndex;
+};
+
+// Collects draws during the frame, sorts them by a 64-bit key and submits them with minimal state changes.
+// Key layout, most significant bits first:
+//	opaque:      pass(2) | translucency(1) | program(10) | texture(12) | mesh(15) | depth(24)
+// where mesh is made of 5 bits of the arena vertex array and 10 bits of the first index
+//	translucent: pass(2) | translucency(1) | inverted depth(24) | program(10) | texture(12) | mesh(15)
+// Opaque items are drawn front to back for early depth rejection, translucent items back to front.
+// Names are truncated to their bit width, which can only make the ordering less optimal, never incorrect.
+// Sorted items are recorded into command buffers by jobs (each job records a contiguous slice),
+// the buffers are then replayed in order on the GL thread. Material blocks are written and uploaded by a serial
+// pass before the slices are recorded, which leaves materials read-only for the recording jobs. A material may
+// only be shared by items whose transform it doesn't receive, since it holds a single transform per frame.
+// Items and sort entries only live for one frame and are allocated from the frame resource passed to Clear.
+// Consecutive batched items drawn with the same state (program, texture, material and arena) are collected into
+// a DrawBatch and drawn by a single glMultiDrawElementsIndirect, their transforms are passed as instances.
+// Items with a gpuZone are timed by gpuProfiler if one is set, the zone only wraps the item's own commands
+// (a batch is timed with the zone of its first item)
+struct RenderQueue
+{
+	static constexpr u32 minimumItemsPerSlice = 512; // smaller slices aren't worth a job
+
+	std::pmr::vector<RenderItem> 	  items;
+	std::pmr::vector<RenderSortEntry> entries;
+	std::pmr::vector<RenderSortEntry> scratch; // second buffer of the radix sort
+	std::vector<CommandBuffer> 		  commandBuffers; // one per slice, reused between frames
+	std::vector<std::deque<DrawBatch>> batches; 	  // per slice, submitted by its command buffer, reused between frames
+	CommandBuffer 					  uploadBuffer;   // material uploads, replayed before the slices
+	f32 							  farPlane = 100.f; // depths are normalized to [0,farPlane]
+	GPUProfiler 					 *gpuProfiler = nullptr;
+
+	void Submit(const RenderItem &item);
+	void Sort();
+	void RecordUploads();
+	void Record(const ModelManager &modelManager,JobSystem &jobSystem);
+	void RecordSlice(CommandBuffer &commandBuffer,std::deque<DrawBatch> &sliceBatches,u32 begin,u32 end,u32 defaultInstanceBufferID) const;
+	void Execute(GLState &glState,const ModelManager &modelManager,JobSystem &jobSystem);
+	void Clear(std::pmr::memory_resource *frameResource = std::pmr::get_default_resource());
+	void Delete();
+
+	u64 		MakeKey(const RenderItem &item) const;
+	static u32  Pass(const RenderItem &item);
+	static bool SameBatch(const RenderItem &first,const RenderItem &item);
+	static void RadixSort(std::pmr::vector<RenderSortEntry> &entries,std::pmr::vector<RenderSortEntry> &scratch);
+};
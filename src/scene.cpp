@@ -0,0 +1,167 @@
+#include "scene.hpp"
+
+#if defined(__SSE__) || defined(_M_X64)
+	#include <immintrin.h>
+	#define SCENE_USE_SSE
+#endif
+
+u32 Scene::CreateNode(const SceneNodeInfo &nodeInfo)
+{
+	const u32 handle = this->nodeIndices.size();
+	const u32 index  = this->positions.size();
+
+	this->positions.push_back(nodeInfo.position);
+	this->rotations.push_back(nodeInfo.rotation);
+	this->scales.push_back(nodeInfo.scale);
+	this->parents.push_back(nodeInfo.parent == noParent ? noParent : this->nodeIndices[nodeInfo.parent]);
+	this->worldMatrices.push_back(glm::mat4(1.f));
+	this->dirty.push_back(true);
+	this->nodeHandles.push_back(handle);
+	this->nodeIndices.push_back(index);
+
+	return handle;
+}
+
+// Parent must not be a descendant of the node
+void Scene::SetParent(u32 node,u32 parent)
+{
+	const u32 index = this->nodeIndices[node];
+	this->parents[index] = parent == noParent ? noParent : this->nodeIndices[parent];
+	this->dirty[index] 	 = true;
+
+	if(parent != noParent && this->parents[index] > index) // parent would be updated after the child
+		this->unsorted = true;
+}
+
+void Scene::SetPosition(u32 node,const glm::vec3 &position)
+{
+	const u32 index = this->nodeIndices[node];
+	this->positions[index] = position;
+	this->dirty[index] 	   = true;
+}
+
+void Scene::SetRotation(u32 node,const glm::quat &rotation)
+{
+	const u32 index = this->nodeIndices[node];
+	this->rotations[index] = rotation;
+	this->dirty[index] 	   = true;
+}
+
+void Scene::SetScale(u32 node,const glm::vec3 &scale)
+{
+	const u32 index = this->nodeIndices[node];
+	this->scales[index] = scale;
+	this->dirty[index]  = true;
+}
+
+const glm::mat4 &Scene::GetWorldMatrix(u32 node) const
+{
+	return this->worldMatrices[this->nodeIndices[node]];
+}
+
+// Single pass over the arrays, dirtiness is inherited from the parent (which was already visited),
+// so only the subtrees below changed nodes are recomputed
+void Scene::UpdateTransforms()
+{
+	PROFILE_SCOPE("Scene::UpdateTransforms");
+	if(this->unsorted)
+		SortHierarchy();
+
+	const u32 numberOfNodes = this->positions.size();
+	const glm::mat4 identity(1.f);
+	u32 updatedNodes = 0;
+
+	for(u32 i = 0;i < numberOfNodes;i++)
+	{
+		const u32 parent = this->parents[i];
+		if(parent != noParent)
+			this->dirty[i] |= this->dirty[parent];
+
+		if(!this->dirty[i])
+			continue;
+
+		ComposeWorldMatrix(parent == noParent ? identity : this->worldMatrices[parent],
+						   this->positions[i],this->rotations[i],this->scales[i],this->worldMatrices[i]);
+		updatedNodes++;
+	}
+
+	std::memset(this->dirty.data(),0,this->dirty.size());
+	this->lastUpdatedNodes = updatedNodes;
+}
+
+// Reorders the arrays by depth in the hierarchy (stable, so siblings keep their relative order)
+void Scene::SortHierarchy()
+{
+	const u32 numberOfNodes = this->positions.size();
+
+	std::vector<u32> depths(numberOfNodes,0);
+	for(u32 i = 0;i < numberOfNodes;i++)
+		for(u32 parent = this->parents[i];parent != noParent;parent = this->parents[parent])
+			depths[i]++;
+
+	std::vector<u32> order(numberOfNodes);
+	for(u32 i = 0;i < numberOfNodes;i++)
+		order[i] = i;
+	std::stable_sort(order.begin(),order.end(),[&depths](u32 a,u32 b){
+		return depths[a] < depths[b];
+	});
+
+	std::vector<u32> newIndices(numberOfNodes); // old position -> new position
+	for(u32 i = 0;i < numberOfNodes;i++)
+		newIndices[order[i]] = i;
+
+	auto reorder = [&order](auto &array){
+		std::remove_reference_t<decltype(array)> sorted(array.size());
+		for(u32 i = 0;i < order.size();i++)
+			sorted[i] = array[order[i]];
+		array.swap(sorted);
+	};
+	reorder(this->positions);
+	reorder(this->rotations);
+	reorder(this->scales);
+	reorder(this->parents);
+	reorder(this->worldMatrices);
+	reorder(this->dirty);
+	reorder(this->nodeHandles);
+
+	for(u32 &parent : this->parents)
+		if(parent != noParent)
+			parent = newIndices[parent];
+	for(u32 i = 0;i < numberOfNodes;i++)
+		this->nodeIndices[this->nodeHandles[i]] = i;
+
+	this->unsorted = false;
+}
+
+// world = parent * T * R * S, the columns of T*R*S are the scaled rotation axes and the translation,
+// so every world column is a linear combination of the parent's columns
+void Scene::ComposeWorldMatrix(const glm::mat4 &parent,const glm::vec3 &position,const glm::quat &rotation,
+							   const glm::vec3 &scale,glm::mat4 &world)
+{
+	const glm::mat3 axes = glm::mat3_cast(rotation);
+	const std::array<glm::vec4,4> local = {
+		glm::vec4(axes[0]*scale.x,0.f),
+		glm::vec4(axes[1]*scale.y,0.f),
+		glm::vec4(axes[2]*scale.z,0.f),
+		glm::vec4(position,1.f)
+	};
+
+#ifdef SCENE_USE_SSE
+	const __m128 parent0 = _mm_loadu_ps(&parent[0][0]);
+	const __m128 parent1 = _mm_loadu_ps(&parent[1][0]);
+	const __m128 parent2 = _mm_loadu_ps(&parent[2][0]);
+	const __m128 parent3 = _mm_loadu_ps(&parent[3][0]);
+
+	for(u32 column = 0;column < 4;column++)
+	{
+		__m128 result = _mm_mul_ps(parent0,_mm_set1_ps(local[column].x));
+		result = _mm_add_ps(result,_mm_mul_ps(parent1,_mm_set1_ps(local[column].y)));
+		result = _mm_add_ps(result,_mm_mul_ps(parent2,_mm_set1_ps(local[column].z)));
+		result = _mm_add_ps(result,_mm_mul_ps(parent3,_mm_set1_ps(local[column].w)));
+		_mm_storeu_ps(&world[column][0],result);
+	}
+#else
+	for(u32 column = 0;column < 4;column++)
+		world[column] = parent*local[column];
+#endif
+}
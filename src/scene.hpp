@@ -0,0 +1,57 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <array>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "types.hpp"
+#include "profiler.hpp"
+
+// Contains information for creation of a scene node
+struct SceneNodeInfo
+{
+	u32 	  parent   = ~0u;				// node the transform is relative to, ~0u for root nodes
+	glm::vec3 position = glm::vec3(0.f);
+	glm::quat rotation = glm::quat(1.f,0.f,0.f,0.f);
+	glm::vec3 scale    = glm::vec3(1.f);
+};
+
+// Transform hierarchy stored as structure of arrays. Arrays are ordered so that every parent precedes
+// its children, which allows world matrices to be updated in a single linear pass. Nodes are referenced
+// by handles, which stay valid when the arrays are reordered
+struct Scene
+{
+	static constexpr u32 noParent = ~0u;
+
+	// indexed by position in the hierarchy order
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<u32> 	   parents;			// position of the parent in the arrays, noParent for roots
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<u8> 	   dirty;			// local transform changed since the last update
+	std::vector<u32> 	   nodeHandles;		// position -> handle
+
+	std::vector<u32> 	   nodeIndices;		// handle -> position
+	bool 				   unsorted = false; // a node was attached to a parent stored after it
+	u32 				   lastUpdatedNodes = 0; // number of world matrices recomputed by the last update
+
+	u32  CreateNode(const SceneNodeInfo &nodeInfo);
+	void SetParent(u32 node,u32 parent);
+	void SetPosition(u32 node,const glm::vec3 &position);
+	void SetRotation(u32 node,const glm::quat &rotation);
+	void SetScale(u32 node,const glm::vec3 &scale);
+
+	const glm::mat4 &GetWorldMatrix(u32 node) const;
+
+	void UpdateTransforms();
+	void SortHierarchy();
+
+	static void ComposeWorldMatrix(const glm::mat4 &parent,const glm::vec3 &position,const glm::quat &rotation,
+								   const glm::vec3 &scale,glm::mat4 &world);
+};
@@ -6,47 +6,79 @@ ShaderManager::~ShaderManager()
 	{
 		std::cout << "Not all shader mouldes have been manually deleted. "
 					 "Automatically deleting:" << std::endl;
-		for(const auto &[shaderName,shaderID] : this->shaderModules)
-		{
-			std::cout << '\t' << shaderName << std::endl;
-			glDeleteShader(shaderID);
-		}
+		for(const ShaderModule &shaderModule : this->shaderModules)
+			std::cout << '\t' << this->moduleNames.Name(shaderModule.name) << std::endl;
+		
+		for(const auto &[key,permutation] : this->permutations)
+			glDeleteShader(permutation.shaderID);
 	}
 	if(!this->shaderPrograms.empty())
 	{
 		std::cout << "Not all shader programs have been manually deleted. " 
 					 "Automatically deleting:" << std::endl;
-		for(const auto &[programName,programID] : this->shaderPrograms)
+		for(const ShaderProgram &program : this->shaderPrograms)
 		{
-			std::cout << '\t' << programName << std::endl;
-			glDeleteShader(programID);
+			std::cout << '\t' << this->programNames.Name(program.name) << std::endl;
+			glDeleteProgram(program.programID);
 		}
 	}
 }
 
+// Only registers the module, compilation is deferred until a program first links against it
 void ShaderManager::CreateShaderModule(const ShaderModuleInfo &moduleInfo)
 {
-	std::ifstream shaderFile(moduleInfo.pathToShader,std::ios::in | std::ios::binary);
-    
-    if(!shaderFile.is_open())
-    {
-        std::cout << "Shader file at location: \"" << moduleInfo.pathToShader 
-				  << "\" could not be opened!" << std::endl;
-        exit(-1);
-    }
+	this->moduleInfos.insert_or_assign(moduleInfo.name,moduleInfo);
+}
 
-    shaderFile.seekg(0,std::ios::end);
-    u32 fileLength = shaderFile.tellg();
-    shaderFile.seekg(0,std::ios::beg);
-    
-    std::string fileContent;
-	fileContent.reserve(fileLength + 1); // for '\0' character 
-    shaderFile.read(const_cast<char*>(fileContent.data()),fileLength);
-	fileContent[fileLength] = '\0';
+// Returns the compiled shader of the specified module, compiling its permutation if no other module shares it yet
+u32 ShaderManager::AcquireShaderModule(const std::string &moduleName)
+{
+	if(const ShaderModuleHandle compiled = this->moduleNames.Find(moduleName);!compiled.IsNull())
+		return this->shaderModules[compiled].shaderID;
+
+	const auto registered = this->moduleInfos.find(moduleName);
+	if(registered == this->moduleInfos.end())
+	{
+		std::cout << "Shader module \"" << moduleName << "\" has not been created!" << std::endl;
+		exit(-1);
+	}
+	const ShaderModuleInfo &moduleInfo = registered->second;
+
+	const std::string key = PermutationKey(moduleInfo);
+	if(auto cached = this->permutations.find(key);cached != this->permutations.end())
+	{
+		cached->second.users++;
+		AddShaderModule(moduleName,cached->second.shaderID,key);
+		return cached->second.shaderID;
+	}
+
+	u32 shaderID = 0;
+	if(!moduleInfo.pathToBinary.empty())
+		shaderID = LoadShaderBinary(moduleInfo);
+	if(shaderID == 0) // no binary was given or it couldn't be used
+		shaderID = CompileShaderSource(moduleInfo);
 
-    shaderFile.close();
-  
-    const char* contentLocation = fileContent.c_str();
+	this->permutations.insert(std::make_pair(key,ShaderPermutation{.shaderID = shaderID,.users = 1}));
+	AddShaderModule(moduleName,shaderID,key);
+
+	return shaderID;
+}
+
+void ShaderManager::AddShaderModule(const std::string &moduleName,u32 shaderID,const std::string &permutationKey)
+{
+	const ShaderModuleHandle handle = this->shaderModules.Insert(ShaderModule{
+		.shaderID 		= shaderID,
+		.permutationKey = permutationKey,
+		.name 			= ~0u
+	});
+	this->shaderModules[handle].name = this->moduleNames.Assign(moduleName,handle);
+}
+
+u32 ShaderManager::CompileShaderSource(const ShaderModuleInfo &moduleInfo) const
+{
+	std::vector<std::string> sourceFiles; // index of each file matches its #line source string number
+	const std::string source = PreprocessShaderSource(moduleInfo,sourceFiles);
+    const char* contentLocation = source.c_str();
 
     u32 shaderID = glCreateShader(moduleInfo.type);
     glShaderSource(shaderID,1,&contentLocation,NULL);
@@ -66,18 +98,255 @@ void ShaderManager::CreateShaderModule(const ShaderModuleInfo &moduleInfo)
         
         std::cout << "Invalid \"" << moduleInfo.pathToShader 
 				  << "\" contents:\n" << log << std::endl;
+		for(u32 i = 0;i < sourceFiles.size();i++)
+			std::cout << "\tsource string " << i << ": " << sourceFiles[i] << std::endl;
+        exit(-1);
+	}
+
+	return shaderID;
+}
+
+// Loads a SPIR-V module through ARB_gl_spirv (core in 4.6) and specializes it.
+// Returns 0 if SPIR-V isn't supported or the binary is missing, invalid or fails to specialize,
+// so the caller can fall back to GLSL
+u32 ShaderManager::LoadShaderBinary(const ShaderModuleInfo &moduleInfo) const
+{
+	if(!GLEW_VERSION_4_6 && !GLEW_ARB_gl_spirv)
+		return 0;
+
+	const FileData binaryFile = FileExists(moduleInfo.pathToBinary) ? ReadShaderFile(moduleInfo.pathToBinary) : FileData{};
+
+	if(!binaryFile.loaded)
+	{
+		std::cout << "SPIR-V file at location: \"" << moduleInfo.pathToBinary 
+				  << "\" could not be opened, falling back to GLSL source." << std::endl;
+		return 0;
+	}
+
+	const u64 fileLength = binaryFile.size;
+
+	std::vector<u32> binary(fileLength / sizeof(u32));
+	std::copy_n(binaryFile.bytes.get(),binary.size()*sizeof(u32),reinterpret_cast<u8*>(binary.data()));
+
+	const u32 spirvMagic = 0x07230203;
+	if(fileLength % sizeof(u32) != 0 || binary.empty() || binary[0] != spirvMagic)
+	{
+		std::cout << "File \"" << moduleInfo.pathToBinary << "\" doesn't contain a valid SPIR-V module, falling back to GLSL source." << std::endl;
+		return 0;
+	}
+
+	std::vector<u32> constantIDs;
+	std::vector<u32> constantValues;
+	for(const ShaderSpecialization &constant : moduleInfo.specializationConstants)
+	{
+		constantIDs.push_back(constant.constantID);
+		constantValues.push_back(constant.value);
+	}
+
+	u32 shaderID = glCreateShader(moduleInfo.type);
+	glShaderBinary(1,&shaderID,GL_SHADER_BINARY_FORMAT_SPIR_V_ARB,binary.data(),binary.size()*sizeof(u32));
+
+	if(GLEW_VERSION_4_6)
+		glSpecializeShader(shaderID,moduleInfo.entryPoint.c_str(),constantIDs.size(),constantIDs.data(),constantValues.data());
+	else
+		glSpecializeShaderARB(shaderID,moduleInfo.entryPoint.c_str(),constantIDs.size(),constantIDs.data(),constantValues.data());
+
+	i32 valid;
+	glGetShaderiv(shaderID,GL_COMPILE_STATUS,&valid);
+
+	if(!valid)
+	{
+		i32 logLength;
+		glGetShaderiv(shaderID,GL_INFO_LOG_LENGTH,&logLength);
+
+		std::string log;
+		log.resize(logLength);
+		glGetShaderInfoLog(shaderID,logLength,nullptr,const_cast<char*>(log.data()));
+
+		std::cout << "Specialization of \"" << moduleInfo.pathToBinary 
+				  << "\" failed, falling back to GLSL source:\n" << log << std::endl;
+		glDeleteShader(shaderID);
+		return 0;
+	}
+
+	return shaderID;
+}
+
+// Drops the module's reference to its permutation, the shader is deleted once no module uses it
+void ShaderManager::ReleaseShaderModule(const std::string &moduleName)
+{
+	this->moduleInfos.erase(moduleName);
+
+	const ShaderModuleHandle handle = this->moduleNames.Find(moduleName);
+	if(handle.IsNull()) // module was never compiled
+		return;
+	const ShaderModule &shaderModule = this->shaderModules[handle];
+
+	auto permutation = this->permutations.find(shaderModule.permutationKey);
+	if(--permutation->second.users == 0)
+	{
+		glDeleteShader(permutation->second.shaderID);
+		this->permutations.erase(permutation);
+	}
+
+	this->moduleNames.Remove(shaderModule.name);
+	this->shaderModules.Erase(handle);
+}
+
+// Key is made of stage, canonical source path, include directories and the sorted set of defines,
+// so the order in which defines are listed doesn't produce separate permutations
+std::string ShaderManager::PermutationKey(const ShaderModuleInfo &moduleInfo)
+{
+	std::vector<std::string> defines;
+	defines.reserve(moduleInfo.defines.size());
+	for(const ShaderDefine &define : moduleInfo.defines)
+		defines.push_back(define.name + '=' + define.value);
+	std::sort(defines.begin(),defines.end());
+
+	std::string key = std::to_string(moduleInfo.type) + '|' + 
+					  std::filesystem::weakly_canonical(moduleInfo.pathToShader).string() + '|';
+	for(const std::string &directory : moduleInfo.includeDirectories)
+		key += directory + ';';
+	key += '|';
+	for(const std::string &define : defines)
+		key += define + ';';
+	
+	key += '|' + moduleInfo.pathToBinary + '|' + moduleInfo.entryPoint + '|';
+	for(const ShaderSpecialization &constant : moduleInfo.specializationConstants)
+		key += std::to_string(constant.constantID) + '=' + std::to_string(constant.value) + ';';
+
+	return key;
+}
+
+// Shader files are looked up in the file reader's mounted archives before the loose files
+bool ShaderManager::FileExists(const std::filesystem::path &filePath) const
+{
+	return this->fileReader ? this->fileReader->Exists(filePath.string()) : std::filesystem::exists(filePath);
+}
+
+FileData ShaderManager::ReadShaderFile(const std::filesystem::path &filePath) const
+{
+	return this->fileReader ? this->fileReader->Read(filePath.string()) : FileReader::ReadFile(filePath.string());
+}
+
+// Resolves #include directives and injects the defines after the #version directive.
+// #line directives are emitted so that compiler errors point to the original file and line
+std::string ShaderManager::PreprocessShaderSource(const ShaderModuleInfo &moduleInfo,std::vector<std::string> &sourceFiles) const
+{
+	std::unordered_set<std::string> includeStack;
+	std::string source;
+	ExpandIncludes(moduleInfo.pathToShader,moduleInfo.includeDirectories,includeStack,sourceFiles,source);
+
+	std::string defines;
+	for(const ShaderDefine &define : moduleInfo.defines)
+		defines += "#define " + define.name + ' ' + define.value + '\n';
+	for(const ShaderSpecialization &constant : moduleInfo.specializationConstants) // see ShaderSpecialization
+		defines += "#define SPECIALIZATION_CONSTANT_" + std::to_string(constant.constantID) + ' ' + std::to_string(constant.value) + "u\n";
+
+	u64 versionInx = source.find("#version");
+	if(versionInx == std::string::npos) // no #version directive, defines can go to the very beginning
+	{
+		source.insert(0,defines + "#line 1 0\n");
+		return source;
+	}
+
+	const u64 versionLine = std::count(source.begin(),source.begin() + versionInx,'\n') + 1;
+	const u64 insertInx   = source.find('\n',versionInx) + 1;
+	source.insert(insertInx,defines + "#line " + std::to_string(versionLine + 1) + " 0\n");
+
+	return source;
+}
+
+void ShaderManager::ExpandIncludes(const std::filesystem::path &filePath,const std::vector<std::string> &includeDirectories,
+								   std::unordered_set<std::string> &includeStack,std::vector<std::string> &sourceFiles,std::string &output) const
+{
+	const FileData shaderFile = FileExists(filePath) ? ReadShaderFile(filePath) : FileData{};
+    
+    if(!shaderFile.loaded)
+    {
+        std::cout << "Shader file at location: \"" << filePath.string() 
+				  << "\" could not be opened!" << std::endl;
         exit(-1);
+    }
+
+	const std::string canonicalPath = std::filesystem::weakly_canonical(filePath).string();
+	if(!includeStack.insert(canonicalPath).second)
+	{
+		std::cout << "Shader file \"" << filePath.string() << "\" includes itself!" << std::endl;
+		exit(-1);
 	}
 
-	this->shaderModules.insert(std::make_pair(moduleInfo.name,shaderID));
+	const u32 sourceIndex = sourceFiles.size();
+	sourceFiles.push_back(filePath.string());
+
+	u32 lineNumber = 1;
+	for(std::string_view source = shaderFile.Text();!source.empty();lineNumber++)
+	{
+		const u64 			   lineEnd = source.find('\n');
+		const std::string_view line    = source.substr(0,lineEnd);
+		source.remove_prefix(lineEnd == std::string_view::npos ? source.size() : lineEnd + 1);
+
+		std::string_view directive = line;
+		directive.remove_prefix(std::min(directive.find_first_not_of(" \t"),directive.size()));
+
+		if(sourceIndex != 0 && directive.starts_with("#version")) // only the root file may specify the version
+		{
+			output += '\n';
+			continue;
+		}
+		if(directive.starts_with("#extension GL_GOOGLE_include_directive")) // only needed by offline compilers
+		{
+			output += '\n';
+			continue;
+		}
+		if(!directive.starts_with("#include"))
+		{
+			output += line;
+			output += '\n';
+			continue;
+		}
+
+		const u64 quoteFirst = directive.find('"');
+		const u64 quoteLast  = directive.rfind('"');
+		if(quoteFirst == std::string_view::npos || quoteFirst == quoteLast)
+		{
+			std::cout << "Malformed #include in \"" << filePath.string() << "\" on line " << lineNumber << std::endl;
+			exit(-1);
+		}
+		const std::string includeName(directive.substr(quoteFirst + 1,quoteLast - quoteFirst - 1));
+
+		std::filesystem::path includePath = filePath.parent_path() / includeName;
+		for(auto directory = includeDirectories.begin();
+			!FileExists(includePath) && directory != includeDirectories.end();directory++)
+			includePath = std::filesystem::path(*directory) / includeName;
+
+		if(!FileExists(includePath))
+		{
+			std::cout << "Included file \"" << includeName << "\" referenced in \"" << filePath.string() 
+					  << "\" on line " << lineNumber << " could not be found!" << std::endl;
+			exit(-1);
+		}
+
+		output += "#line 1 " + std::to_string(sourceFiles.size()) + '\n';
+		ExpandIncludes(includePath,includeDirectories,includeStack,sourceFiles,output);
+		output += "#line " + std::to_string(lineNumber + 1) + ' ' + std::to_string(sourceIndex) + '\n';
+	}
+
+	includeStack.erase(canonicalPath);
 }
 
-void ShaderManager::CreateShaderProgram(const ShaderProgramInfo &programInfo)
+ShaderProgramHandle ShaderManager::CreateShaderProgram(const ShaderProgramInfo &programInfo)
 {
+	if(!this->programNames.Find(programInfo.name).IsNull())
+	{
+		std::cout << "Shader program \"" << programInfo.name << "\" has already been created!" << std::endl;
+		exit(-1);
+	}
+
 	u32 programID = glCreateProgram();
 
 	for(const std::string &moduleName : programInfo.moduleNames)
-		glAttachShader(programID,shaderModules[moduleName]);
+		glAttachShader(programID,AcquireShaderModule(moduleName));
 
 	glLinkProgram(programID);
 
@@ -97,65 +366,95 @@ void ShaderManager::CreateShaderProgram(const ShaderProgramInfo &programInfo)
         exit(-1);
     }
 
+	glm::ivec3 workGroupSize(0);
+	for(const std::string &moduleName : programInfo.moduleNames)
+		if(this->moduleInfos.at(moduleName).type == GL_COMPUTE_SHADER)
+			glGetProgramiv(programID,GL_COMPUTE_WORK_GROUP_SIZE,glm::value_ptr(workGroupSize));
+
 	if(programInfo.deleteModules)
 		for(const std::string &moduleName : programInfo.moduleNames)
 		{
-			u32 shaderID = this->shaderModules[moduleName];
-			glDetachShader(programID,shaderID);
-			glDeleteShader(shaderID);
-			this->shaderModules.erase(moduleName);
+			glDetachShader(programID,this->shaderModules[this->moduleNames.Find(moduleName)].shaderID);
+			ReleaseShaderModule(moduleName);
 		}
 	else
 		for(const std::string &moduleName : programInfo.moduleNames)
-			glDetachShader(programID,this->shaderModules[moduleName]);
+			glDetachShader(programID,this->shaderModules[this->moduleNames.Find(moduleName)].shaderID);
 	
-	this->shaderPrograms.insert(std::make_pair(programInfo.name,programID));
+	const ShaderProgramHandle handle = this->shaderPrograms.Insert(ShaderProgram{
+		.programID 	   = programID,
+		.workGroupSize = glm::uvec3(workGroupSize),
+		.name 		   = ~0u
+	});
+	this->shaderPrograms[handle].name = this->programNames.Assign(programInfo.name,handle);
+
+	return handle;
+}
+
+// Meant for load time, unknown names are reported instead of returning program 0
+ShaderProgramHandle ShaderManager::GetShaderProgram(const std::string &programName) const
+{
+	const ShaderProgramHandle program = this->programNames.Find(programName);
+	if(program.IsNull())
+	{
+		std::cout << "Shader program \"" << programName << "\" hasn't been created!" << std::endl;
+		exit(-1);
+	}
+
+	return program;
 }
 
-void ShaderManager::UseShaderProgram(const std::string &programName)
+void ShaderManager::UseShaderProgram(ShaderProgramHandle program)
 {
-    glUseProgram(this->shaderPrograms[programName]);
+    glUseProgram(this->shaderPrograms[program].programID);
 }
 
 void ShaderManager::DeleteSelectedShaderModules(const std::vector<std::string> &moduleNames)
 {
 	for(const std::string &moduleName : moduleNames)
-	{
-		glDeleteShader(this->shaderModules[moduleName]);
-		this->shaderModules.erase(moduleName);
-	}
+		ReleaseShaderModule(moduleName);
 }
-void ShaderManager::DeleteSelectedShaderPrograms(const std::vector<std::string> &programNames)
+void ShaderManager::DeleteSelectedShaderPrograms(const std::vector<ShaderProgramHandle> &programs)
 {
-	for(const std::string &programName : programNames)
+	for(const ShaderProgramHandle program : programs)
 	{
-		glDeleteShader(this->shaderPrograms[programName]);
-		this->shaderPrograms.erase(programName);
+		glDeleteProgram(this->shaderPrograms[program].programID);
+		this->programNames.Remove(this->shaderPrograms[program].name);
+		this->shaderPrograms.Erase(program);
 	}
 }
 void ShaderManager::DeleteAllShaderModules()
 {
-	for(const auto &[shaderName,shaderID] : this->shaderModules)
-		glDeleteShader(shaderID);
+	for(const auto &[key,permutation] : this->permutations)
+		glDeleteShader(permutation.shaderID);
 
-	this->shaderModules.clear();
+	for(const ShaderModule &shaderModule : this->shaderModules)
+		this->moduleNames.Remove(shaderModule.name);
+
+	this->permutations.clear();
+	this->shaderModules.Clear();
+	this->moduleInfos.clear();
 }
 void ShaderManager::DeleteAllShaderPrograms()
 {
-	for(const auto &[programName,programID] : this->shaderPrograms)
-		glDeleteProgram(programID);
+	for(const ShaderProgram &program : this->shaderPrograms)
+	{
+		glDeleteProgram(program.programID);
+		this->programNames.Remove(program.name);
+	}
 
-	this->shaderPrograms.clear();
+	this->shaderPrograms.Clear();
 }
 
-i32 ShaderManager::GetUniformLocation(const std::string &programName,const std::string &variableName)
+i32 ShaderManager::GetUniformLocation(ShaderProgramHandle program,const std::string &variableName)
 {
-    i32 location = glGetUniformLocation(this->shaderPrograms[programName],variableName.c_str());
+	const ShaderProgram &shaderProgram = this->shaderPrograms[program];
+    i32 location = glGetUniformLocation(shaderProgram.programID,variableName.c_str());
 
     if(location == -1)
     {
         std::cout << "Variable \"" << variableName << "\" can't be found in the shader program \"" 
-				  << programName << "\"!" << std::endl;
+				  << this->programNames.Name(shaderProgram.name) << "\"!" << std::endl;
         exit(-1);
     }
 
@@ -164,30 +463,149 @@ i32 ShaderManager::GetUniformLocation(const std::string &programName,const std::
 
 void ShaderManager::SetVariable(const ShaderVariable<i32> &submission)
 {
-	glUniform1i(GetUniformLocation(submission.programName,submission.variableName),submission.newValue);
+	glUniform1i(GetUniformLocation(submission.program,submission.variableName),submission.newValue);
 }
 
 void ShaderManager::SetVariable(const ShaderVariable<f32> &submission)
 {
-	glUniform1f(GetUniformLocation(submission.programName,submission.variableName),submission.newValue);
+	glUniform1f(GetUniformLocation(submission.program,submission.variableName),submission.newValue);
 }
 
 void ShaderManager::SetVariable(const ShaderVariable<glm::vec2> &submission)
 {
-	glUniform2fv(GetUniformLocation(submission.programName,submission.variableName),1,glm::value_ptr(submission.newValue));
+	glUniform2fv(GetUniformLocation(submission.program,submission.variableName),1,glm::value_ptr(submission.newValue));
 }
 
 void ShaderManager::SetVariable(const ShaderVariable<glm::vec3> &submission)
 {
-	glUniform3fv(GetUniformLocation(submission.programName,submission.variableName),1,glm::value_ptr(submission.newValue));
+	glUniform3fv(GetUniformLocation(submission.program,submission.variableName),1,glm::value_ptr(submission.newValue));
 }
 
 void ShaderManager::SetVariable(const ShaderVariable<glm::vec4> &submission)
 {
-	glUniform4fv(GetUniformLocation(submission.programName,submission.variableName),1,glm::value_ptr(submission.newValue));
+	glUniform4fv(GetUniformLocation(submission.program,submission.variableName),1,glm::value_ptr(submission.newValue));
 }
 
 void ShaderManager::SetVariable(const ShaderVariable<glm::mat4> &submission)
 {
-	glUniformMatrix4fv(GetUniformLocation(submission.programName,submission.variableName),1,false,glm::value_ptr(submission.newValue));
-}
\ No newline at end of file
+	glUniformMatrix4fv(GetUniformLocation(submission.program,submission.variableName),1,false,glm::value_ptr(submission.newValue));
+}
+
+ComputeProgram ShaderManager::GetComputeProgram(ShaderProgramHandle program)
+{
+	const ShaderProgram &shaderProgram = this->shaderPrograms[program];
+	if(shaderProgram.workGroupSize == glm::uvec3(0))
+	{
+		std::cout << "Shader program \"" << this->programNames.Name(shaderProgram.name) << "\" doesn't contain a compute stage!" << std::endl;
+		exit(-1);
+	}
+
+	return ComputeProgram{
+		.programID 	   = shaderProgram.programID,
+		.workGroupSize = shaderProgram.workGroupSize
+	};
+}
+
+// Launches enough work groups to cover threadCount invocations, the program has to be in use.
+// consumerBarriers describe how the written data will be read (GL_*_BARRIER_BIT) and are only issued
+// once a consumer calls RequireMemoryBarrier
+void ShaderManager::DispatchCompute(const ComputeProgram &program,const glm::uvec3 &threadCount,u32 consumerBarriers)
+{
+	const glm::uvec3 groupCount = (threadCount + program.workGroupSize - 1u) / program.workGroupSize;
+	DispatchComputeGroups(groupCount,consumerBarriers);
+}
+
+void ShaderManager::DispatchComputeGroups(const glm::uvec3 &groupCount,u32 consumerBarriers)
+{
+	static glm::ivec3 maxGroupCount(0); // queried on first dispatch, the limit doesn't change during the context lifetime
+	if(maxGroupCount.x == 0)
+		for(u32 i = 0;i < 3;i++)
+			glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT,i,&maxGroupCount[i]);
+
+	if(glm::any(glm::greaterThan(groupCount,glm::uvec3(maxGroupCount))))
+	{
+		std::cout << "Dispatch of " << groupCount.x << " x " << groupCount.y << " x " << groupCount.z 
+				  << " work groups exceeds the implementation limit!" << std::endl;
+		exit(-1);
+	}
+
+	if(groupCount.x == 0 || groupCount.y == 0 || groupCount.z == 0)
+		return;
+
+	RequireMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); // previous dispatches may have written the inputs
+	glDispatchCompute(groupCount.x,groupCount.y,groupCount.z);
+	this->pendingBarriers |= consumerBarriers;
+}
+
+// Group counts are read from a DispatchIndirectCommand at offset in the buffer, e.g. written by a previous dispatch
+void ShaderManager::DispatchComputeIndirect(u32 bufferID,u64 offset,u32 consumerBarriers)
+{
+	RequireMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER,bufferID);
+	glDispatchComputeIndirect(static_cast<GLintptr>(offset));
+	this->pendingBarriers |= consumerBarriers;
+}
+
+// Issues the subset of pending barriers the consumer needs, nothing is issued if no dispatch wrote such data
+void ShaderManager::RequireMemoryBarrier(u32 barrierBits)
+{
+	const u32 barriers = this->pendingBarriers & barrierBits;
+	if(barriers == 0)
+		return;
+
+	glMemoryBarrier(barriers);
+	this->pendingBarriers &= ~barriers;
+}
+
+// Runs the program of assets/shaders/dispatchcheck.comp directly, with a thread count which isn't a multiple of
+// the work group size, and then indirectly with the command the direct dispatch wrote. Every invocation of both
+// passes has to run, and the barriers have to order the indirect pass after the writes of the direct one
+bool ShaderManager::VerifyDispatch(const ComputeProgram &program,GLState &glState)
+{
+	const u32 numberOfGroups = 5;
+	const u32 numberOfValues = numberOfGroups*program.workGroupSize.x;
+
+	std::array<u32,2> buffers;
+	glGenBuffers(buffers.size(),buffers.data());
+	const std::array<u32,4> dispatch = {}; // indirect command and invocation counter
+	glBindBuffer(GL_COPY_WRITE_BUFFER,buffers[0]);
+	glBufferData(GL_COPY_WRITE_BUFFER,numberOfValues*sizeof(u32),nullptr,GL_DYNAMIC_COPY);
+	glBindBuffer(GL_COPY_WRITE_BUFFER,buffers[1]);
+	glBufferData(GL_COPY_WRITE_BUFFER,sizeof(dispatch),dispatch.data(),GL_DYNAMIC_COPY);
+
+	glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER,0,buffers[0]);
+	glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER,1,buffers[1]);
+	glState.UseProgram(program.programID);
+
+	glProgramUniform1ui(program.programID,0,0);
+	DispatchCompute(program,glm::uvec3(numberOfValues - 1,1,1),GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	glProgramUniform1ui(program.programID,0,1);
+	DispatchComputeIndirect(buffers[1],0,GL_BUFFER_UPDATE_BARRIER_BIT);
+	RequireMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	std::vector<u32> values(numberOfValues);
+	std::array<u32,4> counters;
+	glBindBuffer(GL_COPY_READ_BUFFER,buffers[0]);
+	glGetBufferSubData(GL_COPY_READ_BUFFER,0,numberOfValues*sizeof(u32),values.data());
+	glBindBuffer(GL_COPY_READ_BUFFER,buffers[1]);
+	glGetBufferSubData(GL_COPY_READ_BUFFER,0,sizeof(counters),counters.data());
+
+	glDeleteBuffers(buffers.size(),buffers.data());
+	glState.OnDelete(GL_BUFFER,buffers[0]);
+	glState.OnDelete(GL_BUFFER,buffers[1]);
+
+	bool valid = counters[0] == numberOfGroups && counters[1] == 1 && counters[2] == 1 && counters[3] == 2*numberOfValues;
+	if(!valid)
+		std::cout << "Compute dispatches wrote the indirect command " << counters[0] << " x " << counters[1] << " x " << counters[2]
+				  << " and ran " << counters[3] << " invocations, expected " << numberOfGroups << " x 1 x 1 and " << 2*numberOfValues << '!' << std::endl;
+
+	for(u32 i = 0;valid && i < numberOfValues;i++)
+		if(values[i] != 3*i + 1)
+		{
+			std::cout << "Compute dispatches wrote " << values[i] << " to value " << i << ", expected " << 3*i + 1 << '!' << std::endl;
+			valid = false;
+		}
+
+	return valid;
+}
@@ -3,23 +3,85 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <filesystem>
 
 #include <GLEW/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "types.hpp"
+#include "handle.hpp"
+#include "filereader.hpp"
+#include "glstate.hpp"
+
+// Preprocessor definition injected into shader source right after the #version directive
+struct ShaderDefine
+{
+	std::string name;	// macro name (e.g. "TEXTURED")
+	std::string value;	// macro value, may be left empty
+};
+
+// Value of a SPIR-V specialization constant (layout(constant_id = ...) in GLSL). constant_id isn't allowed when
+// GLSL is compiled directly, there the value is defined as SPECIALIZATION_CONSTANT_<constantID> (a uint literal),
+// so shaders built both ways declare their constants as:
+//	#ifdef GL_SPIRV
+//		layout(constant_id = 0) const uint tileSize = 16;
+//	#elif defined(SPECIALIZATION_CONSTANT_0)
+//		const uint tileSize = SPECIALIZATION_CONSTANT_0;
+//	#else
+//		const uint tileSize = 16;
+//	#endif
+struct ShaderSpecialization
+{
+	u32 constantID; // constant_id the value is assigned to
+	u32 value;		// raw 32 bits of the value, floats should be passed through std::bit_cast (uintBitsToFloat on the GLSL path)
+};
 
 // Contains information for createion of shader modules
 struct ShaderModuleInfo 
 {
-	std::string name; 			// name used to reference the created module
-	std::string pathToShader; 	// path to file containing shader source code
-	u32 		type; 			// shader stage (vertex, fragment, ...) 
+	std::string 					  name; 						// name used to reference the created module
+	std::string 					  pathToShader; 				// path to file containing shader source code
+	u32 							  type; 						// shader stage (vertex, fragment, ...) 
+	std::vector<ShaderDefine> 		  defines = {};					// definitions selecting the shader permutation
+	std::vector<std::string>  		  includeDirectories = {};		// searched for #include "..." files after the including file's directory
+	std::string 					  pathToBinary = "";			// path to offline compiled SPIR-V, used instead of the source when ARB_gl_spirv is supported
+	std::string 					  entryPoint = "main";			// SPIR-V entry point
+	std::vector<ShaderSpecialization> specializationConstants = {}; // values of SPIR-V specialization constants
+};
+
+// Compiled shader module shared by every module name referring to the same (source,defines) pair
+struct ShaderPermutation
+{
+	u32 shaderID;	// name of the compiled OpenGL shader object
+	u32 users;		// number of module names currently referencing this permutation
+};
+
+// Compiled module, its shader object is shared with every other module of the same permutation
+struct ShaderModule
+{
+	u32 		shaderID;		// name of the compiled OpenGL shader object
+	std::string permutationKey; // key of the permutation in ShaderManager::permutations
+	u32 		name;			// id in ShaderManager::moduleNames
+};
+
+using ShaderModuleHandle = Handle<ShaderModule>;
+
+struct ShaderProgram
+{
+	u32 	   programID;		// name of the linked OpenGL program
+	glm::uvec3 workGroupSize;	// local size of the compute stage, 0 if the program has none
+	u32 	   name;			// id in ShaderManager::programNames
 };
 
+using ShaderProgramHandle = Handle<ShaderProgram>;
+
 // Contains information for createion of shader programs
 struct ShaderProgramInfo
 {
@@ -32,25 +94,49 @@ struct ShaderProgramInfo
 template<typename T>
 struct ShaderVariable
 {
-	std::string programName;
-	std::string variableName;
+	ShaderProgramHandle program;
+	std::string 		variableName;
 	T 			newValue;
 };
 
-// Manages shader programs and their creation 
+// Compute program resolved once, so dispatches don't need any lookups
+struct ComputeProgram
+{
+	u32 	   programID;		// name of the linked OpenGL program
+	glm::uvec3 workGroupSize;	// local size declared in the compute shader (layout(local_size_x = ...) in;)
+};
+
+// Layout of a GL_DISPATCH_INDIRECT_BUFFER entry, as consumed by glDispatchComputeIndirect
+struct DispatchIndirectCommand
+{
+	u32 numGroupsX;
+	u32 numGroupsY;
+	u32 numGroupsZ;
+};
+
+// Manages shader programs and their creation. Programs and compiled modules are referenced by handles,
+// names are only resolved at load time
 struct ShaderManager
 {
-	std::unordered_map<std::string,u32> shaderModules;
-	std::unordered_map<std::string,u32> shaderPrograms;
+	std::unordered_map<std::string,ShaderModuleInfo>  moduleInfos;		// registered modules, compiled on first use
+	SlotMap<ShaderModule> 							  shaderModules;	// modules which have already been compiled
+	ResourceNames<ShaderModule> 					  moduleNames;
+	std::unordered_map<std::string,ShaderPermutation> permutations;		// permutation cache keyed by (source,defines)
+	SlotMap<ShaderProgram> 							  shaderPrograms;
+	ResourceNames<ShaderProgram> 					  programNames;
+
+	u32 		pendingBarriers = 0; 	   // barriers required by the consumers of data written by previous dispatches
+	FileReader *fileReader 		= nullptr; // reads sources and binaries (from mounted archives first) when set
 
 	~ShaderManager();
 	
-	void CreateShaderModule(const ShaderModuleInfo &moduleInfo);
-	void CreateShaderProgram(const ShaderProgramInfo &programInfo);
-    void UseShaderProgram(const std::string &programName);
+	void 				CreateShaderModule(const ShaderModuleInfo &moduleInfo);
+	ShaderProgramHandle CreateShaderProgram(const ShaderProgramInfo &programInfo);
+	ShaderProgramHandle GetShaderProgram(const std::string &programName) const;
+    void 				UseShaderProgram(ShaderProgramHandle program);
 
 	void DeleteSelectedShaderModules(const std::vector<std::string> &moduleNames);
-	void DeleteSelectedShaderPrograms(const std::vector<std::string> &programNames);
+	void DeleteSelectedShaderPrograms(const std::vector<ShaderProgramHandle> &programs);
 	void DeleteAllShaderModules();
 	void DeleteAllShaderPrograms();
 
@@ -61,5 +147,26 @@ struct ShaderManager
 	void SetVariable(const ShaderVariable<glm::vec4> &submission);
 	void SetVariable(const ShaderVariable<glm::mat4> &submission);
 
-	i32 GetUniformLocation(const std::string &programName,const std::string &variableName);
+	i32 GetUniformLocation(ShaderProgramHandle program,const std::string &variableName);
+
+	ComputeProgram GetComputeProgram(ShaderProgramHandle program);
+	void 		   DispatchCompute(const ComputeProgram &program,const glm::uvec3 &threadCount,u32 consumerBarriers);
+	void 		   DispatchComputeGroups(const glm::uvec3 &groupCount,u32 consumerBarriers);
+	void 		   DispatchComputeIndirect(u32 bufferID,u64 offset,u32 consumerBarriers);
+	void 		   RequireMemoryBarrier(u32 barrierBits);
+	bool 		   VerifyDispatch(const ComputeProgram &program,GLState &glState);
+
+	u32  AcquireShaderModule(const std::string &moduleName);
+	void AddShaderModule(const std::string &moduleName,u32 shaderID,const std::string &permutationKey);
+	void ReleaseShaderModule(const std::string &moduleName);
+	
+	bool 		FileExists(const std::filesystem::path &filePath) const;
+	FileData 	ReadShaderFile(const std::filesystem::path &filePath) const;
+	u32 		CompileShaderSource(const ShaderModuleInfo &moduleInfo) const;
+	u32 		LoadShaderBinary(const ShaderModuleInfo &moduleInfo) const;
+	std::string PreprocessShaderSource(const ShaderModuleInfo &moduleInfo,std::vector<std::string> &sourceFiles) const;
+	void 		ExpandIncludes(const std::filesystem::path &filePath,const std::vector<std::string> &includeDirectories,
+							   std::unordered_set<std::string> &includeStack,std::vector<std::string> &sourceFiles,std::string &output) const;
+
+	static std::string PermutationKey(const ShaderModuleInfo &moduleInfo);
 };
\ No newline at end of file
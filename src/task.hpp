@@ -0,0 +1,126 @@
+#pragma once
+
+#include <iostream>
+#include <coroutine>
+#include <optional>
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include "types.hpp"
+#include "jobsystem.hpp"
+
+// Result of a coroutine which moves between the threads of a job system. The coroutine starts right away on
+// the calling thread and runs until its first co_await. The result can be awaited by one other coroutine, or
+// polled with IsReady and waited for with Wait. A task mustn't be destroyed before it has finished
+template<typename T>
+struct Task
+{
+	struct promise_type
+	{
+		std::optional<T>   result;
+		std::atomic<void*> continuation = nullptr; // coroutine awaiting the result, finishedMarker once the result is set
+
+		static void *FinishedMarker() { return reinterpret_cast<void*>(1); }
+
+		Task 				get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_never 	initial_suspend() noexcept { return {}; }
+		void 				return_value(T value) { this->result = std::move(value); }
+		void 				unhandled_exception() { std::terminate(); }
+
+		// Suspends, so the frame (and the result in it) is kept until the task is destroyed
+		auto final_suspend() noexcept
+		{
+			struct FinalAwaiter
+			{
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept
+				{
+					void *continuation = coroutine.promise().continuation.exchange(FinishedMarker(),std::memory_order_acq_rel);
+					if(continuation)
+						return std::coroutine_handle<>::from_address(continuation);
+					return std::noop_coroutine();
+				}
+				void await_resume() noexcept {}
+			};
+
+			return FinalAwaiter{};
+		}
+	};
+
+	std::coroutine_handle<promise_type> coroutine;
+
+	explicit Task(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+	Task(Task &&task) noexcept : coroutine(std::exchange(task.coroutine,nullptr)) {}
+	Task(const Task&) = delete;
+	Task &operator=(const Task&) = delete;
+
+	~Task()
+	{
+		if(!this->coroutine)
+			return;
+
+		if(!IsReady())
+		{
+			std::cout << "Task has been destroyed before it finished!" << std::endl;
+			exit(-1);
+		}
+		this->coroutine.destroy();
+	}
+
+	bool IsReady() const
+	{
+		return this->coroutine.promise().continuation.load(std::memory_order_acquire) == promise_type::FinishedMarker();
+	}
+
+	// Runs other jobs until the task has finished, on the main thread this includes the task's main thread steps
+	T &Wait(JobSystem &jobSystem)
+	{
+		while(!IsReady())
+			if(!jobSystem.RunPendingJob())
+				std::this_thread::yield();
+
+		return *this->coroutine.promise().result;
+	}
+
+	// co_await task resumes the awaiting coroutine on the thread which finishes the task
+	bool await_ready() const { return IsReady(); }
+	bool await_suspend(std::coroutine_handle<> awaiting)
+	{
+		void *expected = nullptr;
+		return this->coroutine.promise().continuation.compare_exchange_strong(expected,awaiting.address(),std::memory_order_acq_rel);
+	}
+	T &await_resume() { return *this->coroutine.promise().result; }
+};
+
+// co_await ResumeOnWorker{jobSystem} continues the coroutine in a job, for file I/O, parsing and decoding
+struct ResumeOnWorker
+{
+	JobSystem &jobSystem;
+
+	bool await_ready() const { return false; }
+	void await_suspend(std::coroutine_handle<> coroutine) { this->jobSystem.Schedule([coroutine](){ coroutine.resume(); }); }
+	void await_resume() const {}
+};
+
+// co_await ResumeOnMainThread{jobSystem} continues the coroutine on the main thread, for GL calls and
+// changes to the managers. Doesn't suspend when already on the main thread
+struct ResumeOnMainThread
+{
+	JobSystem &jobSystem;
+
+	bool await_ready() const { return this->jobSystem.IsMainThread(); }
+	void await_suspend(std::coroutine_handle<> coroutine) { this->jobSystem.ScheduleOnMainThread([coroutine](){ coroutine.resume(); }); }
+	void await_resume() const {}
+};
+
+// co_await YieldToMainThread{jobSystem} continues the coroutine with the next batch of main thread jobs,
+// e.g. to poll for something another coroutine is doing
+struct YieldToMainThread
+{
+	JobSystem &jobSystem;
+
+	bool await_ready() const { return false; }
+	void await_suspend(std::coroutine_handle<> coroutine) { this->jobSystem.ScheduleOnMainThread([coroutine](){ coroutine.resume(); }); }
+	void await_resume() const {}
+};
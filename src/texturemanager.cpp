@@ -9,55 +9,194 @@ TextureManager::~TextureManager()
 	{
 		std::cout << "Not all textures have been manually deleted. " 
 					 "Automatically deleting:" << std::endl;
-		for(const auto &[textureName,texture] : this->textures)
-			std::cout << '\t' << textureName << std::endl;
+		for(const Texture &texture : this->textures)
+			std::cout << '\t' << this->textureNames.Name(texture.name) << std::endl;
 		
 		DeleteAllTextures();
 	}
 }
 
-void TextureManager::CreateTextureFromImage(const TextureInfo &textureInfo)
+// stb_image's flip setting is global, so images are flipped after decoding, which keeps decoding thread safe.
+// A file which couldn't be read has already been reported by the file reader
+bool TextureManager::DecodeImage(const std::string &pathToImage,const FileData &imageFile,Image &image,bool flipVertically)
 {
-	stbi_set_flip_vertically_on_load(true);
+	PROFILE_SCOPE("TextureManager::DecodeImage");
+	if(!imageFile.loaded)
+		return false;
 
+	image.pixels = stbi_load_from_memory(imageFile.bytes.get(),imageFile.size,&image.width,&image.height,&image.numChannels,0);
+	if(!image.pixels)
+	{
+		std::cout << "Image data could not be loaded from \"" << pathToImage << "\"!" << std::endl;
+		return false;
+	}
+
+	if(flipVertically)
+	{
+		const u64 rowSize = static_cast<u64>(image.width)*image.numChannels;
+		for(i32 top = 0,bottom = image.height - 1;top < bottom;top++,bottom--)
+			std::swap_ranges(image.pixels + top*rowSize,image.pixels + (top + 1)*rowSize,image.pixels + bottom*rowSize);
+	}
+
+	return true;
+}
+
+// Faces are read (unless they have been read already) and decoded by jobs when the manager has a job system.
+// Nothing is kept if any face fails
+bool TextureManager::DecodeCubemap(const CubemapTextureInfo &cubemapInfo,const std::array<FileData,6> *faceFiles,std::array<Image,6> &faces) const
+{
+	std::array<bool,6> decoded;
+	auto decode = [&](u32 begin,u32 end){
+		for(u32 i = begin;i < end;i++)
+		{
+			const std::string &path = cubemapInfo.pathsToImages[i];
+			decoded[i] = faceFiles ? DecodeImage(path,(*faceFiles)[i],faces[i],false) :
+									 DecodeImage(path,ReadImageFile(path),faces[i],false);
+		}
+	};
+	if(this->jobSystem)
+		this->jobSystem->ParallelFor(faces.size(),1,decode);
+	else
+		decode(0,faces.size());
+
+	if(std::find(decoded.begin(),decoded.end(),false) == decoded.end())
+		return true;
+
+	for(Image &face : faces)
+		FreeImage(face);
+	return false;
+}
+
+FileData TextureManager::ReadImageFile(const std::string &pathToImage) const
+{
+	return this->fileReader ? this->fileReader->Read(pathToImage) : FileReader::ReadFile(pathToImage);
+}
+
+void TextureManager::FreeImage(Image &image)
+{
+	stbi_image_free(image.pixels);
+	image.pixels = nullptr;
+}
+
+TextureHandle TextureManager::CreateTextureFromImage(const TextureInfo &textureInfo)
+{
+	Image image;
+	if(!DecodeImage(textureInfo.pathToImage,ReadImageFile(textureInfo.pathToImage),image,true))
+		exit(-1);
+
+	const TextureHandle texture = UploadTexture(textureInfo.name,image);
+	FreeImage(image);
+
+	return texture;
+}
+
+// pathsToImages names must be in the right order (+X,-X,+Y,-Y,+Z,-Z)
+TextureHandle TextureManager::CreateCubemapFromImages(const CubemapTextureInfo &cubemapInfo)
+{
+	std::array<Image,6> faces;
+	if(!DecodeCubemap(cubemapInfo,nullptr,faces))
+		exit(-1);
+
+	const TextureHandle texture = UploadCubemap(cubemapInfo.name,faces);
+	for(Image &face : faces)
+		FreeImage(face);
+
+	return texture;
+}
+
+// The file is read through the file reader (if set, otherwise in a job), decoding runs in a job and the upload
+// on the main thread. Failures (including a name which is already used) are reported and result in a null handle
+Task<TextureHandle> TextureManager::LoadTextureAsync(TextureInfo textureInfo)
+{
+	FileData imageFile;
+	if(this->fileReader)
+		imageFile = std::move(co_await this->fileReader->ReadAsync(textureInfo.pathToImage));
+	else
+	{
+		co_await ResumeOnWorker{*this->jobSystem};
+		imageFile = FileReader::ReadFile(textureInfo.pathToImage);
+	}
+
+	Image image;
+	const bool decoded = DecodeImage(textureInfo.pathToImage,imageFile,image,true);
+
+	co_await ResumeOnMainThread{*this->jobSystem};
+	if(!decoded)
+		co_return TextureHandle{};
+	if(!this->textureNames.Find(textureInfo.name).IsNull())
+	{
+		std::cout << "Texture \"" << textureInfo.name << "\" has already been created!" << std::endl;
+		FreeImage(image);
+		co_return TextureHandle{};
+	}
+
+	const TextureHandle texture = UploadTexture(textureInfo.name,image);
+	FreeImage(image);
+	co_return texture;
+}
+
+// All six faces are read at once
+Task<TextureHandle> TextureManager::LoadCubemapAsync(CubemapTextureInfo cubemapInfo)
+{
+	std::array<FileData,6> faceFiles;
+	if(this->fileReader)
+	{
+		std::vector<Task<FileData>> reads;
+		for(const std::string &path : cubemapInfo.pathsToImages)
+			reads.push_back(this->fileReader->ReadAsync(path));
+		for(u32 i = 0;i < faceFiles.size();i++)
+			faceFiles[i] = std::move(co_await std::move(reads[i]));
+	}
+	else
+		co_await ResumeOnWorker{*this->jobSystem};
+
+	std::array<Image,6> faces;
+	const bool decoded = DecodeCubemap(cubemapInfo,this->fileReader ? &faceFiles : nullptr,faces);
+
+	co_await ResumeOnMainThread{*this->jobSystem};
+	if(!decoded)
+		co_return TextureHandle{};
+	if(!this->textureNames.Find(cubemapInfo.name).IsNull())
+	{
+		std::cout << "Texture \"" << cubemapInfo.name << "\" has already been created!" << std::endl;
+		for(Image &face : faces)
+			FreeImage(face);
+		co_return TextureHandle{};
+	}
+
+	const TextureHandle texture = UploadCubemap(cubemapInfo.name,faces);
+	for(Image &face : faces)
+		FreeImage(face);
+	co_return texture;
+}
+
+TextureHandle TextureManager::UploadTexture(const std::string &textureName,const Image &image)
+{
+	PROFILE_SCOPE("TextureManager::UploadTexture");
     u32 textureID;
 
     glGenTextures(1,&textureID);
-    glBindTexture(GL_TEXTURE_2D,textureID);
+    BindTexture(GL_TEXTURE_2D,textureID);
 
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
 
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-
-    i32 width,height,numChannels;
-
-    u8 *imageData = stbi_load(textureInfo.pathToImage.c_str(),&width,&height,&numChannels,0);
-
-    if(!imageData)
-    {
-        std::cout << "Image data could not be loaded from \"" << textureInfo.pathToImage << "\"!" << std::endl;
-        exit(-1);
-    }
     
-    glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,width,height,0,GL_RGB,GL_UNSIGNED_BYTE,imageData);
+    glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,image.width,image.height,0,GL_RGB,GL_UNSIGNED_BYTE,image.pixels);
     glGenerateMipmap(GL_TEXTURE_2D);
 
-    stbi_image_free(imageData);
-
-    this->textures.insert(std::make_pair(textureInfo.name,textureID));  
+    return AddTexture(textureName,textureID,GL_TEXTURE_2D);
 }
 
-// pathsToImages names must be in the right order (+X,-X,+Y,-Y,+Z,-Z)
-void TextureManager::CreateCubemapFromImages(const CubemapTextureInfo &cubemapInfo)
+TextureHandle TextureManager::UploadCubemap(const std::string &textureName,const std::array<Image,6> &faces)
 {
-	stbi_set_flip_vertically_on_load(false);
-
+	PROFILE_SCOPE("TextureManager::UploadCubemap");
 	u32 cubemapID;
 
 	glGenTextures(1,&cubemapID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP,cubemapID);
+    BindTexture(GL_TEXTURE_CUBE_MAP,cubemapID);
 
 	glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
@@ -66,51 +205,80 @@ void TextureManager::CreateCubemapFromImages(const CubemapTextureInfo &cubemapIn
 	glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
 
-	i32 width,height,numChannels;
+	// texure orientation macros are defined in order 
+	// from 0x8515 to 0x851A (+X,-X,+Y,-Y,+Z,-Z)
+	for(u32 i = 0;i < faces.size();i++)
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,0,GL_RGB,faces[i].width,faces[i].height,0,GL_RGB,GL_UNSIGNED_BYTE,faces[i].pixels);
+
+	return AddTexture(textureName,cubemapID,GL_TEXTURE_CUBE_MAP);
+}
 
-	for(u32 i = 0;i < cubemapInfo.pathsToImages.size();i++)
+// Textures can be uploaded while frames are drawn (asynchronous loads), the cache has to see those binds
+void TextureManager::BindTexture(u32 target,u32 textureID)
+{
+	if(this->glState)
+		this->glState->BindTexture(0,target,textureID);
+	else
+		glBindTexture(target,textureID);
+}
+
+TextureHandle TextureManager::AddTexture(const std::string &textureName,u32 textureID,u32 target)
+{
+	if(!this->textureNames.Find(textureName).IsNull())
 	{
-		u8 *imageData = stbi_load(cubemapInfo.pathsToImages[i].c_str(),&width,&height,&numChannels,0);
+		std::cout << "Texture \"" << textureName << "\" has already been created!" << std::endl;
+		exit(-1);
+	}
 
-		if(!imageData)
-		{
-			std::cout << "Image data could not be loaded from \"" << cubemapInfo.pathsToImages[i] << "\"!" 
-					  << std::endl;
-			exit(-1);
-		}
-		
-		// texure orientation macros are defined in order 
-		// from 0x8515 to 0x851A (+X,-X,+Y,-Y,+Z,-Z)
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,0,GL_RGB,width,height,0,GL_RGB,GL_UNSIGNED_BYTE,imageData);
+	const TextureHandle handle = this->textures.Insert(Texture{.textureID = textureID,.target = target,.name = ~0u});
+	this->textures[handle].name = this->textureNames.Assign(textureName,handle);
 
-    	stbi_image_free(imageData); 
+	return handle;
+}
+
+// Meant for load time, unknown names are reported instead of returning texture 0
+TextureHandle TextureManager::GetTexture(const std::string &textureName) const
+{
+	const TextureHandle texture = this->textureNames.Find(textureName);
+	if(texture.IsNull())
+	{
+		std::cout << "Texture \"" << textureName << "\" hasn't been created!" << std::endl;
+		exit(-1);
 	}
 
-	this->textures.insert(std::make_pair(cubemapInfo.name,cubemapID));
+	return texture;
 }
 
-void TextureManager::DeleteTexture(const std::string &textureName)
+void TextureManager::DeleteTexture(TextureHandle textureHandle)
 {
-	const u32 textureID = this->textures[textureName];
-	this->textures.erase(textureName);
+	const Texture texture = this->textures[textureHandle];
+	this->textures.Erase(textureHandle);
+	this->textureNames.Remove(texture.name);
 
-	glDeleteTextures(1,&textureID);
+	glDeleteTextures(1,&texture.textureID);
+	if(this->glState)
+		this->glState->OnDelete(GL_TEXTURE,texture.textureID);
 }
 
-void TextureManager::DeleteSelectedTextures(const std::vector<std::string> &textureNames)
+void TextureManager::DeleteSelectedTextures(const std::vector<TextureHandle> &textures)
 {
-	const u32 numberOfTextures = textureNames.size();
+	const u32 numberOfTextures = textures.size();
 
 	std::vector<u32> sequentialTextures;
 	sequentialTextures.resize(numberOfTextures);
 
 	for(u32 i = 0;i < numberOfTextures;i++)
 	{
-		sequentialTextures[i] = this->textures[textureNames[i]];
-		this->textures.erase(textureNames[i]);
+		const Texture texture = this->textures[textures[i]];
+		sequentialTextures[i] = texture.textureID;
+		this->textures.Erase(textures[i]);
+		this->textureNames.Remove(texture.name);
 	}
 
 	glDeleteTextures(numberOfTextures,sequentialTextures.data());
+	if(this->glState)
+		for(const u32 textureID : sequentialTextures)
+			this->glState->OnDelete(GL_TEXTURE,textureID);
 }
 
 void TextureManager::DeleteAllTextures()
@@ -121,12 +289,16 @@ void TextureManager::DeleteAllTextures()
 	sequentialTextures.resize(numberOfTextures);
 
 	u32 i = 0;
-	for(const auto &[textureName,texture] : this->textures)
+	for(const Texture &texture : this->textures)
 	{
-		sequentialTextures[i] = texture;
+		sequentialTextures[i] = texture.textureID;
+		this->textureNames.Remove(texture.name);
 		i++;
 	}
-	this->textures.clear();
+	this->textures.Clear();
 
 	glDeleteTextures(numberOfTextures,sequentialTextures.data());
+	if(this->glState)
+		for(const u32 textureID : sequentialTextures)
+			this->glState->OnDelete(GL_TEXTURE,textureID);
 }
\ No newline at end of file
@@ -11,6 +11,12 @@
 #include <GLEW/glew.h>
 
 #include "types.hpp"
+#include "handle.hpp"
+#include "jobsystem.hpp"
+#include "task.hpp"
+#include "filereader.hpp"
+#include "glstate.hpp"
+#include "profiler.hpp"
 
 struct TextureInfo
 {
@@ -24,16 +30,52 @@ struct CubemapTextureInfo
 	std::array<std::string,6> pathsToImages; 	// paths to the textures containg the data for each of the 6 faces of the cubemap texture (order matters)
 };
 
+struct Texture
+{
+	u32 textureID;	// name of the OpenGL texture object
+	u32 target;		// GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+	u32 name;		// id in TextureManager::textureNames
+};
+
+using TextureHandle = Handle<Texture>;
+
+// Decoded image, rows are stored bottom to top if it was decoded flipped
+struct Image
+{
+	u8 *pixels 		= nullptr; // freed with TextureManager::FreeImage
+	i32 width 		= 0;
+	i32 height 		= 0;
+	i32 numChannels = 0;
+};
+
+// Textures are referenced by handles, names are only resolved at load time
 struct TextureManager
 {
-    std::unordered_map<std::string,u32> textures;
+    SlotMap<Texture> 		textures;
+	ResourceNames<Texture> 	textureNames;
+	JobSystem 			   *jobSystem  = nullptr; // decodes the faces of a cubemap in parallel when set, required by the async loads
+	FileReader 			   *fileReader = nullptr; // reads the files (from mounted archives first) when set
+	GLState 			   *glState    = nullptr; // uploads bind through the cache and it's told about deleted textures when set
 
 	~TextureManager();
 
-    void CreateTextureFromImage(const TextureInfo &textureInfo);
-	void CreateCubemapFromImages(const CubemapTextureInfo &cubemapInfo);
+    TextureHandle 		CreateTextureFromImage(const TextureInfo &textureInfo);
+	TextureHandle 		CreateCubemapFromImages(const CubemapTextureInfo &cubemapInfo);
+	Task<TextureHandle> LoadTextureAsync(TextureInfo textureInfo);
+	Task<TextureHandle> LoadCubemapAsync(CubemapTextureInfo cubemapInfo);
+	TextureHandle 		GetTexture(const std::string &textureName) const;
 
-	void DeleteTexture(const std::string &textureName);
-	void DeleteSelectedTextures(const std::vector<std::string> &textureNames);
+	void DeleteTexture(TextureHandle texture);
+	void DeleteSelectedTextures(const std::vector<TextureHandle> &textures);
 	void DeleteAllTextures();
+
+	TextureHandle AddTexture(const std::string &textureName,u32 textureID,u32 target);
+	TextureHandle UploadTexture(const std::string &textureName,const Image &image);
+	TextureHandle UploadCubemap(const std::string &textureName,const std::array<Image,6> &faces);
+	void 		  BindTexture(u32 target,u32 textureID);
+	FileData 	  ReadImageFile(const std::string &pathToImage) const;
+	bool 		  DecodeCubemap(const CubemapTextureInfo &cubemapInfo,const std::array<FileData,6> *faceFiles,std::array<Image,6> &faces) const;
+
+	static bool DecodeImage(const std::string &pathToImage,const FileData &imageFile,Image &image,bool flipVertically);
+	static void FreeImage(Image &image);
 };